@@ -0,0 +1,69 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "osc_config.h"
+#include "tinyosc.h"
+
+// shared timing helpers and fixtures for the bench/ programs
+//
+// Results print as one aligned line each, or with BENCH_FORMAT=json as one
+// JSON object per line, tagged with BENCH_REV when it is set, for
+// bench/compare to diff across commits.  Other output of the benches
+// (checks, notes) starts with '#' or "ERROR:".
+
+static inline uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void bench_report(const char *name, uint64_t ops,
+                                uint64_t elapsed_ns) {
+  double ns_per_op = ops ? (double)elapsed_ns / (double)ops : 0.0;
+  const char *format = getenv("BENCH_FORMAT");
+  if (format && strcmp(format, "json") == 0) {
+    const char *rev = getenv("BENCH_REV");
+    printf("{\"bench\":\"%s\",\"ns_per_op\":%.2f,\"ops\":%llu,"
+           "\"rev\":\"%s\"}\n",
+           name, ns_per_op, (unsigned long long)ops, rev ? rev : "");
+  } else {
+    printf("%-40s %10.1f ns/op %12llu ops\n", name, ns_per_op,
+           (unsigned long long)ops);
+  }
+  fflush(stdout);
+}
+
+// keeps the compiler from discarding benchmarked results
+static volatile uint64_t bench_sink;
+
+// a connection's send for replies nobody reads
+static inline size_t bench_stub_send(connectionT *conn, const void *buf,
+                                     size_t len) {
+  return len;
+}
+
+// dispatches the message in buf from a peer whose replies go nowhere
+static inline void bench_dispatch(char *buf, int len) {
+  tosc_message msg;
+  connectionT conn = {0};
+  conn.send = bench_stub_send;
+  tosc_parseMessage(&msg, buf, len);
+  dispatch_message(&msg, &conn);
+}
+
+// writes a message to addr with type tags fmt and its arguments, as
+// tosc_writeMessage does, and dispatches it; for setting up state
+#define bench_set(addr, fmt, ...)                                              \
+  do {                                                                         \
+    char _buf[512];                                                            \
+    bench_dispatch(_buf, (int)tosc_writeMessage(_buf, sizeof(_buf), (addr),    \
+                                                (fmt), ##__VA_ARGS__));        \
+  } while (0)
+
+#endif
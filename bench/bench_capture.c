@@ -0,0 +1,126 @@
+// Capture and replay: what recording costs a worker, and replaying a
+// capture in-process.
+//
+// capture/record    one datagram queued for the writer thread
+// replay/inprocess  a capture dispatched flat out, with its latency
+//                   percentiles and replies
+//
+// Before timing, every recorded datagram must read back intact with its
+// source, and seeking through the index must land on the first record
+// at or after the offset; a failure exits 1.
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_replay.h"
+#include "tinyosc.h"
+
+#define BURSTS 40
+#define BURST  2000
+
+// a fader sweep with some GETs mixed in
+static int make_datagram(char *buf, int size, int i) {
+  char addr[64];
+  snprintf(addr, sizeof(addr), "/send/%d/%s", i % 4 + 1,
+           i % 3 ? "brightness" : "posX");
+  if (i % 50 == 0)
+    return tosc_writeMessage(buf, size, addr, "");
+  return tosc_writeMessage(buf, size, addr, "f", (float)(i % 100) / 100);
+}
+
+static int check(const char *path, uint64_t records) {
+  osc_capture_reader r;
+  if (osc_capture_reader_open(&r, path) < 0)
+    return 1;
+  osc_capture_msg m;
+  uint64_t n = 0, mid_t = 0;
+  char buf[128];
+  while (osc_capture_next(&r, &m)) {
+    int len = make_datagram(buf, sizeof(buf), (int)n);
+    const struct sockaddr_in *a = (const struct sockaddr_in *)&m.src;
+    if ((int)m.len != len || memcmp(m.data, buf, len) != 0 ||
+        ntohs(a->sin_port) != 9000 + n % 8) {
+      printf("ERROR: record %llu does not read back\n",
+             (unsigned long long)n);
+      return 1;
+    }
+    if (n == records / 2)
+      mid_t = m.t_ns;
+    n++;
+  }
+  if (n != records || r.index_count < 2) {
+    printf("ERROR: read %llu of %llu records, %u index entries\n",
+           (unsigned long long)n, (unsigned long long)records, r.index_count);
+    return 1;
+  }
+
+  // the first record at or after mid_t, by scanning
+  osc_capture_seek(&r, 0);
+  size_t want = r.pos;
+  while (osc_capture_next(&r, &m) && m.t_ns < mid_t)
+    want = r.pos;
+  osc_capture_seek(&r, mid_t);
+  if (r.pos != want) {
+    printf("ERROR: seek landed at %zu, not %zu\n", r.pos, want);
+    return 1;
+  }
+  osc_capture_reader_close(&r);
+  return 0;
+}
+
+int main(void) {
+  char path[] = "/tmp/bench_capture.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  osc_capture cap;
+  if (osc_capture_open(&cap, path) < 0)
+    return 1;
+  struct sockaddr_storage src = {0};
+  struct sockaddr_in *a = (struct sockaddr_in *)&src;
+  a->sin_family = AF_INET;
+  a->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  char buf[128];
+  uint64_t ns = 0;
+  for (int b = 0, i = 0; b < BURSTS; b++) {
+    uint64_t start = bench_now_ns();
+    for (int k = 0; k < BURST; k++, i++) {
+      int len = make_datagram(buf, sizeof(buf), i);
+      a->sin_port = htons(9000 + i % 8);
+      osc_capture_record_packet(&cap, buf, (uint32_t)len, &src, sizeof(*a));
+    }
+    ns += bench_now_ns() - start;
+    usleep(10000); // bursts spread over several index intervals
+  }
+  osc_capture_close(&cap);
+  bench_report("capture/record", BURSTS * BURST, ns);
+  osc_capture_print_stats(&cap.stats);
+
+  int bad = cap.stats.dropped == 0 ? check(path, cap.stats.records) : 0;
+  if (!bad) {
+    dispatch_init();
+    osc_capture_reader r;
+    osc_replay_opts opts = {0};
+    osc_replay_result res;
+    if (osc_capture_reader_open(&r, path) < 0 ||
+        osc_replay_run(&r, &opts, &res) < 0) {
+      bad = 1;
+    } else {
+      bench_report("replay/inprocess", res.datagrams, res.elapsed_ns);
+      osc_replay_print(&res);
+      osc_capture_reader_close(&r);
+    }
+  }
+  unlink(path);
+  return bad;
+}
@@ -0,0 +1,143 @@
+// Compares the compiled dispatch trie against the old linear globmatch scan
+// over dispatch_table, and measures full dispatch_message with a stub send
+// for SETs and for GETs, whose replies are sent as pre-encoded messages.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "globmatch.h"
+#include "osc_config.h"
+#include "tinyosc.h"
+
+#define ITERATIONS 2000000
+
+typedef struct {
+  char buf[256];
+  tosc_message msg;
+} bench_msg;
+
+static bench_msg mix[8];
+static int mix_count;
+static bench_msg gets[8];
+
+static size_t bytes_sent;
+
+static size_t count_send(connectionT *conn, const void *buf, size_t len) {
+  (void)conn;
+  (void)buf;
+  bytes_sent += len;
+  return len;
+}
+
+static void add_float(const char *address, float v) {
+  bench_msg *b = &mix[mix_count++];
+  int len = tosc_writeMessage(b->buf, sizeof(b->buf), address, "f", v);
+  tosc_parseMessage(&b->msg, b->buf, len);
+}
+
+static void add_lut(const char *address) {
+  bench_msg *b = &mix[mix_count++];
+  float p[32];
+  for (int i = 0; i < 32; i++)
+    p[i] = (float)i / 31.0f;
+  int len = tosc_writeMessage(
+      b->buf, sizeof(b->buf), address, "ffffffffffffffffffffffffffffffff",
+      p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10],
+      p[11], p[12], p[13], p[14], p[15], p[16], p[17], p[18], p[19], p[20],
+      p[21], p[22], p[23], p[24], p[25], p[26], p[27], p[28], p[29], p[30],
+      p[31]);
+  tosc_parseMessage(&b->msg, b->buf, len);
+}
+
+// the pre-trie dispatch loop, match only
+static int linear_match(const char *address) {
+  for (int i = 0; dispatch_table[i].path_pattern; i++) {
+    if (globmatch((char *)address, (char *)dispatch_table[i].path_pattern))
+      return i;
+  }
+  return -1;
+}
+
+int main(void) {
+  add_float("/send/2/brightness", 0.75f);
+  add_float("/send/4/hue", 0.1f);
+  add_float("/send/1/posX", 0.5f);
+  add_float("/input/3/framerate", 25.0f);
+  add_float("/analog_format/color_matrix/1/2", 0.25f);
+  add_float("/analog_format/framerate", 50.0f);
+  add_lut("/send/3/lut/B");
+  add_lut("/send/4/lut/G");
+
+  osc_trie trie;
+  osc_trie_init(&trie);
+  dispatch_init(); // fills dispatch_table
+  for (int i = 0; dispatch_table[i].path_pattern; i++)
+    osc_trie_add(&trie, dispatch_table[i].path_pattern, i);
+
+  for (int k = 0; k < mix_count; k++) {
+    osc_match m;
+    int a = linear_match(mix[k].msg.buffer);
+    int b = osc_trie_match(&trie, mix[k].msg.buffer, &m);
+    if (a != b) {
+      printf("ERROR: %s matched linear=%d trie=%d\n", mix[k].msg.buffer, a,
+             b);
+      return 1;
+    }
+  }
+
+  uint64_t sum = 0;
+  uint64_t t0 = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++)
+    sum += linear_match(mix[i % mix_count].msg.buffer);
+  bench_report("match/linear_globmatch", ITERATIONS, bench_now_ns() - t0);
+
+  t0 = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++) {
+    osc_match m;
+    sum += osc_trie_match(&trie, mix[i % mix_count].msg.buffer, &m);
+  }
+  bench_report("match/trie", ITERATIONS, bench_now_ns() - t0);
+
+  // worst case for the linear scan: the LUT entry is last in the table
+  t0 = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++)
+    sum += linear_match("/send/3/lut/B");
+  bench_report("match/linear_globmatch_lut", ITERATIONS, bench_now_ns() - t0);
+
+  t0 = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++) {
+    osc_match m;
+    sum += osc_trie_match(&trie, "/send/3/lut/B", &m);
+  }
+  bench_report("match/trie_lut", ITERATIONS, bench_now_ns() - t0);
+
+  connectionT conn = {0};
+  conn.send = count_send;
+  t0 = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++) {
+    tosc_message *msg = &mix[i % mix_count].msg;
+    tosc_reset(msg);
+    dispatch_message(msg, &conn);
+  }
+  bench_report("dispatch/set_mix", ITERATIONS, bench_now_ns() - t0);
+
+  // the same addresses with no arguments; the last two are LUT GETs
+  for (int k = 0; k < mix_count; k++) {
+    int len = tosc_writeMessage(gets[k].buf, sizeof(gets[k].buf),
+                                mix[k].msg.buffer, "", NULL);
+    tosc_parseMessage(&gets[k].msg, gets[k].buf, len);
+  }
+  t0 = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++)
+    dispatch_message(&gets[i % (mix_count - 2)].msg, &conn);
+  bench_report("dispatch/get_mix", ITERATIONS, bench_now_ns() - t0);
+
+  t0 = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++)
+    dispatch_message(&gets[mix_count - 1].msg, &conn);
+  bench_report("dispatch/get_lut", ITERATIONS, bench_now_ns() - t0);
+
+  bench_sink = sum + bytes_sent;
+  return 0;
+}
@@ -0,0 +1,105 @@
+// Frame clock: cost of reading the published config, and whether a reader
+// ever sees a frame with half of a bundle applied.
+//
+// frame/acquire            one thread taking and releasing the published
+//                          config while the clock publishes at 1000 fps.
+// frame/acquire_threads=N  the same from N threads, while a writer keeps
+//                          sending bundles that set posX and posY of send 1
+//                          to the same value; prints the torn frames seen.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_frame.h"
+#include "tinyosc.h"
+
+#define RUN_NS      500000000ull
+#define MAX_THREADS 4
+
+static atomic_bool stop_flag;
+static _Atomic uint64_t torn;
+
+// what osc_server does for every bundle
+static void *writer_thread(void *arg) {
+  float v = 0.0f;
+  while (!atomic_load_explicit(&stop_flag, memory_order_relaxed)) {
+    v += 1.0f;
+    osc_frame_bundle_begin();
+    bench_set("/send/1/posX", "f", v);
+    bench_set("/send/1/posY", "f", v);
+    osc_frame_bundle_end();
+  }
+  return NULL;
+}
+
+static void *reader_thread(void *arg) {
+  uint64_t *count = arg;
+  uint64_t n = 0, bad = 0;
+  while (!atomic_load_explicit(&stop_flag, memory_order_relaxed)) {
+    const Config *c = osc_frame_acquire();
+    if (c->send[0].posX != c->send[0].posY)
+      bad++;
+    osc_frame_release(c);
+    n++;
+  }
+  *count = n;
+  atomic_fetch_add(&torn, bad);
+  return NULL;
+}
+
+static void run(int threads, bool writer) {
+  pthread_t tid[MAX_THREADS], wtid;
+  uint64_t counts[MAX_THREADS];
+  atomic_store(&stop_flag, false);
+  atomic_store(&torn, 0);
+
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < threads; i++)
+    pthread_create(&tid[i], NULL, reader_thread, &counts[i]);
+  if (writer)
+    pthread_create(&wtid, NULL, writer_thread, NULL);
+  while (bench_now_ns() - start < RUN_NS)
+    ;
+  atomic_store(&stop_flag, true);
+  uint64_t total = 0;
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tid[i], NULL);
+    total += counts[i];
+  }
+  if (writer)
+    pthread_join(wtid, NULL);
+  uint64_t elapsed = bench_now_ns() - start;
+
+  char name[64];
+  if (writer)
+    snprintf(name, sizeof(name), "frame/acquire_threads=%d", threads);
+  else
+    snprintf(name, sizeof(name), "frame/acquire");
+  // per-thread cost: each reader ran for the whole interval
+  bench_report(name, total, elapsed * threads);
+  if (writer)
+    printf("# %s: %llu torn frames\n", name,
+           (unsigned long long)atomic_load(&torn));
+}
+
+int main(void) {
+  dispatch_init();
+  bench_set("/analog_format/framerate", "f", 1000.0f);
+  if (osc_frame_start(NULL, NULL) < 0)
+    return 1;
+
+  run(1, false);
+  for (int t = 1; t <= MAX_THREADS; t *= 2)
+    run(t, true);
+
+  osc_frame_stop();
+  osc_frame_stats st;
+  osc_frame_get_stats(&st);
+  printf("# ");
+  osc_frame_print_stats(&st);
+  return 0;
+}
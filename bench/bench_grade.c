@@ -0,0 +1,217 @@
+// Colour grading of whole frames, checked against the scalar reference.
+//
+// grade/update               rebuilding the matrix and composed tables
+// grade/<res>_matrix         a frame with the default (identity) LUTs: the
+//                            3x4 matrix and a clamp
+// grade/<res>_lut            a frame with an S-curve on Y and a lift on R
+//
+// Before timing, each grade is compared pixel by pixel with
+// osc_grade_pixel, and so is a grade in place over an odd width; a pixel
+// more than a few ULP off exits 1.  Frames per second and the memory
+// traffic they amount to (three float planes in, three out) follow each
+// result.
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_frame.h"
+#include "osc_grade.h"
+#include "tinyosc.h"
+
+#define UPDATES    200
+#define ODD_WIDTH  1923 // not a multiple of 8: leaves a scalar tail
+#define ODD_HEIGHT 5
+
+static const struct {
+  const char *name;
+  int         width, height, frames;
+} sizes[] = {
+    {"1080p", 1920, 1080, 30},
+    {"2160p", 3840, 2160, 8},
+};
+
+// 32 floats: the x,y pairs of a LUT channel
+static void set_lut(const char *addr, const float *v) {
+  bench_set(addr, "ffffffffffffffffffffffffffffffff", v[0], v[1], v[2], v[3],
+            v[4], v[5], v[6], v[7], v[8], v[9], v[10], v[11], v[12], v[13],
+            v[14], v[15], v[16], v[17], v[18], v[19], v[20], v[21], v[22],
+            v[23], v[24], v[25], v[26], v[27], v[28], v[29], v[30], v[31]);
+}
+
+// the grade of send 1 in the frame now published
+static void update(osc_grade *g) {
+  const Config *c = osc_frame_acquire();
+  osc_grade_update(g, c, 0);
+  osc_frame_release(c);
+}
+
+// waits for the frame clock to publish what was just set
+static void next_frame(void) { usleep(50000); }
+
+// within a few ULP of the reference, on the scale of a pixel value of 1:
+// a compiler may contract the multiplies and adds of either side into
+// FMAs, which round differently
+static int close_enough(float got, float want) {
+  return fabsf(got - want) <= 4 * FLT_EPSILON * fmaxf(1.0f, fabsf(want));
+}
+
+static int check(const char *name, const osc_grade *g, const osc_picture *in,
+                 osc_picture *out) {
+  osc_grade_apply(g, in, out);
+  for (int y = 0; y < in->height; y++) {
+    for (int x = 0; x < in->width; x++) {
+      float px[3], want[3];
+      for (int c = 0; c < 3; c++)
+        px[c] = osc_picture_row(in, c, y)[x];
+      osc_grade_pixel(g, px, want);
+      for (int c = 0; c < 3; c++) {
+        float got = osc_picture_row(out, c, y)[x];
+        if (!close_enough(got, want[c])) {
+          printf("ERROR: %s: pixel %d,%d channel %d is %g, reference %g\n",
+                 name, x, y, c, got, want[c]);
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+// graded in place over an odd width, so the scalar tail after the vector
+// loop reads pixels its own writes must not have changed yet
+static int check_in_place(const char *what, const osc_grade *g) {
+  osc_picture pic, ref;
+  if (osc_picture_alloc(&pic, ODD_WIDTH, ODD_HEIGHT) < 0 ||
+      osc_picture_alloc(&ref, ODD_WIDTH, ODD_HEIGHT) < 0) {
+    printf("ERROR: out of memory\n");
+    return 1;
+  }
+  for (int c = 0; c < 3; c++)
+    for (int y = 0; y < pic.height; y++)
+      for (int x = 0; x < pic.width; x++)
+        osc_picture_row(&pic, c, y)[x] = osc_picture_row(&ref, c, y)[x] =
+            (float)rand() / RAND_MAX;
+
+  osc_grade_apply(g, &pic, &pic);
+  int bad = 0;
+  for (int y = 0; y < pic.height && !bad; y++) {
+    for (int x = 0; x < pic.width && !bad; x++) {
+      float px[3], want[3];
+      for (int c = 0; c < 3; c++)
+        px[c] = osc_picture_row(&ref, c, y)[x];
+      osc_grade_pixel(g, px, want);
+      for (int c = 0; c < 3 && !bad; c++) {
+        float got = osc_picture_row(&pic, c, y)[x];
+        if (!close_enough(got, want[c])) {
+          printf("ERROR: %s in place: pixel %d,%d channel %d is %g, "
+                 "reference %g\n",
+                 what, x, y, c, got, want[c]);
+          bad = 1;
+        }
+      }
+    }
+  }
+  osc_picture_free(&pic);
+  osc_picture_free(&ref);
+  return bad;
+}
+
+static int run(const char *what, const osc_grade *g, int s) {
+  osc_picture in, out;
+  if (osc_picture_alloc(&in, sizes[s].width, sizes[s].height) < 0 ||
+      osc_picture_alloc(&out, sizes[s].width, sizes[s].height) < 0) {
+    printf("ERROR: out of memory\n");
+    return 1;
+  }
+  for (int c = 0; c < 3; c++)
+    for (int y = 0; y < in.height; y++)
+      for (int x = 0; x < in.width; x++)
+        osc_picture_row(&in, c, y)[x] = (float)rand() / RAND_MAX;
+
+  char name[64];
+  snprintf(name, sizeof(name), "grade/%s_%s", sizes[s].name, what);
+  int bad = check(name, g, &in, &out);
+  if (!bad) {
+    uint64_t start = bench_now_ns();
+    for (int f = 0; f < sizes[s].frames; f++)
+      osc_grade_apply(g, &in, &out);
+    uint64_t ns = bench_now_ns() - start;
+    bench_report(name, sizes[s].frames, ns);
+    double fps = sizes[s].frames * 1e9 / ns;
+    double bytes = 6.0 * sizeof(float) * in.width * in.height;
+    printf("# %s: %.1f fps, %.1f GB/s\n", name, fps, fps * bytes / 1e9);
+  }
+  osc_picture_free(&in);
+  osc_picture_free(&out);
+  return bad;
+}
+
+int main(void) {
+  dispatch_init();
+  if (osc_frame_start(NULL, NULL) < 0)
+    return 1;
+  srand(1);
+
+  // a send with every linear control moved
+  const float params[][2] = {{0.55f, 0}, {0.6f, 0}, {0.7f, 0}, {0.05f, 0}};
+  const char *paths[] = {"/send/1/brightness", "/send/1/contrast",
+                         "/send/1/saturation", "/send/1/hue"};
+  for (int i = 0; i < 4; i++)
+    bench_set(paths[i], "f", params[i][0]);
+  const float warm[] = {0.95f, 0.05f, 0.0f, 1.02f};
+  bench_set("/analog_format/color_matrix/0/0", "f", warm[0]);
+  bench_set("/analog_format/color_matrix/0/1", "f", warm[1]);
+  bench_set("/analog_format/color_matrix/2/2", "f", warm[3]);
+  next_frame();
+
+  osc_grade g;
+  osc_grade_init(&g);
+  update(&g);
+  update(&g);
+  if (g.updates != 1) {
+    printf("ERROR: grade rebuilt without a change\n");
+    return 1;
+  }
+
+  const Config *c = osc_frame_acquire();
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < UPDATES; i++) {
+    g.built = false;
+    osc_grade_update(&g, c, 0);
+  }
+  bench_report("grade/update", UPDATES, bench_now_ns() - start);
+  osc_frame_release(c);
+
+  int bad = 0;
+  for (int s = 0; s < 2; s++)
+    bad |= run("matrix", &g, s);
+  bad |= check_in_place("matrix", &g);
+
+  float lut[32];
+  for (int i = 0; i < 32; i++)
+    lut[i] = -1.0f;
+  const float s_curve[] = {0.0f, 0.0f, 0.25f, 0.15f, 0.75f, 0.85f, 1.0f, 1.0f};
+  const float lift[] = {0.0f, 0.05f, 1.0f, 1.0f};
+  for (int i = 0; i < 8; i++)
+    lut[24 + i] = s_curve[i];
+  set_lut("/send/1/lut/Y", lut);
+  for (int i = 0; i < 32; i++)
+    lut[i] = i >= 28 ? lift[i - 28] : -1.0f;
+  set_lut("/send/1/lut/R", lut);
+  next_frame();
+  update(&g);
+  if (g.lut_identity) {
+    printf("ERROR: LUTs were not picked up\n");
+    return 1;
+  }
+  for (int s = 0; s < 2; s++)
+    bad |= run("lut", &g, s);
+  bad |= check_in_place("lut", &g);
+
+  osc_frame_stop();
+  return bad;
+}
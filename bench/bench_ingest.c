@@ -0,0 +1,247 @@
+// Last-writer-wins over a receive batch: what a fader sweep costs with
+// every SET dispatched and with the batch collapsed first.
+//
+// ingest/scan           classifying a batch of 32 SETs over 4 fields
+// ingest/sweep_each     the same batch parsed and dispatched one by one
+// ingest/sweep_collapsed  scanned, then only the newest SET of each field
+//
+// Before timing, a scan must keep the newest SET of each field and never
+// collapse across a GET, a bundle or an address pattern, and a burst sent
+// to a batched server must leave each GET, bundled or not, the value of
+// the SETs before it; a failure exits 1.
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_ingest.h"
+#include "osc_server.h"
+#include "osc_stats.h"
+#include "tinyosc.h"
+
+#define ITER      200000
+#define UDP_PORT  19300
+#define SWEEP     20 // SETs of one field at the head of the burst
+
+static osc_rx_ring ring;
+static osc_ingest ingest;
+
+static void put(int i, const char *buf, int len) {
+  memcpy(ring.buf[i], buf, (size_t)len);
+  ring.hdr[i].msg_len = (unsigned int)len;
+}
+
+static void put_set(int i, const char *addr, float v) {
+  char buf[64];
+  put(i, buf, tosc_writeMessage(buf, sizeof(buf), addr, "f", v));
+}
+
+static void put_get(int i, const char *addr) {
+  char buf[64];
+  put(i, buf, tosc_writeMessage(buf, sizeof(buf), addr, ""));
+}
+
+static int write_bundle_get(char *buf, int len, const char *addr) {
+  tosc_bundle b;
+  tosc_writeBundle(&b, 1, buf, len); // 1: immediately
+  tosc_writeNextMessage(&b, addr, "");
+  return (int)tosc_getBundleLength(&b);
+}
+
+static int check_scan(void) {
+  static const uint8_t want[] = {
+      OSC_INGEST_SUPERSEDED, OSC_INGEST_SET,        OSC_INGEST_OTHER,
+      OSC_INGEST_SET,        OSC_INGEST_OTHER,      OSC_INGEST_SUPERSEDED,
+      OSC_INGEST_SET,        OSC_INGEST_SET,        OSC_INGEST_OTHER,
+      OSC_INGEST_SET,        OSC_INGEST_OTHER};
+  char buf[128];
+  put_set(0, "/send/1/hue", 0.1f);
+  put_set(1, "/send/1/hue", 0.2f);
+  put_get(2, "/send/1/hue"); // reads 0.2
+  put_set(3, "/send/1/hue", 0.3f);
+  put(4, buf, write_bundle_get(buf, sizeof(buf), "/send/1/hue"));
+  put_set(5, "/send/1/hue", 0.4f);
+  put_set(6, "/send/2/hue", 0.5f);
+  put_set(7, "/send/1/hue", 0.6f);
+  put_set(8, "/send/*/hue", 0.7f); // a pattern may write both
+  put_set(9, "/send/2/hue", 0.8f);
+  put(10, buf, tosc_writeMessage(buf, sizeof(buf), "/send/3/hue", "i", 1));
+  int n = (int)sizeof(want);
+
+  osc_ingest_init(&ingest);
+  int collapsed = osc_ingest_scan(&ingest, &ring, n, dispatch_set_field);
+  for (int i = 0; i < n; i++) {
+    if (ingest.kind[i] != want[i]) {
+      printf("ERROR: datagram %d scanned as %d, not %d\n", i, ingest.kind[i],
+             want[i]);
+      return 1;
+    }
+  }
+  if (collapsed != 2 || ingest.stats.sets != 7 ||
+      ingest.stats.barriers != 4) {
+    printf("ERROR: scan: %d collapsed, %llu SETs, %llu barriers\n", collapsed,
+           (unsigned long long)ingest.stats.sets,
+           (unsigned long long)ingest.stats.barriers);
+    return 1;
+  }
+  return 0;
+}
+
+// a SET applied from the scan must show in /stats like any other: every
+// phase but the send counted once per SET
+static int check_phases(const char *pattern) {
+  int entry = 0;
+  while (strcmp(dispatch_table[entry].path_pattern, pattern) != 0)
+    entry++;
+  osc_hist_summary s[OSC_PHASE_SEND];
+  for (int p = 0; p < OSC_PHASE_SEND; p++)
+    osc_stats_summary(entry, p, &s[p]);
+  if (s[OSC_PHASE_MATCH].count == 0 ||
+      s[OSC_PHASE_PARSE].count != s[OSC_PHASE_MATCH].count ||
+      s[OSC_PHASE_HANDLER].count != s[OSC_PHASE_MATCH].count) {
+    printf("ERROR: %s: %llu parsed, %llu matched, %llu handled\n", pattern,
+           (unsigned long long)s[OSC_PHASE_PARSE].count,
+           (unsigned long long)s[OSC_PHASE_MATCH].count,
+           (unsigned long long)s[OSC_PHASE_HANDLER].count);
+    return 1;
+  }
+  return 0;
+}
+
+static void *server_thread(void *arg) {
+  osc_server_run(arg);
+  return NULL;
+}
+
+static int recv_float(int fd, float *v) {
+  char buf[256];
+  ssize_t n = recv(fd, buf, sizeof(buf), 0);
+  tosc_message m;
+  if (n <= 0 || tosc_parseMessageChecked(&m, buf, (int)n) != 0 ||
+      m.format[0] != 'f')
+    return -1;
+  *v = tosc_getNextFloat(&m);
+  return 0;
+}
+
+// the whole burst is queued before the server runs, so one recvmmsg
+// takes it
+static int check_server(void) {
+  osc_server server = {0};
+  char spec[32];
+  snprintf(spec, sizeof(spec), "127.0.0.1:%d", UDP_PORT);
+  const char *specs[] = {spec};
+  if (osc_server_open(&server, specs, 1, 1, true) < 0) {
+    osc_server_close(&server);
+    return 1;
+  }
+  server.verbose = false;
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct timeval tv = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in sin = {0};
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(UDP_PORT);
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  connect(fd, (struct sockaddr *)&sin, sizeof(sin));
+
+  char buf[128];
+  int len;
+  for (int i = 0; i < SWEEP; i++) {
+    len = tosc_writeMessage(buf, sizeof(buf), "/send/3/hue", "f",
+                            (float)(i + 1) / 32);
+    send(fd, buf, len, 0);
+  }
+  len = tosc_writeMessage(buf, sizeof(buf), "/send/3/hue", "");
+  send(fd, buf, len, 0);
+  len = tosc_writeMessage(buf, sizeof(buf), "/send/3/hue", "f", 0.5f);
+  send(fd, buf, len, 0);
+  len = write_bundle_get(buf, sizeof(buf), "/send/3/hue");
+  send(fd, buf, len, 0);
+  len = tosc_writeMessage(buf, sizeof(buf), "/send/3/hue", "f", 0.75f);
+  send(fd, buf, len, 0);
+  len = tosc_writeMessage(buf, sizeof(buf), "/send/3/hue", "f", 0.875f);
+  send(fd, buf, len, 0);
+  len = tosc_writeMessage(buf, sizeof(buf), "/send/3/hue", "");
+  send(fd, buf, len, 0);
+
+  uint64_t collapsed0 = osc_stats_counter(OSC_STAT_COLLAPSED);
+  pthread_t srv;
+  pthread_create(&srv, NULL, server_thread, &server);
+  float got[3] = {0};
+  int ok = recv_float(fd, &got[0]) == 0 && recv_float(fd, &got[1]) == 0 &&
+           recv_float(fd, &got[2]) == 0;
+  close(fd);
+  osc_server_stop(&server);
+  pthread_join(srv, NULL);
+  osc_ingest_stats st;
+  osc_server_ingest_stats(&server, &st);
+  osc_server_close(&server);
+
+  if (!ok || got[0] != (float)SWEEP / 32 || got[1] != 0.5f ||
+      got[2] != 0.875f) {
+    printf("ERROR: the GETs read %g, %g, %g\n", got[0], got[1], got[2]);
+    return 1;
+  }
+  uint64_t collapsed = osc_stats_counter(OSC_STAT_COLLAPSED) - collapsed0;
+  if (st.collapsed != SWEEP || collapsed != SWEEP) {
+    printf("ERROR: the server collapsed %llu SETs, counted %llu\n",
+           (unsigned long long)st.collapsed, (unsigned long long)collapsed);
+    return 1;
+  }
+  return check_phases("/send/[1-4]/hue");
+}
+
+// a sweep of four faders, eight steps each, interleaved
+static void put_sweep(void) {
+  for (int i = 0; i < OSC_IO_BATCH; i++) {
+    char addr[32];
+    snprintf(addr, sizeof(addr), "/send/%d/brightness", 1 + i % 4);
+    put_set(i, addr, (float)i / OSC_IO_BATCH);
+  }
+}
+
+int main(void) {
+  dispatch_init();
+  if (check_scan() || check_server())
+    return 1;
+
+  connectionT conn = {0};
+  conn.send = bench_stub_send;
+  put_sweep();
+  uint64_t start = bench_now_ns();
+  for (int k = 0; k < ITER; k++)
+    bench_sink += osc_ingest_scan(&ingest, &ring, OSC_IO_BATCH,
+                                  dispatch_set_field);
+  bench_report("ingest/scan", (uint64_t)ITER * OSC_IO_BATCH,
+               bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (int k = 0; k < ITER; k++) {
+    for (int i = 0; i < OSC_IO_BATCH; i++) {
+      tosc_message m;
+      tosc_parseMessageChecked(&m, ring.buf[i], (int)ring.hdr[i].msg_len);
+      dispatch_message(&m, &conn);
+    }
+  }
+  bench_report("ingest/sweep_each", (uint64_t)ITER * OSC_IO_BATCH,
+               bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (int k = 0; k < ITER; k++) {
+    osc_ingest_scan(&ingest, &ring, OSC_IO_BATCH, dispatch_set_field);
+    for (int i = 0; i < OSC_IO_BATCH; i++)
+      if (ingest.kind[i] == OSC_INGEST_SET)
+        dispatch_set(&ingest.msg[i], ingest.field[i], ingest.parse_ticks[i],
+                     ingest.match_ticks[i], &conn);
+  }
+  bench_report("ingest/sweep_collapsed", (uint64_t)ITER * OSC_IO_BATCH,
+               bench_now_ns() - start);
+  return 0;
+}
@@ -0,0 +1,179 @@
+// LUT compiler and kernels, checked against the scalar reference.
+//
+// Every point set below is compiled both ways and checked first: the
+// kernels must match osc_lut_eval bit for bit, the float table must stay
+// within half its largest step of osc_lut_curve (linear interpolation
+// cannot follow a kink closer), the 10-bit table within one code, and
+// monotone points must give a monotone table.  Any failure exits 1.
+//
+// lut/compile_{linear,cubic}  compiling one channel's table
+// lut/eval_scalar             osc_lut_eval over a 1080p plane
+// lut/apply                   osc_lut_apply over the same plane
+// lut/apply_u10               osc_lut_apply_u10 over 10-bit codes
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "osc_lut.h"
+
+#define SAMPLES    (1920 * 1080)
+#define COMPILES   2000
+#define PASSES     20
+
+#define UNUSED {-1.0f, -1.0f}
+
+static const struct {
+  const char   *name;
+  bool          monotone;
+  ConfigSendLut lut;
+} sets[] = {
+  {"default", true, {{UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+                      UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+                      {0.0f, 0.0f}, {1.0f, 1.0f}}}},
+  {"empty", true, {{UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+                    UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+                    UNUSED, UNUSED}}},
+  {"s_curve", true, {{{0.0f, 0.0f}, UNUSED, {0.25f, 0.1f}, {0.5f, 0.5f},
+                      UNUSED, {0.75f, 0.9f}, {1.0f, 1.0f}, UNUSED, UNUSED,
+                      UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+                      UNUSED}}},
+  {"unsorted_steep", true, {{{0.9f, 1.0f}, {0.1f, 0.0f}, {0.12f, 0.8f},
+                             {0.5f, 0.85f}, UNUSED, UNUSED, UNUSED, UNUSED,
+                             UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+                             UNUSED, UNUSED}}},
+  {"bump", false, {{{0.0f, 0.2f}, {0.3f, 0.9f}, {0.6f, 0.1f}, {1.0f, 0.7f},
+                    UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+                    UNUSED, UNUSED, UNUSED, UNUSED, UNUSED}}},
+};
+
+#define SET_COUNT (int)(sizeof(sets) / sizeof(sets[0]))
+
+static float in[SAMPLES], out[SAMPLES];
+static uint16_t in10[SAMPLES], out10[SAMPLES];
+static osc_lut lut;
+
+static int check(const char *name, const ConfigSendLut *src,
+                 osc_lut_interp interp, bool monotone) {
+  int bad = 0;
+  osc_lut_compile(&lut, src, interp);
+
+  osc_lut_apply(&lut, in, out, SAMPLES);
+  for (int i = 0; i < SAMPLES && !bad; i++) {
+    if (out[i] != osc_lut_eval(&lut, in[i])) {
+      printf("ERROR: %s: apply(%g) = %g, eval %g\n", name, in[i], out[i],
+             osc_lut_eval(&lut, in[i]));
+      bad = 1;
+    }
+  }
+  osc_lut_apply_u10(&lut, in10, out10, SAMPLES);
+  for (int i = 0; i < SAMPLES && !bad; i++) {
+    uint16_t c = in10[i] < OSC_LUT_CODES ? in10[i] : OSC_LUT_CODES - 1;
+    if (out10[i] != lut.u10[c]) {
+      printf("ERROR: %s: apply_u10(%u) = %u, table %u\n", name, in10[i],
+             out10[i], lut.u10[c]);
+      bad = 1;
+    }
+  }
+
+  float max_err = 0.0f, limit = 1e-6f;
+  for (int i = 1; i < OSC_LUT_SIZE; i++) {
+    float step = fabsf(lut.f[i] - lut.f[i - 1]) / 2;
+    if (step > limit)
+      limit = step;
+  }
+  for (int i = 0; i <= 100000; i++) {
+    float x = (float)i / 100000.0f;
+    float err = fabsf(osc_lut_eval(&lut, x) - osc_lut_curve(src, interp, x));
+    if (err > max_err)
+      max_err = err;
+  }
+  if (max_err > limit) {
+    printf("ERROR: %s: table is %g off the curve\n", name, max_err);
+    bad = 1;
+  }
+  for (int c = 0; c < OSC_LUT_CODES; c++) {
+    float ref = osc_lut_curve(src, interp, (float)c / (OSC_LUT_CODES - 1));
+    ref = ref > 0.0f ? ref < 1.0f ? ref : 1.0f : 0.0f;
+    int want = (int)(ref * (OSC_LUT_CODES - 1) + 0.5f);
+    if (abs((int)lut.u10[c] - want) > 1) {
+      printf("ERROR: %s: code %d maps to %u, curve %d\n", name, c,
+             lut.u10[c], want);
+      bad = 1;
+      break;
+    }
+  }
+  for (int i = 1; monotone && i < OSC_LUT_SIZE; i++) {
+    if (lut.f[i] < lut.f[i - 1]) {
+      printf("ERROR: %s: table falls at %d\n", name, i);
+      bad = 1;
+      break;
+    }
+  }
+  printf("# lut/check %-26s max error %.2g of %.2g\n", name, max_err,
+         limit);
+  return bad;
+}
+
+static void bench_compile(const char *name, osc_lut_interp interp) {
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < COMPILES; i++)
+    osc_lut_compile(&lut, &sets[2].lut, interp);
+  bench_report(name, COMPILES, bench_now_ns() - start);
+}
+
+static void report_rate(const char *name, uint64_t samples, uint64_t ns) {
+  bench_report(name, samples, ns);
+  printf("# %s: %.0f Msamples/s\n", name, (double)samples * 1e3 / ns);
+}
+
+int main(void) {
+  srand(1);
+  for (int i = 0; i < SAMPLES; i++) {
+    in[i] = (float)rand() / RAND_MAX * 1.2f - 0.1f; // some out of range
+    in10[i] = (uint16_t)(rand() % (OSC_LUT_CODES + 64));
+  }
+  in[0] = NAN;
+  in[1] = 1.0f;
+  in[2] = 0.0f;
+
+  int bad = 0;
+  for (int s = 0; s < SET_COUNT; s++) {
+    char name[48];
+    snprintf(name, sizeof(name), "%s/linear", sets[s].name);
+    bad |= check(name, &sets[s].lut, OSC_LUT_LINEAR, sets[s].monotone);
+    snprintf(name, sizeof(name), "%s/cubic", sets[s].name);
+    bad |= check(name, &sets[s].lut, OSC_LUT_CUBIC, sets[s].monotone);
+  }
+  if (bad)
+    return 1;
+
+  bench_compile("lut/compile_linear", OSC_LUT_LINEAR);
+  bench_compile("lut/compile_cubic", OSC_LUT_CUBIC);
+
+  osc_lut_compile(&lut, &sets[2].lut, OSC_LUT_CUBIC);
+  uint64_t start = bench_now_ns();
+  for (int p = 0; p < PASSES; p++)
+    for (int i = 0; i < SAMPLES; i++)
+      out[i] = osc_lut_eval(&lut, in[i]);
+  report_rate("lut/eval_scalar", (uint64_t)PASSES * SAMPLES,
+              bench_now_ns() - start);
+  bench_sink += (uint64_t)out[SAMPLES / 2];
+
+  start = bench_now_ns();
+  for (int p = 0; p < PASSES; p++)
+    osc_lut_apply(&lut, in, out, SAMPLES);
+  report_rate("lut/apply", (uint64_t)PASSES * SAMPLES,
+              bench_now_ns() - start);
+  bench_sink += (uint64_t)out[SAMPLES / 2];
+
+  start = bench_now_ns();
+  for (int p = 0; p < PASSES; p++)
+    osc_lut_apply_u10(&lut, in10, out10, SAMPLES);
+  report_rate("lut/apply_u10", (uint64_t)PASSES * SAMPLES,
+              bench_now_ns() - start);
+  bench_sink += out10[SAMPLES / 2];
+  return 0;
+}
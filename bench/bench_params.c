@@ -0,0 +1,167 @@
+// The parameter registry: SETs of each kind through the generic path, and
+// the sanitize pass run over restored state.
+//
+// params/set_float    /send/2/brightness ,f, clamped
+// params/set_int      /clock_offset ,i
+// params/set_string   /input/1/resolution ,s
+// params/set_lut      /send/3/lut/G with 32 floats
+// params/sanitize     osc_params_sanitize over the whole Config
+//
+// Before timing, every registered address must expand and reach its
+// value, limits must clamp SETs and restored state, NaN included, and a
+// boolean must take both T and F; a failure exits 1.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_params.h"
+#include "tinyosc.h"
+
+#define ITER 2000000
+
+typedef struct {
+  char         buf[256];
+  tosc_message msg;
+  char        *args;
+} bench_msg;
+
+static int errors;
+
+static size_t count_send(connectionT *conn, const void *buf, size_t len) {
+  errors += strcmp(buf, "/error") == 0;
+  return len;
+}
+
+static connectionT conn = {.send = count_send};
+
+static void parse(bench_msg *b, int len) {
+  tosc_parseMessage(&b->msg, b->buf, len);
+  b->args = b->msg.marker;
+}
+
+static void dispatch(bench_msg *b) {
+  b->msg.marker = b->args;
+  dispatch_message(&b->msg, &conn);
+}
+
+static int check(void) {
+  char path[OSC_IMAGE_PATH_LEN];
+  int fields = 0;
+  for (int k = 0; k < osc_param_count; k++) {
+    osc_match m;
+    osc_param_first(&osc_params[k], &m);
+    do {
+      if (osc_param_path(&osc_params[k], &m, path, sizeof(path)) < 0) {
+        printf("ERROR: %s does not expand\n", osc_params[k].pattern);
+        return 1;
+      }
+      fields++;
+    } while (osc_param_next(&osc_params[k], &m));
+  }
+  // 1 + 4 * 6 inputs + 4 top-level + 9 matrix + 4 * 12 sends + 16 LUTs
+  if (fields != 102) {
+    printf("ERROR: the registry expands to %d fields\n", fields);
+    return 1;
+  }
+
+  bench_msg b;
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf), "/send/2/brightness",
+                              "f", 3.0f));
+  dispatch(&b);
+  if (config.send[1].brightness != 1.0f) {
+    printf("ERROR: brightness 3 was set to %g\n", config.send[1].brightness);
+    return 1;
+  }
+
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf), "/send/2/brightness",
+                              "f", NAN));
+  dispatch(&b);
+  if (config.send[1].brightness != 0.0f) {
+    printf("ERROR: brightness NaN was set to %g\n", config.send[1].brightness);
+    return 1;
+  }
+
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf),
+                              "/analog_format/color_matrix/2/1", "f", 0.25f));
+  dispatch(&b);
+  if (config.analog_format.color_matrix[2][1] != 0.25f) {
+    printf("ERROR: color_matrix/2/1 missed\n");
+    return 1;
+  }
+
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf), "/input/2/connected",
+                              "F"));
+  errors = 0;
+  dispatch(&b);
+  if (errors || config.input[1].connected != 0) {
+    printf("ERROR: /input/2/connected ,F was refused\n");
+    return 1;
+  }
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf), "/input/2/connected",
+                              "T"));
+  dispatch(&b);
+  if (config.input[1].connected != 1) {
+    printf("ERROR: /input/2/connected ,T was refused\n");
+    return 1;
+  }
+
+  Config c = config;
+  c.send[3].saturation = -2.0f;
+  c.input[0].bit_depth = 99;
+  c.send[2].hue = NAN; // no limits, but NaN is still replaced
+  memset(c.sync_mode, 'x', CONFIG_MAX_STR_LEN);
+  int changed = osc_params_sanitize(&c);
+  if (changed != 4 || c.send[3].saturation != 0.0f || c.send[2].hue != 0.0f ||
+      c.input[0].bit_depth != 16 || c.sync_mode[CONFIG_MAX_STR_LEN - 1]) {
+    printf("ERROR: sanitize changed %d values\n", changed);
+    return 1;
+  }
+  return 0;
+}
+
+static void time_set(const char *name, bench_msg *b) {
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    dispatch(b);
+  bench_report(name, ITER, bench_now_ns() - start);
+}
+
+int main(void) {
+  dispatch_init();
+  if (check())
+    return 1;
+
+  bench_msg b;
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf), "/send/2/brightness",
+                              "f", 0.75f));
+  time_set("params/set_float", &b);
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf), "/clock_offset", "i", 5));
+  time_set("params/set_int", &b);
+  parse(&b, tosc_writeMessage(b.buf, sizeof(b.buf), "/input/1/resolution",
+                              "s", "1920x1080"));
+  time_set("params/set_string", &b);
+
+  float p[32];
+  for (int i = 0; i < 32; i++)
+    p[i] = (float)i / 31.0f;
+  parse(&b, tosc_writeMessage(
+                b.buf, sizeof(b.buf), "/send/3/lut/G",
+                "ffffffffffffffffffffffffffffffff", p[0], p[1], p[2], p[3],
+                p[4], p[5], p[6], p[7], p[8], p[9], p[10], p[11], p[12], p[13],
+                p[14], p[15], p[16], p[17], p[18], p[19], p[20], p[21], p[22],
+                p[23], p[24], p[25], p[26], p[27], p[28], p[29], p[30], p[31]));
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITER / 100; i++)
+    dispatch(&b);
+  bench_report("params/set_lut", ITER / 100, bench_now_ns() - start);
+
+  Config c = config;
+  start = bench_now_ns();
+  for (int i = 0; i < ITER / 100; i++)
+    bench_sink += osc_params_sanitize(&c);
+  bench_report("params/sanitize", ITER / 100, bench_now_ns() - start);
+  return 0;
+}
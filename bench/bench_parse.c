@@ -0,0 +1,95 @@
+// Message parse throughput: tosc_parseMessage, which trusts the buffer,
+// against tosc_parseMessageChecked, which validates the address, format and
+// argument sizes against len.  Each message is parsed and then its
+// arguments read, as dispatch does.
+//
+// decode/lut_* reads the 32 floats of a parsed LUT message one at a time
+// with tosc_getNextFloat, or in one pass with tosc_getNextFloats.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "tinyosc.h"
+
+#define ITER 2000000
+
+typedef int (*parse_fn)(tosc_message *, char *, const int);
+
+static void read_args(tosc_message *msg) {
+  uint64_t acc = 0;
+  for (const char *f = msg->format; *f; f++) {
+    switch (*f) {
+    case 'f': {
+      float v = tosc_getNextFloat(msg);
+      uint32_t bits;
+      memcpy(&bits, &v, sizeof(bits));
+      acc += bits;
+      break;
+    }
+    case 'i': acc += (uint32_t)tosc_getNextInt32(msg); break;
+    case 's': acc += (uint64_t)tosc_getNextString(msg)[0]; break;
+    }
+  }
+  bench_sink += acc;
+}
+
+static void run(const char *name, parse_fn parse, char *buf, int len) {
+  tosc_message msg;
+  uint64_t t0 = bench_now_ns();
+  for (int i = 0; i < ITER; i++) {
+    if (parse(&msg, buf, len) == 0)
+      read_args(&msg);
+  }
+  uint64_t elapsed = bench_now_ns() - t0;
+  bench_report(name, ITER, elapsed);
+  printf("# %s: %.0f MB/s\n", name,
+         (double)len * ITER / ((double)elapsed / 1e9) / 1e6);
+}
+
+static void run_decode(const char *name, bool bulk, char *buf, int len) {
+  tosc_message msg;
+  float v[32];
+  tosc_parseMessageChecked(&msg, buf, len);
+  uint64_t t0 = bench_now_ns();
+  for (int i = 0; i < ITER; i++) {
+    tosc_reset(&msg);
+    if (bulk) {
+      tosc_getNextFloats(&msg, v, 32);
+    } else {
+      for (int k = 0; k < 32; k++)
+        v[k] = tosc_getNextFloat(&msg);
+    }
+    __asm__ volatile("" : : "r"(v) : "memory");
+  }
+  bench_report(name, ITER, bench_now_ns() - t0);
+  bench_sink += (uint64_t)v[31];
+}
+
+int main(void) {
+  static char flt[64], str[64], lut[256];
+  int flt_len = tosc_writeMessage(flt, sizeof(flt), "/send/1/brightness", "f",
+                                  0.5f);
+  int str_len = tosc_writeMessage(str, sizeof(str), "/input/2/chroma_subsampling",
+                                  "s", "4:2:2");
+  float p[32];
+  for (int i = 0; i < 32; i++)
+    p[i] = (float)i / 31;
+  int lut_len = tosc_writeMessage(
+      lut, sizeof(lut), "/send/3/lut/G", "ffffffffffffffffffffffffffffffff",
+      p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10],
+      p[11], p[12], p[13], p[14], p[15], p[16], p[17], p[18], p[19], p[20],
+      p[21], p[22], p[23], p[24], p[25], p[26], p[27], p[28], p[29], p[30],
+      p[31]);
+
+  run("parse/float", tosc_parseMessage, flt, flt_len);
+  run("parse/float_checked", tosc_parseMessageChecked, flt, flt_len);
+  run("parse/string", tosc_parseMessage, str, str_len);
+  run("parse/string_checked", tosc_parseMessageChecked, str, str_len);
+  run("parse/lut", tosc_parseMessage, lut, lut_len);
+  run("parse/lut_checked", tosc_parseMessageChecked, lut, lut_len);
+  run_decode("decode/lut_scalar", false, lut, lut_len);
+  run_decode("decode/lut_bulk", true, lut, lut_len);
+  return 0;
+}
@@ -0,0 +1,220 @@
+// Address patterns sent by clients: compiling one to its DFA, matching
+// it, and a GET or SET of many fields in one message against the same
+// fields one message each.
+//
+// pattern/compile     osc_pattern_compile of /send/{1,3}/lut/[RGB]
+// pattern/match       one address through a compiled DFA
+// pattern/get_16      GET /send/*/lut/*, all sixteen LUTs in bundles
+// pattern/get_16_single  the same sixteen LUTs as sixteen GETs
+// pattern/set_4       SET /send/*/brightness
+// pattern/set_4_single   the same as four SETs
+//
+// Before timing, the matcher is checked against each piece of pattern
+// syntax, and GETs and SETs through dispatch_message against the fields
+// they must reach; a failure exits 1.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_pattern.h"
+#include "tinyosc.h"
+
+#define ITER     200000
+#define ITER_DFA 2000000
+
+typedef struct {
+  const char *pattern, *address;
+  bool        match;
+} match_case;
+
+static const match_case cases[] = {
+    {"/send/*/brightness", "/send/3/brightness", true},
+    {"/send/*/brightness", "/send/3/lut/R", false},
+    {"/send/*", "/send/1/hue", false},
+    {"/send/?/hue", "/send/4/hue", true},
+    {"/send/?/hue", "/send/10/hue", false},
+    {"/send/[!1-3]/hue", "/send/4/hue", true},
+    {"/send/[!1-3]/hue", "/send/2/hue", false},
+    {"/send/[^1-3]/hue", "/send/2/hue", false},
+    {"/send/{1,3}/lut/[RGB]", "/send/3/lut/G", true},
+    {"/send/{1,3}/lut/[RGB]", "/send/2/lut/G", false},
+    {"/send/{1,3}/lut/[RGB]", "/send/1/lut/Y", false},
+    {"/send/{1,3,}/hue", "/send//hue", true},
+    {"/send//hue", "/send/1/hue", true},
+    {"//hue", "/send/1/hue", true},
+    {"//hue", "/send/1/huey", false},
+    {"/analog_format//[0-2]", "/analog_format/color_matrix/1/2", true},
+    {"/*/*/*", "/send/1/hue", true},
+    {"/s*d/*/h*e", "/send/2/hue", true},
+};
+
+static const char *malformed[] = {"/send/[1-4/hue", "/send/{1,2/hue"};
+
+static int replies, errors;
+
+// counts the messages of each reply, and /error replies apart
+static size_t count_send(connectionT *conn, const void *buf, size_t len) {
+  char copy[1500];
+  if (len > sizeof(copy))
+    return len;
+  memcpy(copy, buf, len);
+  if (!tosc_isBundle(copy)) {
+    if (strcmp(copy, "/error") == 0)
+      errors++;
+    else
+      replies++;
+    return len;
+  }
+  tosc_bundle b;
+  tosc_message m;
+  tosc_parseBundle(&b, copy, (int)len);
+  while (tosc_getNextMessage(&b, &m))
+    replies++;
+  return len;
+}
+
+typedef struct {
+  char         buf[256];
+  tosc_message msg;
+  char        *args; // where a handler starts reading
+} bench_msg;
+
+static void make_get(bench_msg *b, const char *address) {
+  int len = tosc_writeMessage(b->buf, sizeof(b->buf), address, "");
+  tosc_parseMessage(&b->msg, b->buf, len);
+  b->args = b->msg.marker;
+}
+
+static void make_set(bench_msg *b, const char *address, float v) {
+  int len = tosc_writeMessage(b->buf, sizeof(b->buf), address, "f", v);
+  tosc_parseMessage(&b->msg, b->buf, len);
+  b->args = b->msg.marker;
+}
+
+static connectionT conn = {.send = count_send};
+
+static void dispatch(bench_msg *b) {
+  b->msg.marker = b->args;
+  dispatch_message(&b->msg, &conn);
+}
+
+static float send_float(int n, size_t offset) {
+  float v;
+  OSC_SEQLOCK_READ(&config_send_lock[n], v,
+                   *(float *)((char *)&config.send[n] + offset));
+  return v;
+}
+
+static int check(void) {
+  osc_pattern p;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    if (osc_pattern_compile(&p, cases[i].pattern) < 0 ||
+        osc_pattern_match(&p, cases[i].address) != cases[i].match) {
+      printf("ERROR: %s %s %s\n", cases[i].pattern,
+             cases[i].match ? "should match" : "should not match",
+             cases[i].address);
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+    if (osc_pattern_compile(&p, malformed[i]) == 0) {
+      printf("ERROR: %s compiled\n", malformed[i]);
+      return 1;
+    }
+  }
+
+  bench_msg b;
+  make_get(&b, "/send/{1,3}/lut/[RGB]");
+  replies = errors = 0;
+  dispatch(&b);
+  if (replies != 6 || errors) {
+    printf("ERROR: GET /send/{1,3}/lut/[RGB] got %d replies\n", replies);
+    return 1;
+  }
+
+  make_set(&b, "/send/*/hue", 0.25f);
+  dispatch(&b);
+  for (int n = 0; n < 4; n++) {
+    if (send_float(n, offsetof(ConfigSend, hue)) != 0.25f) {
+      printf("ERROR: SET /send/*/hue missed send %d\n", n + 1);
+      return 1;
+    }
+  }
+
+  // the ints and LUTs of /send/1/* take other type tags; the floats apply
+  make_set(&b, "/send/1/*", 0.5f);
+  replies = errors = 0;
+  dispatch(&b);
+  if (errors || send_float(0, offsetof(ConfigSend, yaw)) != 0.5f) {
+    printf("ERROR: SET /send/1/* did not set the floats\n");
+    return 1;
+  }
+
+  const char *refused[] = {"/send/*/lut/*", "/nothing/*", "/send/[1-4/hue"};
+  for (int k = 0; k < 3; k++) {
+    make_set(&b, refused[k], 1.0f);
+    errors = 0;
+    dispatch(&b);
+    if (errors != 1) {
+      printf("ERROR: SET %s was not refused\n", refused[k]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  dispatch_init();
+  if (check())
+    return 1;
+
+  osc_pattern p;
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    bench_sink += osc_pattern_compile(&p, "/send/{1,3}/lut/[RGB]");
+  bench_report("pattern/compile", ITER, bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (int i = 0; i < ITER_DFA; i++)
+    bench_sink += osc_pattern_match(&p, "/send/3/lut/G");
+  bench_report("pattern/match", ITER_DFA, bench_now_ns() - start);
+
+  bench_msg get;
+  make_get(&get, "/send/*/lut/*");
+  start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    dispatch(&get);
+  bench_report("pattern/get_16", ITER, bench_now_ns() - start);
+
+  bench_msg gets[16];
+  char path[64];
+  for (int n = 0; n < 16; n++) {
+    snprintf(path, sizeof(path), "/send/%d/lut/%c", n / 4 + 1, "YRGB"[n % 4]);
+    make_get(&gets[n], path);
+  }
+  start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    for (int n = 0; n < 16; n++)
+      dispatch(&gets[n]);
+  bench_report("pattern/get_16_single", ITER, bench_now_ns() - start);
+
+  bench_msg set, sets[4];
+  make_set(&set, "/send/*/brightness", 0.5f);
+  for (int n = 0; n < 4; n++) {
+    snprintf(path, sizeof(path), "/send/%d/brightness", n + 1);
+    make_set(&sets[n], path, 0.5f);
+  }
+  start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    dispatch(&set);
+  bench_report("pattern/set_4", ITER, bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    for (int n = 0; n < 4; n++)
+      dispatch(&sets[n]);
+  bench_report("pattern/set_4_single", ITER, bench_now_ns() - start);
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Persistent config: what a save costs the background thread, and how
+// long a restart takes to get the state back.
+//
+// persist/save        a changed config written to the spare slot and
+//                     msynced, then the header flipped and msynced
+// persist/unchanged   the check the thread makes when nothing changed
+// persist/restore     mapping the file and copying the state into config
+//
+// Before timing: a new file starts from the defaults, a saved SET comes
+// back after a restart, and a torn slot falls back to the other one; a
+// failure exits 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_persist.h"
+#include "tinyosc.h"
+
+#define SAVES    50
+#define CHECKS   20000
+#define RESTORES 500
+
+static int check(const char *path) {
+  osc_persist p;
+  if (osc_persist_open(&p, path) < 0)
+    return 1;
+  if (p.stats.restored != -1) {
+    printf("ERROR: a new file restored state\n");
+    return 1;
+  }
+  bench_set("/send/1/posX", "f", 0.25f);
+  if (osc_persist_save(&p) != 1 || osc_persist_save(&p) != 0) {
+    printf("ERROR: a SET was not saved exactly once\n");
+    return 1;
+  }
+  osc_persist_close(&p);
+
+  config.send[0].posX = 0.0f;
+  if (osc_persist_open(&p, path) < 0)
+    return 1;
+  if (config.send[0].posX != 0.25f || p.stats.restored != 1) {
+    printf("ERROR: restart restored posX %g from slot %d\n",
+           config.send[0].posX, p.stats.restored);
+    return 1;
+  }
+  // a crash half way through writing the slot the header names
+  p.slot[p.header->active]->config.send[0].posX = 0.5f;
+  osc_persist_close(&p);
+
+  if (osc_persist_open(&p, path) < 0)
+    return 1;
+  if (p.stats.restored != 0 || config.send[0].posX != 0.0f) {
+    printf("ERROR: a torn slot restored posX %g from slot %d\n",
+           config.send[0].posX, p.stats.restored);
+    return 1;
+  }
+  osc_persist_close(&p);
+  return 0;
+}
+
+int main(void) {
+  char path[] = "/tmp/bench_persist.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  dispatch_init();
+  int bad = check(path);
+
+  osc_persist p;
+  if (!bad && osc_persist_open(&p, path) == 0) {
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < SAVES; i++) {
+      bench_set("/send/1/posY", "f", (float)(i + 1) / SAVES);
+      bad |= osc_persist_save(&p) != 1;
+    }
+    bench_report("persist/save", SAVES, bench_now_ns() - start);
+
+    start = bench_now_ns();
+    for (int i = 0; i < CHECKS; i++)
+      bench_sink += osc_persist_save(&p);
+    bench_report("persist/unchanged", CHECKS, bench_now_ns() - start);
+    osc_persist_close(&p);
+
+    start = bench_now_ns();
+    for (int i = 0; i < RESTORES; i++) {
+      bad |= osc_persist_open(&p, path) < 0;
+      osc_persist_close(&p);
+    }
+    bench_report("persist/restore", RESTORES, bench_now_ns() - start);
+    if (bad)
+      printf("ERROR: a save or restore failed\n");
+  }
+  unlink(path);
+  return bad;
+}
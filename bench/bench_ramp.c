@@ -0,0 +1,128 @@
+// Parameter ramps: a frame step's cost against the number of ramps
+// running.
+//
+// ramp/step_active=N   one dispatch_ramps with N fields ramping, each of
+//                      which moves and is re-encoded in the state image
+// ramp/start           a /ramp message through dispatch_message
+//
+// Before timing, a linear ramp is checked halfway and at its end, a SET
+// must cancel a ramp of its field, and an input field must be refused;
+// a failure exits 1.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "tinyosc.h"
+
+#define STEPS  20000
+#define STARTS 200000
+#define SEC    1000000000ull
+
+static const char *send_fields[] = {
+    "scaleX",     "scaleY",   "posX",       "posY", "rotation", "pitch",
+    "yaw",        "brightness", "contrast", "saturation", "hue"};
+
+static void ramp(const char *addr, float target, float seconds,
+                 const char *curve) {
+  bench_set("/ramp", "sffs", addr, target, seconds, curve);
+}
+
+static float brightness(void) {
+  float v;
+  OSC_SEQLOCK_READ(&config_send_lock[0], v, config.send[0].brightness);
+  return v;
+}
+
+static int check(void) {
+  osc_ramp_stats st;
+  bench_set("/send/1/brightness", "f", 0.0f);
+  uint64_t start = bench_now_ns();
+  ramp("/send/1/brightness", 1.0f, 1.0f, "linear");
+  dispatch_ramps(start + SEC / 2);
+  float half = brightness();
+  if (half < 0.49f || half > 0.51f) {
+    printf("ERROR: halfway through a linear ramp is %g\n", half);
+    return 1;
+  }
+  dispatch_ramps(start + 2 * SEC);
+  dispatch_ramp_stats(&st);
+  if (brightness() != 1.0f || st.finished != 1) {
+    printf("ERROR: ramp ended at %g, %llu finished\n", brightness(),
+           (unsigned long long)st.finished);
+    return 1;
+  }
+
+  ramp("/send/1/brightness", 0.0f, 1.0f, "ease_in_out");
+  bench_set("/send/1/brightness", "f", 0.25f);
+  dispatch_ramps(bench_now_ns() + SEC / 2);
+  dispatch_ramp_stats(&st);
+  if (brightness() != 0.25f || st.cancelled != 1) {
+    printf("ERROR: a SET left brightness at %g, %llu cancelled\n",
+           brightness(), (unsigned long long)st.cancelled);
+    return 1;
+  }
+
+  printf("# refusing an input field:\n");
+  ramp("/input/1/framerate", 30.0f, 1.0f, "linear");
+  dispatch_ramp_stats(&st);
+  if (st.started != 2) {
+    printf("ERROR: an input field was ramped\n");
+    return 1;
+  }
+  return 0;
+}
+
+static void step_bench(int active) {
+  char path[OSC_IMAGE_PATH_LEN];
+  int n = 0;
+  for (int s = 0; s < 4 && n < active; s++) {
+    for (size_t f = 0; f < sizeof(send_fields) / sizeof(send_fields[0]) &&
+                       n < active;
+         f++, n++) {
+      snprintf(path, sizeof(path), "/send/%d/%s", s + 1, send_fields[f]);
+      ramp(path, 1.0f, 1000.0f, "ease_in_out");
+    }
+  }
+
+  uint64_t now = bench_now_ns();
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < STEPS; i++)
+    bench_sink += dispatch_ramps(now + (uint64_t)i * 16666667ull);
+  uint64_t ns = bench_now_ns() - start;
+
+  char name[64];
+  snprintf(name, sizeof(name), "ramp/step_active=%d", active);
+  bench_report(name, STEPS, ns);
+
+  // a SET of each field ends its ramp
+  n = 0;
+  for (int s = 0; s < 4 && n < active; s++) {
+    for (size_t f = 0; f < sizeof(send_fields) / sizeof(send_fields[0]) &&
+                       n < active;
+         f++, n++) {
+      snprintf(path, sizeof(path), "/send/%d/%s", s + 1, send_fields[f]);
+      bench_set(path, "f", 0.5f);
+    }
+  }
+}
+
+int main(void) {
+  dispatch_init();
+  if (check())
+    return 1;
+
+  const int active[] = {0, 1, 8, 44};
+  for (int i = 0; i < 4; i++)
+    step_bench(active[i]);
+
+  char buf[128];
+  int len = tosc_writeMessage(buf, sizeof(buf), "/ramp", "sffs",
+                              "/send/2/hue", 0.5f, 10.0f, "linear");
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < STARTS; i++)
+    bench_dispatch(buf, len);
+  bench_report("ramp/start", STARTS, bench_now_ns() - start);
+  return 0;
+}
@@ -0,0 +1,194 @@
+// Per-peer output queues: what the send path pays to check for queued
+// output, and queueing and draining the replies a full socket refused.
+//
+// session/find_empty   osc_session_find with nothing queued, every send
+// session/find_hit     a peer among 48 with output queued
+// session/queue_drain  sixteen replies queued, then sent with the drain
+//
+// Before timing, a full socket must leave replies queued in order, a full
+// queue must coalesce a message to an address already queued and drop
+// the rest, draining must resume once the socket has room, and draining
+// one socket must leave the peers of another findable; a failure exits 1.
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_session.h"
+#include "tinyosc.h"
+
+#define ITER       2000000
+#define ITER_DRAIN 100000
+
+static osc_session_table table;
+
+static socklen_t unix_addr(struct sockaddr_un *sun, const char *name) {
+  memset(sun, 0, sizeof(*sun));
+  sun->sun_family = AF_UNIX;
+  // abstract: sun_path[0] is NUL
+  strncpy(sun->sun_path + 1, name, sizeof(sun->sun_path) - 2);
+  return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 +
+                     strlen(name));
+}
+
+static struct sockaddr_in peer(int i) {
+  struct sockaddr_in sin = {0};
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons((uint16_t)(20000 + i));
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return sin;
+}
+
+static int message(char *buf, int i, float v) {
+  char addr[32];
+  snprintf(addr, sizeof(addr), "/send/%d/hue", i);
+  return tosc_writeMessage(buf, 64, addr, "f", v);
+}
+
+// a receiver nobody reads until its queue is full makes sends fail with
+// EAGAIN, as a slow peer would
+static int check_queue(void) {
+  struct sockaddr_un sun;
+  socklen_t sun_len = unix_addr(&sun, "osc_bench_session");
+  int rx = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  int tx = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (bind(rx, (struct sockaddr *)&sun, sun_len) < 0) {
+    perror("bind");
+    return 1;
+  }
+  char buf[64];
+  int len = message(buf, 0, 0.0f);
+  int filled = 0;
+  while (sendto(tx, buf, len, 0, (struct sockaddr *)&sun, sun_len) > 0)
+    filled++;
+
+  osc_session_init(&table);
+  for (int i = 0; i < OSC_SESSION_DEPTH + 1; i++) {
+    len = message(buf, i + 1, 0.25f);
+    osc_session_queue(&table, tx, (struct sockaddr *)&sun, sun_len, buf, len);
+  }
+  len = message(buf, 3, 0.75f); // coalesces with the third
+  osc_session_queue(&table, tx, (struct sockaddr *)&sun, sun_len, buf, len);
+  osc_io_stats io = {0};
+  if (table.stats.queued != OSC_SESSION_DEPTH || table.stats.dropped != 1 ||
+      table.stats.coalesced != 1 || osc_session_drain(&table, tx, &io) != 1) {
+    printf("ERROR: full queue: %llu queued, %llu coalesced, %llu dropped\n",
+           (unsigned long long)table.stats.queued,
+           (unsigned long long)table.stats.coalesced,
+           (unsigned long long)table.stats.dropped);
+    return 1;
+  }
+
+  // the reader catches up, a queue's worth at a time; each drain sends
+  // what fits and the last one must free the session
+  for (int i = 0; i < filled; i++)
+    recv(rx, buf, sizeof(buf), 0);
+  char got[OSC_SESSION_DEPTH][64];
+  int got_len[OSC_SESSION_DEPTH], n = 0, left = 1;
+  for (int round = 0; left && round < OSC_SESSION_DEPTH; round++) {
+    left = osc_session_drain(&table, tx, &io);
+    while (n < OSC_SESSION_DEPTH &&
+           (got_len[n] = (int)recv(rx, got[n], sizeof(got[n]), 0)) > 0)
+      n++;
+  }
+  if (left || osc_session_any(&table) || n != OSC_SESSION_DEPTH) {
+    printf("ERROR: the drain left a session, %d replies read\n", n);
+    return 1;
+  }
+  for (int i = 0; i < OSC_SESSION_DEPTH; i++) {
+    tosc_message m;
+    char want[32];
+    snprintf(want, sizeof(want), "/send/%d/hue", i + 1);
+    if (tosc_parseMessageChecked(&m, got[i], got_len[i]) != 0 ||
+        strcmp(got[i], want) != 0 ||
+        tosc_getNextFloat(&m) != (i == 2 ? 0.75f : 0.25f)) {
+      printf("ERROR: queued reply %d came back wrong\n", i);
+      return 1;
+    }
+  }
+  close(rx);
+  close(tx);
+  return 0;
+}
+
+// peers of two sockets interleaved in the table: draining one must not
+// lose the others from the probe runs
+static int check_table(int fd_a, int fd_b) {
+  osc_session_init(&table);
+  char buf[64];
+  int len = message(buf, 1, 0.5f);
+  for (int i = 0; i < OSC_SESSION_MAX + 1; i++) {
+    struct sockaddr_in sin = peer(i);
+    osc_session_queue(&table, i % 2 ? fd_b : fd_a, (struct sockaddr *)&sin,
+                      sizeof(sin), buf, len);
+  }
+  osc_io_stats io = {0};
+  if (table.count != OSC_SESSION_MAX || table.stats.dropped != 1 ||
+      osc_session_drain(&table, fd_a, &io) != 0 ||
+      table.count != OSC_SESSION_MAX / 2) {
+    printf("ERROR: %d sessions after draining one socket\n", table.count);
+    return 1;
+  }
+  for (int i = 0; i < OSC_SESSION_MAX; i++) {
+    struct sockaddr_in sin = peer(i);
+    osc_session *s = osc_session_find(&table, i % 2 ? fd_b : fd_a,
+                                      (struct sockaddr *)&sin, sizeof(sin));
+    if ((s != NULL) != (i % 2 == 1)) {
+      printf("ERROR: peer %d %s\n", i, s ? "still queued" : "lost");
+      return 1;
+    }
+  }
+  osc_session_drain(&table, fd_b, &io);
+  return table.count != 0;
+}
+
+int main(void) {
+  // a UDP socket sending to closed loopback ports always has room
+  int fd_a = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  int fd_b = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (check_queue() || check_table(fd_a, fd_b))
+    return 1;
+
+  osc_session_init(&table);
+  struct sockaddr_in sin = peer(99);
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    bench_sink += osc_session_find(&table, fd_a, (struct sockaddr *)&sin,
+                                   sizeof(sin)) != NULL;
+  bench_report("session/find_empty", ITER, bench_now_ns() - start);
+
+  char buf[64];
+  int len = message(buf, 1, 0.5f);
+  for (int i = 0; i < 48; i++) {
+    sin = peer(i);
+    osc_session_queue(&table, fd_b, (struct sockaddr *)&sin, sizeof(sin), buf,
+                      len);
+  }
+  sin = peer(17);
+  start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    bench_sink += osc_session_find(&table, fd_b, (struct sockaddr *)&sin,
+                                   sizeof(sin)) != NULL;
+  bench_report("session/find_hit", ITER, bench_now_ns() - start);
+  osc_session_clear(&table);
+
+  osc_io_stats io = {0};
+  sin = peer(1);
+  start = bench_now_ns();
+  for (int i = 0; i < ITER_DRAIN; i++) {
+    for (int k = 0; k < OSC_SESSION_DEPTH; k++)
+      osc_session_queue(&table, fd_a, (struct sockaddr *)&sin, sizeof(sin),
+                        buf, len);
+    osc_session_drain(&table, fd_a, &io);
+  }
+  bench_report("session/queue_drain", (uint64_t)ITER_DRAIN * OSC_SESSION_DEPTH,
+               bench_now_ns() - start);
+  close(fd_a);
+  close(fd_b);
+  return 0;
+}
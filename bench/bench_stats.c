@@ -0,0 +1,162 @@
+// Dispatch statistics: what recording costs per message, and the /stats
+// reply.
+//
+// stats/record        the counters and four histogram samples one
+//                     dispatched message records
+// stats/clock         one osc_stats_now; dispatch reads it three times
+// stats/get           a GET through dispatch_message, recording included
+// stats/read          a /stats GET, summing every shard
+//
+// Before timing, a /stats reply must carry the message counter and a
+// /stats/handler line for each dispatched entry, one that only a pattern
+// SET reached included, and a reset must zero them.  A pattern GET must
+// record every phase, its send included, for each field it reads.  A
+// failure exits 1.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_stats.h"
+#include "tinyosc.h"
+
+#define ITERATIONS 2000000
+#define READS      2000
+
+static char    reply[2048];
+static int     reply_len;
+static int64_t messages = -1;
+static int     handler_lines;
+
+// keeps the last /stats bundle and picks out what check wants
+static size_t capture_send(connectionT *conn, const void *buf, size_t len) {
+  reply_len = len < sizeof(reply) ? (int)len : (int)sizeof(reply);
+  memcpy(reply, buf, reply_len);
+  if (!tosc_isBundle(reply))
+    return len;
+  tosc_bundle b;
+  tosc_message m;
+  tosc_parseBundle(&b, reply, reply_len);
+  while (tosc_getNextMessage(&b, &m)) {
+    if (strcmp(m.buffer, "/stats/messages") == 0)
+      messages = tosc_getNextInt64(&m);
+    else if (strcmp(m.buffer, "/stats/handler") == 0)
+      handler_lines++;
+  }
+  return len;
+}
+
+// a send that takes 100 ticks, as the server's would note
+static size_t timed_send(connectionT *conn, const void *buf, size_t len) {
+  osc_stats_note_send(100);
+  return len;
+}
+
+static void dispatch(const char *addr, const char *fmt, const char *s,
+                     connectionT *conn) {
+  char buf[128];
+  tosc_message msg;
+  int len = fmt[0] ? tosc_writeMessage(buf, sizeof(buf), (char *)addr,
+                                       (char *)fmt, s)
+                   : tosc_writeMessage(buf, sizeof(buf), (char *)addr, "");
+  tosc_parseMessage(&msg, buf, len);
+  dispatch_message(&msg, conn);
+}
+
+static void read_stats(void) {
+  connectionT conn = {0};
+  conn.send = capture_send;
+  messages = -1;
+  handler_lines = 0;
+  dispatch("/stats", "", NULL, &conn);
+}
+
+static int check(void) {
+  connectionT conn = {0};
+  conn.send = bench_stub_send;
+  dispatch("/send/1/hue", "", NULL, &conn);
+  dispatch("/send/2/hue", "", NULL, &conn);
+  read_stats();
+  // the /stats GET itself counts
+  if (messages != 3 || handler_lines < 2) {
+    printf("ERROR: /stats reported %lld messages, %d handler lines\n",
+           (long long)messages, handler_lines);
+    return 1;
+  }
+
+  conn.send = capture_send;
+  dispatch("/stats", "s", "reset", &conn);
+  read_stats();
+  if (messages != 1 || handler_lines != 1) {
+    printf("ERROR: after a reset /stats reported %lld messages, %d handler "
+           "lines\n",
+           (long long)messages, handler_lines);
+    return 1;
+  }
+
+  // an entry reached only through an address pattern is listed too
+  bench_set("/send/*/brightness", "f", 0.5f);
+  read_stats();
+  if (handler_lines != 2) {
+    printf("ERROR: a pattern SET left %d handler lines\n", handler_lines);
+    return 1;
+  }
+
+  conn.send = timed_send;
+  dispatch("/send/*/hue", "", NULL, &conn);
+  int entry = 0;
+  while (strcmp(dispatch_table[entry].path_pattern, "/send/[1-4]/hue") != 0)
+    entry++;
+  for (int p = 0; p < OSC_PHASE_COUNT; p++) {
+    osc_hist_summary sum;
+    osc_stats_summary(entry, p, &sum);
+    if (sum.count != 4) {
+      printf("ERROR: a pattern GET of 4 fields recorded phase %d %llu "
+             "times\n",
+             p, (unsigned long long)sum.count);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  dispatch_init();
+  if (check())
+    return 1;
+
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++) {
+    osc_stats_count(OSC_STAT_MESSAGES, 1);
+    osc_stats_record(1, OSC_PHASE_PARSE, (uint64_t)i & 1023);
+    osc_stats_record(1, OSC_PHASE_MATCH, (uint64_t)i & 511);
+    osc_stats_record(1, OSC_PHASE_HANDLER, (uint64_t)i & 4095);
+    osc_stats_record(1, OSC_PHASE_SEND, (uint64_t)i & 2047);
+  }
+  bench_report("stats/record", ITERATIONS, bench_now_ns() - start);
+
+  uint64_t sum = 0;
+  start = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++)
+    sum += osc_stats_now();
+  bench_report("stats/clock", ITERATIONS, bench_now_ns() - start);
+  bench_sink = sum;
+
+  char buf[64];
+  tosc_message msg;
+  int len = tosc_writeMessage(buf, sizeof(buf), "/send/3/brightness", "");
+  tosc_parseMessage(&msg, buf, len);
+  connectionT conn = {0};
+  conn.send = bench_stub_send;
+  start = bench_now_ns();
+  for (int i = 0; i < ITERATIONS; i++)
+    dispatch_message(&msg, &conn);
+  bench_report("stats/get", ITERATIONS, bench_now_ns() - start);
+
+  start = bench_now_ns();
+  for (int i = 0; i < READS; i++)
+    read_stats();
+  bench_report("stats/read", READS, bench_now_ns() - start);
+  return 0;
+}
@@ -0,0 +1,348 @@
+// OSC over TCP: the streaming decoder, the output queue, and a GET round
+// trip through a server's TCP listener.
+//
+// stream/decode_slip         SLIP frames read 4 KiB at a time
+// stream/decode_slip_split   the same read 7 bytes at a time
+// stream/decode_length       length-prefixed frames read 4 KiB at a time
+// stream/send                osc_stream_send of a reply to a socketpair
+// tcp/get_roundtrip          GET /send/2/hue and its reply over loopback
+//
+// Before timing, frames holding END and ESC bytes must decode intact for
+// both framings however the stream is split, an oversized frame must be
+// skipped or refused, a full queue must drop whole frames only, and a SET
+// split across two writes must reach config through the server; a
+// failure exits 1.
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_server.h"
+#include "osc_stream.h"
+#include "tinyosc.h"
+
+#define FRAMES     64
+#define ITER       20000
+#define ITER_SEND  2000000
+#define ITER_RTT   20000
+#define TCP_PORT   19200
+
+static char frames[FRAMES][64];
+static int frame_len[FRAMES];
+
+// the stream every decode check and bench reads
+static char stream[FRAMES * 2 * 70];
+static size_t stream_len;
+
+// what the decoder passed on
+static char got[FRAMES][64];
+static size_t got_len[FRAMES];
+static int got_count;
+
+static size_t collect(connectionT *conn, const void *buf, size_t len) {
+  if (len <= sizeof(got[0])) {
+    memcpy(got[got_count % FRAMES], buf, len);
+    got_len[got_count % FRAMES] = len;
+  }
+  got_count++;
+  return len;
+}
+
+static size_t count_frame(connectionT *conn, const void *buf, size_t len) {
+  got_count++;
+  return len;
+}
+
+static void build_frames(void) {
+  for (int i = 0; i < FRAMES; i++) {
+    char addr[48];
+    snprintf(addr, sizeof(addr), "/send/%d/hue", 1 + i % 4);
+    // -0x1.8p-62 and friends put 0xC0 and 0xDB bytes in the payload
+    float v = i % 3 == 0 ? -6.0f : i % 3 == 1 ? -1.5f * 0x1p-62f : 0.5f;
+    frame_len[i] = tosc_writeMessage(frames[i], sizeof(frames[i]), addr, "fi",
+                                     v, i % 2 ? 0xdbc0 : 0xc0db00);
+  }
+}
+
+static void build_stream(osc_stream_framing f) {
+  stream_len = 0;
+  for (int i = 0; i < FRAMES; i++)
+    stream_len += osc_stream_encode(f, frames[i], frame_len[i],
+                                    stream + stream_len,
+                                    sizeof(stream) - stream_len);
+}
+
+// feeds the stream chunk bytes at a time; returns the frames decoded
+static int decode(osc_stream_framing f, size_t chunk, connectionT *conn,
+                  osc_stream_stats *st) {
+  osc_stream_decoder d;
+  osc_stream_decoder_init(&d, f);
+  static char buf[sizeof(stream) + 4];
+  int n = 0;
+  for (size_t off = 0; off < stream_len; off += chunk) {
+    size_t len = stream_len - off < chunk ? stream_len - off : chunk;
+    // copied to the start of a read buffer, as recv would leave it
+    memcpy(buf, stream + off, len);
+    n += osc_stream_feed(&d, buf, len, conn, st);
+  }
+  osc_stream_decoder_free(&d);
+  return n;
+}
+
+static int check_decode(osc_stream_framing f, const char *name) {
+  connectionT conn = {.receive = collect};
+  osc_stream_stats st = {0};
+  build_stream(f);
+  for (size_t chunk = 1; chunk <= stream_len; chunk += chunk < 80 ? 1 : 97) {
+    got_count = 0;
+    decode(f, chunk, &conn, &st);
+    if (got_count != FRAMES) {
+      printf("ERROR: %s read %zu bytes at a time gave %d frames\n", name,
+             chunk, got_count);
+      return 1;
+    }
+    for (int i = 0; i < FRAMES; i++) {
+      if (got_len[i] != (size_t)frame_len[i] ||
+          memcmp(got[i], frames[i], got_len[i]) != 0) {
+        printf("ERROR: %s frame %d corrupt read %zu bytes at a time\n", name,
+               i, chunk);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int check_oversized(void) {
+  connectionT conn = {.receive = collect};
+  osc_stream_stats st = {0};
+  osc_stream_decoder d;
+  static char big[OSC_STREAM_MAX_FRAME + 64];
+
+  // SLIP: skipped up to its END, and the next frame still decodes
+  osc_stream_decoder_init(&d, OSC_STREAM_SLIP);
+  memset(big, 'x', sizeof(big));
+  big[0] = (char)OSC_SLIP_END;
+  size_t n = osc_stream_encode(OSC_STREAM_SLIP, frames[1], frame_len[1],
+                               big + sizeof(big) - 60, 60);
+  got_count = 0;
+  osc_stream_feed(&d, big, sizeof(big) - 60 + n, &conn, &st);
+  osc_stream_decoder_free(&d);
+  if (got_count != 1 || st.oversized != 1 ||
+      memcmp(got[0], frames[1], frame_len[1]) != 0) {
+    printf("ERROR: oversized SLIP frame was not skipped\n");
+    return 1;
+  }
+
+  // length: the stream cannot be followed
+  osc_stream_decoder_init(&d, OSC_STREAM_LENGTH);
+  char head[4] = {0, 0x10, 0, 0};
+  int r = osc_stream_feed(&d, head, 4, &conn, &st);
+  osc_stream_decoder_free(&d);
+  if (r != -1) {
+    printf("ERROR: oversized length frame was accepted\n");
+    return 1;
+  }
+  return 0;
+}
+
+// fills a socketpair nobody reads until frames drop, then drains it; every
+// frame read back must be whole and in order
+static int check_queue(void) {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0)
+    return 1;
+  osc_stream_out q;
+  osc_stream_out_init(&q);
+  osc_stream_stats st = {0};
+  int sent = 0;
+  for (int i = 0; st.dropped == 0; i++)
+    sent += osc_stream_send(sv[0], OSC_STREAM_SLIP, &q, frames[i % FRAMES],
+                            frame_len[i % FRAMES], &st) > 0;
+
+  connectionT conn = {.receive = count_frame};
+  osc_stream_decoder d;
+  osc_stream_decoder_init(&d, OSC_STREAM_SLIP);
+  osc_stream_stats rst = {0};
+  static char buf[65536];
+  got_count = 0;
+  for (;;) {
+    ssize_t n = recv(sv[1], buf, sizeof(buf), 0);
+    if (n > 0) {
+      osc_stream_feed(&d, buf, (size_t)n, &conn, &rst);
+      continue;
+    }
+    if (osc_stream_out_pending(&q) == 0)
+      break;
+    osc_stream_flush(sv[0], &q);
+  }
+  osc_stream_decoder_free(&d);
+  osc_stream_out_free(&q);
+  close(sv[0]);
+  close(sv[1]);
+  if (got_count != sent || st.queued == 0) {
+    printf("ERROR: %d frames sent, %d read back\n", sent, got_count);
+    return 1;
+  }
+  return 0;
+}
+
+static void *server_thread(void *arg) {
+  osc_server_run(arg);
+  return NULL;
+}
+
+static int tcp_connect(void) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sin = {0};
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(TCP_PORT);
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+    perror("connect");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// blocks until the decoder has passed on one more frame
+static int read_frame(int fd, osc_stream_decoder *d, connectionT *conn) {
+  static char buf[4096];
+  osc_stream_stats st = {0};
+  int want = got_count + 1;
+  while (got_count < want) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+      return -1;
+    osc_stream_feed(d, buf, (size_t)n, conn, &st);
+  }
+  return 0;
+}
+
+static int send_framed(int fd, const char *msg, int len) {
+  char out[256];
+  size_t n = osc_stream_encode(OSC_STREAM_SLIP, msg, len, out, sizeof(out));
+  return send(fd, out, n, 0) == (ssize_t)n ? 0 : -1;
+}
+
+static float reply_float(void) {
+  tosc_message m;
+  int last = (got_count - 1) % FRAMES;
+  if (tosc_parseMessageChecked(&m, got[last], (int)got_len[last]) != 0 ||
+      m.format[0] != 'f')
+    return -1.0f;
+  return tosc_getNextFloat(&m);
+}
+
+static int bench_tcp(void) {
+  osc_server server = {0};
+  char udp[32], tcp[32];
+  snprintf(udp, sizeof(udp), "127.0.0.1:%d", TCP_PORT + 1);
+  snprintf(tcp, sizeof(tcp), "127.0.0.1:%d", TCP_PORT);
+  const char *specs[] = {udp};
+  if (osc_server_open(&server, specs, 1, 1, false) < 0 ||
+      osc_server_listen_stream(&server, tcp, OSC_STREAM_SLIP) < 0) {
+    osc_server_close(&server);
+    return 1;
+  }
+  server.verbose = false;
+  pthread_t srv;
+  pthread_create(&srv, NULL, server_thread, &server);
+
+  int fd = tcp_connect();
+  if (fd < 0)
+    return 1;
+  connectionT conn = {.receive = collect};
+  osc_stream_decoder d;
+  osc_stream_decoder_init(&d, OSC_STREAM_SLIP);
+
+  // a SET split across two writes, then a GET of it
+  char msg[64], framed[128];
+  int len = tosc_writeMessage(msg, sizeof(msg), "/send/2/hue", "f", 0.75f);
+  size_t n = osc_stream_encode(OSC_STREAM_SLIP, msg, len, framed,
+                               sizeof(framed));
+  send(fd, framed, 5, 0);
+  usleep(1000);
+  send(fd, framed + 5, n - 5, 0);
+  char get[64];
+  int get_len = tosc_writeMessage(get, sizeof(get), "/send/2/hue", "");
+  got_count = 0;
+  if (send_framed(fd, get, get_len) < 0 || read_frame(fd, &d, &conn) < 0 ||
+      reply_float() != 0.75f) {
+    printf("ERROR: SET over TCP did not reach /send/2/hue\n");
+    return 1;
+  }
+
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITER_RTT; i++)
+    if (send_framed(fd, get, get_len) < 0 || read_frame(fd, &d, &conn) < 0)
+      break;
+  bench_report("tcp/get_roundtrip", ITER_RTT, bench_now_ns() - start);
+
+  osc_stream_decoder_free(&d);
+  close(fd);
+  osc_server_stop(&server);
+  pthread_join(srv, NULL);
+  osc_stream_stats st;
+  osc_server_stream_stats(&server, &st);
+  osc_server_close(&server);
+  if (st.accepted != 1 || st.frames_in != ITER_RTT + 2) {
+    printf("ERROR: the server decoded %llu frames\n",
+           (unsigned long long)st.frames_in);
+    return 1;
+  }
+  return 0;
+}
+
+static void time_decode(const char *name, osc_stream_framing f,
+                        size_t chunk) {
+  connectionT conn = {.receive = count_frame};
+  osc_stream_stats st = {0};
+  build_stream(f);
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITER; i++)
+    bench_sink += decode(f, chunk, &conn, &st);
+  bench_report(name, (uint64_t)ITER * FRAMES, bench_now_ns() - start);
+}
+
+static void time_send(void) {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0)
+    return;
+  osc_stream_out q;
+  osc_stream_out_init(&q);
+  osc_stream_stats st = {0};
+  static char buf[65536];
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < ITER_SEND; i++) {
+    osc_stream_send(sv[0], OSC_STREAM_SLIP, &q, frames[2], frame_len[2], &st);
+    if ((i & 255) == 255)
+      while (recv(sv[1], buf, sizeof(buf), 0) > 0)
+        ;
+  }
+  bench_report("stream/send", ITER_SEND, bench_now_ns() - start);
+  osc_stream_out_free(&q);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+int main(void) {
+  build_frames();
+  dispatch_init();
+  if (check_decode(OSC_STREAM_SLIP, "SLIP") ||
+      check_decode(OSC_STREAM_LENGTH, "length") || check_oversized() ||
+      check_queue())
+    return 1;
+
+  time_decode("stream/decode_slip", OSC_STREAM_SLIP, 4096);
+  time_decode("stream/decode_slip_split", OSC_STREAM_SLIP, 7);
+  time_decode("stream/decode_length", OSC_STREAM_LENGTH, 4096);
+  time_send();
+  return bench_tcp();
+}
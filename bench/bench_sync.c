@@ -0,0 +1,117 @@
+// Cost of answering /sync.
+//
+// sync/per_field_*  one GET dispatch per field, one datagram each: what
+//                   sync_all did before the state image.
+// sync/image_*      a /sync dispatch, sending the pre-encoded bundles.
+//
+// *_stub counts packets with a send that does nothing; *_udp sends them
+// over loopback to a socket nobody reads.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "tinyosc.h"
+
+#define ITER_STUB 20000
+#define ITER_UDP  2000
+#define MAX_GETS  256
+
+static uint64_t packets;
+
+static size_t count_send(connectionT *conn, const void *buf, size_t len) {
+  packets++;
+  bench_sink += len;
+  return len;
+}
+
+static size_t udp_send(connectionT *conn, const void *buf, size_t len) {
+  packets++;
+  return send(conn->con.fd, buf, len, 0);
+}
+
+static char get_buf[MAX_GETS][64];
+static int get_len[MAX_GETS];
+static int get_count;
+
+// captures the address of every message of a /sync reply
+static size_t collect_send(connectionT *conn, const void *buf, size_t len) {
+  tosc_bundle bundle;
+  tosc_message msg;
+  if (!tosc_isBundle(buf))
+    return len;
+  tosc_parseBundle(&bundle, (char *)buf, (int)len);
+  while (tosc_getNextMessage(&bundle, &msg) && get_count < MAX_GETS) {
+    get_len[get_count] = tosc_writeMessage(
+        get_buf[get_count], sizeof(get_buf[0]), tosc_getAddress(&msg), "",
+        NULL);
+    get_count++;
+  }
+  return len;
+}
+
+static void run(const char *name, connectionT *conn, bool per_field,
+                int iter) {
+  char buf[MAX_GETS][64];
+  char sync[16];
+  int sync_len = tosc_writeMessage(sync, sizeof(sync), "/sync", "", NULL);
+  tosc_message msg;
+
+  packets = 0;
+  uint64_t t0 = bench_now_ns();
+  for (int it = 0; it < iter; it++) {
+    if (per_field) {
+      for (int i = 0; i < get_count; i++) {
+        memcpy(buf[i], get_buf[i], get_len[i]);
+        tosc_parseMessage(&msg, buf[i], get_len[i]);
+        dispatch_message(&msg, conn);
+      }
+    } else {
+      memcpy(buf[0], sync, sync_len);
+      tosc_parseMessage(&msg, buf[0], sync_len);
+      dispatch_message(&msg, conn);
+    }
+  }
+  uint64_t elapsed = bench_now_ns() - t0;
+
+  bench_report(name, iter, elapsed);
+  printf("# %s: %.0f packets per sync\n", name, (double)packets / iter);
+}
+
+int main(void) {
+  dispatch_init();
+
+  char sync[16];
+  tosc_message msg;
+  connectionT conn = {0};
+  conn.send = collect_send;
+  int len = tosc_writeMessage(sync, sizeof(sync), "/sync", "", NULL);
+  tosc_parseMessage(&msg, sync, len);
+  dispatch_message(&msg, &conn);
+  printf("# %d fields\n", get_count);
+
+  conn.send = count_send;
+  run("sync/per_field_stub", &conn, true, ITER_STUB);
+  run("sync/image_stub", &conn, false, ITER_STUB);
+
+  int sink = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in sin = {0};
+  socklen_t sin_len = sizeof(sin);
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(sink, (struct sockaddr *)&sin, sizeof(sin));
+  getsockname(sink, (struct sockaddr *)&sin, &sin_len);
+  conn.con.fd = socket(AF_INET, SOCK_DGRAM, 0);
+  connect(conn.con.fd, (struct sockaddr *)&sin, sizeof(sin));
+
+  conn.send = udp_send;
+  run("sync/per_field_udp", &conn, true, ITER_UDP);
+  run("sync/image_udp", &conn, false, ITER_UDP);
+
+  close(conn.con.fd);
+  close(sink);
+  return 0;
+}
@@ -0,0 +1,158 @@
+// tinyosc encoding and bundles, and globmatch, which the dispatch trie
+// and compiled address patterns replaced, for comparison.
+//
+// write/*             tosc_writeMessage of a float SET, a GET, a 32-float
+//                     LUT and a string
+// bundle/write_8      a bundle of eight float SETs, tosc_writeNextMessage
+// bundle/iterate_8    tosc_parseBundle, then tosc_getNextMessage and one
+//                     argument read for each of its eight messages
+// globmatch/*         one address against one pattern: literal, a [1-4]
+//                     class, a *, and a miss
+//
+// Before timing, each written message must parse back to its address and
+// the bundle must hold eight messages; a failure exits 1.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "globmatch.h"
+#include "tinyosc.h"
+
+#define ITER 2000000
+
+static float lut[32];
+
+static uint32_t write_set(char *buf, int len) {
+  return tosc_writeMessage(buf, len, "/send/2/brightness", "f", 0.75f);
+}
+
+static uint32_t write_get(char *buf, int len) {
+  return tosc_writeMessage(buf, len, "/send/2/brightness", "");
+}
+
+static uint32_t write_lut(char *buf, int len) {
+  const float *p = lut;
+  return tosc_writeMessage(
+      buf, len, "/send/3/lut/G", "ffffffffffffffffffffffffffffffff", p[0],
+      p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10], p[11],
+      p[12], p[13], p[14], p[15], p[16], p[17], p[18], p[19], p[20], p[21],
+      p[22], p[23], p[24], p[25], p[26], p[27], p[28], p[29], p[30], p[31]);
+}
+
+static uint32_t write_string(char *buf, int len) {
+  return tosc_writeMessage(buf, len, "/input/1/resolution", "s", "1920x1080");
+}
+
+static const char *bundle_addr[8] = {
+    "/send/1/posX", "/send/1/posY", "/send/2/scaleX", "/send/2/scaleY",
+    "/send/3/hue",  "/send/3/saturation", "/send/4/rotation", "/send/4/yaw"};
+
+static uint32_t write_bundle(char *buf, int len) {
+  tosc_bundle b;
+  tosc_writeBundle(&b, 1, buf, len);
+  for (int i = 0; i < 8; i++)
+    tosc_writeNextMessage(&b, bundle_addr[i], "f", (float)i * 0.125f);
+  return tosc_getBundleLength(&b);
+}
+
+typedef struct {
+  const char *name;
+  uint32_t (*write)(char *, int);
+  const char *address;
+} write_case;
+
+static const write_case writes[] = {
+    {"write/set_float", write_set, "/send/2/brightness"},
+    {"write/get", write_get, "/send/2/brightness"},
+    {"write/lut_32f", write_lut, "/send/3/lut/G"},
+    {"write/string", write_string, "/input/1/resolution"},
+};
+
+typedef struct {
+  const char *name;
+  const char *address, *pattern;
+  int expect;
+} glob_case;
+
+static const glob_case globs[] = {
+    {"globmatch/literal", "/analog_format/framerate",
+     "/analog_format/framerate", 1},
+    {"globmatch/class", "/send/3/brightness", "/send/[1-4]/brightness", 1},
+    {"globmatch/star", "/send/3/lut/G", "/send/*/lut/*", 1},
+    {"globmatch/miss", "/send/3/brightness", "/send/[1-4]/contrast", 0},
+};
+
+static int check(void) {
+  char buf[512];
+  tosc_message msg;
+  for (size_t i = 0; i < sizeof(writes) / sizeof(writes[0]); i++) {
+    uint32_t len = writes[i].write(buf, sizeof(buf));
+    if (tosc_parseMessageChecked(&msg, buf, (int)len) != 0 ||
+        strcmp(tosc_getAddress(&msg), writes[i].address) != 0) {
+      printf("ERROR: %s does not parse back\n", writes[i].name);
+      return 1;
+    }
+  }
+
+  tosc_bundle b;
+  int n = 0;
+  uint32_t len = write_bundle(buf, sizeof(buf));
+  tosc_parseBundle(&b, buf, (int)len);
+  while (tosc_getNextMessage(&b, &msg))
+    n++;
+  if (n != 8) {
+    printf("ERROR: bundle holds %d messages, not 8\n", n);
+    return 1;
+  }
+
+  for (size_t i = 0; i < sizeof(globs) / sizeof(globs[0]); i++) {
+    if (!globmatch((char *)globs[i].address, (char *)globs[i].pattern) !=
+        !globs[i].expect) {
+      printf("ERROR: %s gave the wrong answer\n", globs[i].name);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  for (int i = 0; i < 32; i++)
+    lut[i] = (float)i / 31.0f;
+  if (check())
+    return 1;
+
+  char buf[512];
+  uint64_t sum = 0, start;
+  for (size_t i = 0; i < sizeof(writes) / sizeof(writes[0]); i++) {
+    start = bench_now_ns();
+    for (int k = 0; k < ITER; k++)
+      sum += writes[i].write(buf, sizeof(buf));
+    bench_report(writes[i].name, ITER, bench_now_ns() - start);
+  }
+
+  start = bench_now_ns();
+  for (int k = 0; k < ITER; k++)
+    sum += write_bundle(buf, sizeof(buf));
+  bench_report("bundle/write_8", ITER, bench_now_ns() - start);
+
+  uint32_t len = write_bundle(buf, sizeof(buf));
+  start = bench_now_ns();
+  for (int k = 0; k < ITER; k++) {
+    tosc_bundle b;
+    tosc_message msg;
+    tosc_parseBundle(&b, buf, (int)len);
+    while (tosc_getNextMessage(&b, &msg))
+      sum += (uint64_t)tosc_getNextFloat(&msg);
+  }
+  bench_report("bundle/iterate_8", ITER, bench_now_ns() - start);
+
+  for (size_t i = 0; i < sizeof(globs) / sizeof(globs[0]); i++) {
+    start = bench_now_ns();
+    for (int k = 0; k < ITER; k++)
+      sum += globmatch((char *)globs[i].address, (char *)globs[i].pattern);
+    bench_report(globs[i].name, ITER, bench_now_ns() - start);
+  }
+  bench_sink = sum;
+  return 0;
+}
@@ -0,0 +1,254 @@
+// Throughput of the receive path as workers are added.
+//
+// dispatch/threads=N  N threads calling dispatch_message directly, which
+//                     isolates handler cost and config seqlock contention.
+// image/writers=N     N threads each SETting the fields of its own send
+//                     while another sends /sync in a loop; reports SETs,
+//                     and how often a state image refresh waited on another
+//                     writer's bundle or a /sync copy had to be retried.
+// udp/workers=N       an osc_server with N SO_REUSEPORT workers on loopback,
+//                     flooded by client threads; reports messages handled.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "osc_config.h"
+#include "osc_server.h"
+#include "tinyosc.h"
+
+#define RUN_NS       500000000ull
+#define MAX_THREADS  8
+#define CLIENTS      8
+#define MIX          32
+
+static char mix_buf[MIX][64];
+static int mix_len[MIX];
+static atomic_bool stop_flag;
+static uint64_t writer_count[MAX_THREADS];
+
+static void build_mix(void) {
+  static const char *fields[] = {"brightness", "contrast", "saturation",
+                                 "hue", "posX", "posY", "scaleX", "rotation"};
+  for (int i = 0; i < MIX; i++) {
+    char addr[48];
+    snprintf(addr, sizeof(addr), "/send/%d/%s", 1 + i % 4, fields[i % 8]);
+    mix_len[i] = tosc_writeMessage(mix_buf[i], sizeof(mix_buf[i]), addr, "f",
+                                   (float)i / MIX);
+  }
+}
+
+static void *dispatch_thread(void *arg) {
+  uint64_t *count = arg;
+  char buf[MIX][64];
+  tosc_message msg[MIX];
+  connectionT conn = {0};
+  conn.send = bench_stub_send;
+  for (int i = 0; i < MIX; i++) {
+    memcpy(buf[i], mix_buf[i], sizeof(buf[i]));
+    tosc_parseMessage(&msg[i], buf[i], mix_len[i]);
+  }
+
+  uint64_t n = 0;
+  while (!atomic_load_explicit(&stop_flag, memory_order_relaxed)) {
+    for (int i = 0; i < MIX; i++) {
+      tosc_reset(&msg[i]);
+      dispatch_message(&msg[i], &conn);
+    }
+    n += MIX;
+  }
+  *count = n;
+  return NULL;
+}
+
+static void bench_dispatch_threads(int threads) {
+  pthread_t tid[MAX_THREADS];
+  uint64_t count[MAX_THREADS];
+  atomic_store(&stop_flag, false);
+
+  uint64_t t0 = bench_now_ns();
+  for (int i = 0; i < threads; i++)
+    pthread_create(&tid[i], NULL, dispatch_thread, &count[i]);
+  usleep(RUN_NS / 1000);
+  atomic_store(&stop_flag, true);
+  uint64_t total = 0;
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tid[i], NULL);
+    total += count[i];
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "dispatch/threads=%d", threads);
+  bench_report(name, total, bench_now_ns() - t0);
+}
+
+// SETs of the fields of send 1 + i % 4
+static void *writer_thread(void *arg) {
+  uint64_t *count = arg;
+  int send = 1 + (int)(count - writer_count) % 4;
+  static const char *fields[] = {"brightness", "contrast", "saturation",
+                                 "hue", "posX", "posY", "scaleX", "rotation"};
+  char buf[8][64];
+  tosc_message msg[8];
+  connectionT conn = {0};
+  conn.send = bench_stub_send;
+  for (int i = 0; i < 8; i++) {
+    char addr[48];
+    snprintf(addr, sizeof(addr), "/send/%d/%s", send, fields[i]);
+    int len = tosc_writeMessage(buf[i], sizeof(buf[i]), addr, "f",
+                                (float)i / 8);
+    tosc_parseMessage(&msg[i], buf[i], len);
+  }
+
+  uint64_t n = 0;
+  while (!atomic_load_explicit(&stop_flag, memory_order_relaxed)) {
+    for (int i = 0; i < 8; i++) {
+      // a new value each time, so every SET re-encodes its field
+      msg[i].buffer[msg[i].len - 1] ^= 1;
+      tosc_reset(&msg[i]);
+      dispatch_message(&msg[i], &conn);
+    }
+    n += 8;
+  }
+  *count = n;
+  return NULL;
+}
+
+static void *sync_thread(void *arg) {
+  uint64_t *count = arg;
+  char buf[64];
+  int len = tosc_writeMessage(buf, sizeof(buf), "/sync", "");
+  uint64_t n = 0;
+  while (!atomic_load_explicit(&stop_flag, memory_order_relaxed)) {
+    bench_dispatch(buf, len);
+    n++;
+  }
+  *count = n;
+  return NULL;
+}
+
+static void bench_image_writers(int threads) {
+  pthread_t tid[MAX_THREADS], reader;
+  uint64_t syncs;
+  osc_image_stats before, after;
+  atomic_store(&stop_flag, false);
+
+  dispatch_image_stats(&before);
+  uint64_t t0 = bench_now_ns();
+  for (int i = 0; i < threads; i++)
+    pthread_create(&tid[i], NULL, writer_thread, &writer_count[i]);
+  pthread_create(&reader, NULL, sync_thread, &syncs);
+  usleep(RUN_NS / 1000);
+  atomic_store(&stop_flag, true);
+  uint64_t total = 0;
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tid[i], NULL);
+    total += writer_count[i];
+  }
+  pthread_join(reader, NULL);
+  uint64_t elapsed = bench_now_ns() - t0;
+  dispatch_image_stats(&after);
+
+  char name[64];
+  snprintf(name, sizeof(name), "image/writers=%d", threads);
+  bench_report(name, total, elapsed);
+  printf("# %s: %llu of %llu SETs waited on another writer, "
+         "%llu /sync bundle copies retried over %llu syncs\n",
+         name, (unsigned long long)(after.contended - before.contended),
+         (unsigned long long)total,
+         (unsigned long long)(after.retries - before.retries),
+         (unsigned long long)syncs);
+}
+
+static int bench_port;
+
+static void *client_thread(void *arg) {
+  (void)arg;
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in sin = {0};
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(bench_port);
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  connect(fd, (struct sockaddr *)&sin, sizeof(sin));
+
+  struct mmsghdr hdr[MIX];
+  struct iovec iov[MIX];
+  memset(hdr, 0, sizeof(hdr));
+  for (int i = 0; i < MIX; i++) {
+    iov[i].iov_base = mix_buf[i];
+    iov[i].iov_len = mix_len[i];
+    hdr[i].msg_hdr.msg_iov = &iov[i];
+    hdr[i].msg_hdr.msg_iovlen = 1;
+  }
+  while (!atomic_load_explicit(&stop_flag, memory_order_relaxed))
+    sendmmsg(fd, hdr, MIX, 0);
+  close(fd);
+  return NULL;
+}
+
+static void *server_thread(void *arg) {
+  osc_server_run(arg);
+  return NULL;
+}
+
+static void bench_udp_workers(int workers) {
+  osc_server server = {0};
+  char spec[32];
+  bench_port = 19100 + workers;
+  snprintf(spec, sizeof(spec), "127.0.0.1:%d", bench_port);
+  const char *specs[] = {spec};
+  if (osc_server_open(&server, specs, 1, workers, true) < 0) {
+    osc_server_close(&server);
+    return;
+  }
+  server.verbose = false;
+
+  pthread_t srv, cli[CLIENTS];
+  atomic_store(&stop_flag, false);
+  pthread_create(&srv, NULL, server_thread, &server);
+  for (int i = 0; i < CLIENTS; i++)
+    pthread_create(&cli[i], NULL, client_thread, NULL);
+
+  // measure a window after warm-up, so startup does not count
+  usleep(50000);
+  osc_io_stats before, after;
+  osc_server_stats(&server, &before);
+  uint64_t t0 = bench_now_ns();
+  usleep(RUN_NS / 1000);
+  osc_server_stats(&server, &after);
+  uint64_t elapsed = bench_now_ns() - t0;
+
+  atomic_store(&stop_flag, true);
+  for (int i = 0; i < CLIENTS; i++)
+    pthread_join(cli[i], NULL);
+  osc_server_stop(&server);
+  pthread_join(srv, NULL);
+  osc_server_close(&server);
+
+  char name[64];
+  snprintf(name, sizeof(name), "udp/workers=%d", workers);
+  bench_report(name, after.rx_packets - before.rx_packets, elapsed);
+}
+
+int main(void) {
+  build_mix();
+  dispatch_init();
+
+  int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int max = cores < MAX_THREADS ? cores : MAX_THREADS;
+  if (max < 2)
+    max = 2; // still shows the contention cost on a single core
+  printf("# %d online cores\n", cores);
+
+  for (int n = 1; n <= max; n *= 2)
+    bench_dispatch_threads(n);
+  for (int n = 1; n <= max; n *= 2)
+    bench_image_writers(n);
+  for (int n = 1; n <= max; n *= 2)
+    bench_udp_workers(n);
+  return 0;
+}
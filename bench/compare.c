@@ -0,0 +1,92 @@
+// Compares two runs of the benches saved with BENCH_FORMAT=json, e.g.
+//
+//   make -s bench BENCH_FORMAT=json > before.jsonl
+//   ... change something ...
+//   make -s bench BENCH_FORMAT=json > after.jsonl
+//   bench/compare before.jsonl after.jsonl
+//
+// and prints each bench in both with its change in ns/op.  Exits 1 if any
+// got slower by more than the threshold, 10% unless -t gives another.
+// Lines that are not results are skipped.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_RESULTS 512
+
+typedef struct {
+  char   name[128];
+  double ns;
+} result;
+
+static int load(const char *path, result *out, char *rev, size_t rev_len) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return -1;
+  }
+  char line[512];
+  int n = 0;
+  while (n < MAX_RESULTS && fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "{\"bench\":\"%127[^\"]\",\"ns_per_op\":%lf",
+               out[n].name, &out[n].ns) != 2)
+      continue;
+    const char *r = strstr(line, "\"rev\":\"");
+    if (r && !rev[0])
+      sscanf(r + 7, "%63[^\"]", rev);
+    n++;
+  }
+  fclose(f);
+  return n;
+}
+
+int main(int argc, char *argv[]) {
+  double threshold = 10.0;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:h")) != -1) {
+    switch (opt) {
+    case 't':
+      threshold = atof(optarg);
+      break;
+    default:
+      printf("usage: %s [-t percent] before.jsonl after.jsonl\n", argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (argc - optind != 2) {
+    printf("usage: %s [-t percent] before.jsonl after.jsonl\n", argv[0]);
+    return 1;
+  }
+
+  static result a[MAX_RESULTS], b[MAX_RESULTS];
+  char rev_a[64] = "", rev_b[64] = "";
+  int na = load(argv[optind], a, rev_a, sizeof(rev_a));
+  int nb = load(argv[optind + 1], b, rev_b, sizeof(rev_b));
+  if (na < 0 || nb < 0)
+    return 1;
+
+  printf("%-40s %12s %12s %8s\n", "bench", rev_a[0] ? rev_a : "before",
+         rev_b[0] ? rev_b : "after", "change");
+  int slower = 0;
+  for (int j = 0; j < nb; j++) {
+    int i = 0;
+    while (i < na && strcmp(a[i].name, b[j].name) != 0)
+      i++;
+    if (i == na) {
+      printf("%-40s %12s %12.1f %8s\n", b[j].name, "-", b[j].ns, "new");
+      continue;
+    }
+    double pct = a[i].ns > 0 ? 100.0 * (b[j].ns - a[i].ns) / a[i].ns : 0.0;
+    bool regressed = pct > threshold;
+    printf("%-40s %12.1f %12.1f %+7.1f%%%s\n", b[j].name, a[i].ns, b[j].ns,
+           pct, regressed ? "  SLOWER" : "");
+    slower += regressed;
+  }
+  if (slower)
+    printf("%d of %d benches slower by more than %.0f%%\n", slower, nb,
+           threshold);
+  return slower ? 1 : 0;
+}
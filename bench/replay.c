@@ -0,0 +1,64 @@
+// Replays a capture recorded with osc_firmware -c, in-process or against
+// a running server, and reports throughput, latency percentiles and
+// replies (see osc_replay.h).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "osc_config.h"
+#include "osc_replay.h"
+
+static void usage(const char *prog) {
+  printf("usage: %s [-x speed] [-t seconds] [-n count] [-d host:port] "
+         "capture\n", prog);
+  printf("  -x speed    1 for real time, 10 for ten times as fast, "
+         "0 (default) flat out\n");
+  printf("  -t seconds  start this far into the capture\n");
+  printf("  -n count    replay at most count datagrams\n");
+  printf("  -d target   send to a server over UDP instead of dispatching "
+         "in-process\n");
+}
+
+int main(int argc, char *argv[]) {
+  osc_replay_opts opts = {0};
+  int opt;
+  while ((opt = getopt(argc, argv, "x:t:n:d:h")) != -1) {
+    switch (opt) {
+    case 'x':
+      opts.speed = atof(optarg);
+      break;
+    case 't':
+      opts.from_ns = (uint64_t)(atof(optarg) * 1e9);
+      break;
+    case 'n':
+      opts.limit = strtoull(optarg, NULL, 10);
+      break;
+    case 'd':
+      opts.target = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  osc_capture_reader r;
+  if (osc_capture_reader_open(&r, argv[optind]) < 0)
+    return 1;
+  if (!r.index_count)
+    printf("%s has no index; it was not closed cleanly\n", argv[optind]);
+  if (!opts.target)
+    dispatch_init();
+
+  osc_replay_result res;
+  int rc = osc_replay_run(&r, &opts, &res);
+  if (rc == 0)
+    osc_replay_print(&res);
+  osc_capture_reader_close(&r);
+  return rc < 0;
+}
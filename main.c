@@ -5,120 +5,192 @@
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
 #include <unistd.h>
 
-#include "globmatch.h"
 #include "network.h"
 #include "osc_config.h"
+#include "osc_frame.h"
+#include "osc_persist.h"
+#include "osc_server.h"
 #include "tinyosc.h"
 
-// debug send wrapper
-
-size_t send_wrapper(connectionT *conn, const void *buf, size_t len) {
-  ssize_t sent = sendto(conn->con.fd, buf, len, 0,
-                        (struct sockaddr *)&conn->con.addr, conn->con.addr_len);
-
-/*  printf("SENDING: ");
-
-  for (int i = 0; i < len; i++) {
-    char c = ((char *)buf)[i];
-    if (isprint(c)) {
-      printf("%c", c);
-    } else {
-      printf("(%02X)", c);
-    }
-  }
-  printf("\n");
-*/
-
-  if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-    fd_set wfds;
-    for (;;) {
-      FD_ZERO(&wfds);
-      FD_SET(conn->con.fd, &wfds);
-      int r = select(conn->con.fd + 1, NULL, &wfds, NULL, NULL);
-      if (r < 0) {
-        if (errno == EINTR)
-          continue;
-        perror("select");
-        return -1;
-      }
-      if (FD_ISSET(conn->con.fd, &wfds)) {
-        sent = sendto(conn->con.fd, buf, len, 0,
-                      (struct sockaddr *)&conn->con.addr, conn->con.addr_len);
-        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
-          continue;
-        break;
-      }
-    }
-  } else if (sent < 0) {
-    perror("sendto");
-  }
-
-  return (size_t)sent;
-}
-
 // main loop
 
-bool keepRunning = true;
+static osc_server server;
+static osc_persist persist;
+static osc_capture capture;
 
 static void sigintHandler(int x) {
   (void)x;
-  keepRunning = false;
+  osc_server_stop(&server);
 }
 
-int main(int argc, char *argv[]) {
-  char buffer[2048];
-  connectionT conn = {0};
-  conn.send = send_wrapper;
+static void usage(const char *prog) {
+  printf("usage: %s [-b] [-q] [-w workers] [-s file] [-c file]\n"
+         "       [-l addr]... [-t addr]... [-f slip|length]\n", prog);
+  printf("  -b       batched receive/send with recvmmsg/sendmmsg\n");
+  printf("  -q       do not print received packets\n");
+  printf("  -w n     receive workers, each with a SO_REUSEPORT socket\n");
+  printf("  -s file  keep the state in file and restore it at startup\n");
+  printf("  -c file  record every received datagram to file, for replay\n");
+  printf("  -l addr  UDP listen address, repeatable (default %s):\n",
+         OSC_LISTEN_DEFAULT);
+  printf("           port, host:port, [ipv6]:port, optionally @iface\n");
+  printf("  -t addr  TCP listen address, repeatable, same forms as -l\n");
+  printf("  -f fmt   TCP framing: slip (OSC 1.1, default) or length (OSC 1.0)\n");
+}
 
+int main(int argc, char *argv[]) {
+  const char *specs[OSC_LISTEN_MAX];
+  int spec_count = 0;
+  const char *tcp_specs[OSC_LISTEN_MAX];
+  int tcp_count = 0;
+  osc_stream_framing framing = OSC_STREAM_SLIP;
+  bool batched = false;
+  bool verbose = true;
+  int workers = 1;
+  const char *state = NULL;
+  const char *capture_path = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "bqw:s:c:l:t:f:h")) != -1) {
+    switch (opt) {
+    case 'b':
+      batched = true;
+      break;
+    case 'q':
+      verbose = false;
+      break;
+    case 'w':
+      workers = atoi(optarg);
+      break;
+    case 's':
+      state = optarg;
+      break;
+    case 'c':
+      capture_path = optarg;
+      break;
+    case 'l':
+      if (spec_count == OSC_LISTEN_MAX) {
+        fprintf(stderr, "at most %d listen addresses\n", OSC_LISTEN_MAX);
+        return 1;
+      }
+      specs[spec_count++] = optarg;
+      break;
+    case 't':
+      if (tcp_count == OSC_LISTEN_MAX) {
+        fprintf(stderr, "at most %d TCP listen addresses\n", OSC_LISTEN_MAX);
+        return 1;
+      }
+      tcp_specs[tcp_count++] = optarg;
+      break;
+    case 'f':
+      if (strcmp(optarg, "slip") == 0) {
+        framing = OSC_STREAM_SLIP;
+      } else if (strcmp(optarg, "length") == 0) {
+        framing = OSC_STREAM_LENGTH;
+      } else {
+        fprintf(stderr, "unknown framing %s\n", optarg);
+        return 1;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (spec_count == 0)
+    specs[spec_count++] = OSC_LISTEN_DEFAULT;
+
+  // restored before the state image is built from config, and saved only
+  // once dispatch_init has clamped what was restored
+  if (state && osc_persist_open(&persist, state) < 0) {
+    fprintf(stderr, "cannot keep the state in %s\n", state);
+    return 1;
+  }
+  dispatch_init();
+  if (state && osc_persist_start(&persist) < 0) {
+    fprintf(stderr, "cannot keep the state in %s\n", state);
+    osc_persist_close(&persist);
+    return 1;
+  }
+  if (osc_server_open(&server, specs, spec_count, workers, batched) < 0) {
+    osc_server_close(&server);
+    return 1;
+  }
+  for (int i = 0; i < tcp_count; i++) {
+    if (osc_server_listen_stream(&server, tcp_specs[i], framing) < 0) {
+      osc_server_close(&server);
+      return 1;
+    }
+  }
+  server.verbose = verbose;
+  if (capture_path) {
+    if (osc_capture_open(&capture, capture_path) < 0) {
+      osc_server_close(&server);
+      return 1;
+    }
+    server.capture = &capture;
+  }
   signal(SIGINT, sigintHandler);
 
-  conn.con.fd = socket(AF_INET, SOCK_DGRAM, 0);
-  fcntl(conn.con.fd, F_SETFL, O_NONBLOCK);
-
-  struct sockaddr_in sin = {0};
-  sin.sin_family = AF_INET;
-  sin.sin_port = htons(9000);
-  sin.sin_addr.s_addr = INADDR_ANY;
-  bind(conn.con.fd, (struct sockaddr *)&sin, sizeof(sin));
-
-  printf("tinyosc is now listening on port 9000.\n");
+  for (int i = 0; i < spec_count; i++)
+    printf("tinyosc is now listening on %s%s.\n", specs[i],
+           batched ? " (batched I/O)" : "");
+  for (int i = 0; i < tcp_count; i++)
+    printf("tinyosc is now listening on TCP %s (%s framing).\n", tcp_specs[i],
+           framing == OSC_STREAM_SLIP ? "SLIP" : "length");
+  if (workers > 1)
+    printf("%d workers share each address with SO_REUSEPORT.\n", workers);
   printf("Press Ctrl+C to stop.\n");
 
-  while (keepRunning) {
-    fd_set readSet;
-    FD_ZERO(&readSet);
-    FD_SET(conn.con.fd, &readSet);
-    struct timeval timeout = {1, 0};
-    if (select(conn.con.fd + 1, &readSet, NULL, NULL, &timeout) > 0) {
-      int len;
-      conn.con.addr_len = sizeof(conn.con.addr);
-      while ((len = (int)recvfrom(conn.con.fd, buffer, sizeof(buffer), 0,
-                                  (struct sockaddr *)&conn.con.addr,
-                                  &conn.con.addr_len)) > 0) {
-        printf("RECEIVED [%s]\n", buffer);
-        if (tosc_isBundle(buffer)) {
-          tosc_bundle bundle;
-          tosc_parseBundle(&bundle, buffer, len);
-          uint64_t timetag = tosc_getTimetag(&bundle);
-          printf("Timetag: %llu\n", (unsigned long long)timetag);
-          tosc_message osc;
-          while (tosc_getNextMessage(&bundle, &osc)) {
-            dispatch_message(&osc, &conn);
-          }
-        } else {
-          tosc_message osc;
-          tosc_parseMessage(&osc, buffer, len);
-          tosc_printOscBuffer(buffer, len);
-          dispatch_message(&osc, &conn);
-        }
-      }
-    }
-  }
+  osc_server_run(&server);
 
-  close(conn.con.fd);
+  osc_io_stats stats;
+  osc_server_stats(&server, &stats);
+  osc_io_print_stats(&stats);
+  if (batched) {
+    osc_ingest_stats ingest;
+    osc_server_ingest_stats(&server, &ingest);
+    osc_ingest_print_stats(&ingest);
+  }
+  osc_session_stats sessions;
+  osc_server_session_stats(&server, &sessions);
+  osc_session_print_stats(&sessions);
+  if (tcp_count) {
+    osc_stream_stats streams;
+    osc_server_stream_stats(&server, &streams);
+    osc_stream_print_stats(&streams);
+  }
+  osc_sched_stats sched;
+  osc_server_sched_stats(&server, &sched);
+  osc_sched_print_stats(&sched);
+  osc_subs_stats subs;
+  dispatch_subs_stats(&subs);
+  osc_subs_print_stats(&subs);
+  osc_image_stats image;
+  dispatch_image_stats(&image);
+  osc_image_print_stats(&image);
+  osc_ramp_stats ramp;
+  dispatch_ramp_stats(&ramp);
+  osc_ramps_print_stats(&ramp);
+  osc_frame_stats frames;
+  osc_frame_get_stats(&frames);
+  osc_frame_print_stats(&frames);
+  if (capture_path) {
+    osc_capture_close(&capture);
+    osc_capture_stats captured;
+    osc_capture_get_stats(&capture, &captured);
+    osc_capture_print_stats(&captured);
+  }
+  if (state) {
+    osc_persist_close(&persist);
+    osc_persist_stats saved;
+    osc_persist_get_stats(&persist, &saved);
+    osc_persist_print_stats(&saved);
+  }
+  osc_server_close(&server);
   return 0;
 }
@@ -0,0 +1,295 @@
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "osc_capture.h"
+
+#define PAD4(n) (((n) + 3u) & ~3u)
+
+static uint64_t now_ns(clockid_t id) {
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      perror("capture write");
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static void *writer_main(void *arg) {
+  osc_capture *c = arg;
+  pthread_mutex_lock(&c->lock);
+  for (;;) {
+    // woken when the ring fills up, otherwise every OSC_CAPTURE_FLUSH_MS
+    if (!c->stop && c->head - c->tail < OSC_CAPTURE_RING / 8) {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += OSC_CAPTURE_FLUSH_MS * 1000000l;
+      ts.tv_sec += ts.tv_nsec / 1000000000l;
+      ts.tv_nsec %= 1000000000l;
+      pthread_cond_timedwait(&c->ready, &c->lock, &ts);
+    }
+    if (c->head == c->tail) {
+      if (c->stop)
+        break; // stopped and drained
+      continue;
+    }
+    uint64_t head = c->head, tail = c->tail;
+    pthread_mutex_unlock(&c->lock);
+
+    // the queued bytes, in at most two pieces around the end of the ring
+    size_t at = tail % OSC_CAPTURE_RING;
+    size_t n = head - tail;
+    size_t first = n < OSC_CAPTURE_RING - at ? n : OSC_CAPTURE_RING - at;
+    // on a failed write the pieces are dropped all the same, so the ring
+    // keeps moving; only what reached the file counts as written
+    bool ok = write_all(c->fd, c->ring + at, first) == 0 &&
+              write_all(c->fd, c->ring, n - first) == 0;
+
+    pthread_mutex_lock(&c->lock);
+    c->tail = head;
+    if (ok)
+      c->stats.bytes += n;
+    else
+      c->stats.failed++;
+  }
+  pthread_mutex_unlock(&c->lock);
+  return NULL;
+}
+
+int osc_capture_open(osc_capture *c, const char *path) {
+  memset(c, 0, sizeof(*c));
+  c->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (c->fd < 0) {
+    perror(path);
+    return -1;
+  }
+  c->ring = malloc(OSC_CAPTURE_RING);
+  if (!c->ring) {
+    close(c->fd);
+    return -1;
+  }
+  osc_capture_header h = {OSC_CAPTURE_MAGIC, OSC_CAPTURE_VERSION,
+                          now_ns(CLOCK_REALTIME)};
+  c->start_mono = now_ns(CLOCK_MONOTONIC);
+  pthread_mutex_init(&c->lock, NULL);
+  pthread_cond_init(&c->ready, NULL);
+  if (write_all(c->fd, &h, sizeof(h)) < 0 ||
+      pthread_create(&c->thread, NULL, writer_main, c) != 0) {
+    free(c->ring);
+    close(c->fd);
+    return -1;
+  }
+  return 0;
+}
+
+// copies n bytes into the ring at the head; called with the lock held
+static void put(osc_capture *c, const void *src, size_t n) {
+  size_t at = c->head % OSC_CAPTURE_RING;
+  size_t first = n < OSC_CAPTURE_RING - at ? n : OSC_CAPTURE_RING - at;
+  memcpy(c->ring + at, src, first);
+  memcpy(c->ring, (const char *)src + first, n - first);
+  c->head += n;
+}
+
+void osc_capture_record_packet(osc_capture *c, const void *data, uint32_t len,
+                               const struct sockaddr_storage *src,
+                               socklen_t src_len) {
+  osc_capture_record rec = {.len = len, .family = src->ss_family};
+  if (src->ss_family == AF_INET) {
+    const struct sockaddr_in *a = (const struct sockaddr_in *)src;
+    rec.port = a->sin_port;
+    memcpy(rec.addr, &a->sin_addr, 4);
+  } else if (src->ss_family == AF_INET6) {
+    const struct sockaddr_in6 *a = (const struct sockaddr_in6 *)src;
+    rec.port = a->sin6_port;
+    memcpy(rec.addr, &a->sin6_addr, 16);
+  }
+  static const char zero[4];
+  size_t need = sizeof(rec) + PAD4(len);
+
+  pthread_mutex_lock(&c->lock);
+  // timed under the lock, so records from several workers stay in order
+  rec.t_ns = now_ns(CLOCK_MONOTONIC) - c->start_mono;
+  if (c->head - c->tail + need > OSC_CAPTURE_RING) {
+    c->stats.dropped++;
+    pthread_mutex_unlock(&c->lock);
+    return;
+  }
+  // the first record of every OSC_CAPTURE_INDEX_MS gets an index entry
+  if (rec.t_ns >= c->next_index_ns) {
+    if (c->index_count == c->index_cap) {
+      uint32_t cap = c->index_cap ? 2 * c->index_cap : 256;
+      osc_capture_index *ix = realloc(c->index, cap * sizeof(*ix));
+      if (ix) {
+        c->index = ix;
+        c->index_cap = cap;
+      }
+    }
+    if (c->index_count < c->index_cap) {
+      c->index[c->index_count].t_ns = rec.t_ns;
+      c->index[c->index_count].offset = sizeof(osc_capture_header) + c->head;
+      c->index_count++;
+    }
+    uint64_t step = OSC_CAPTURE_INDEX_MS * 1000000ull;
+    c->next_index_ns = rec.t_ns - rec.t_ns % step + step;
+  }
+  put(c, &rec, sizeof(rec));
+  put(c, data, len);
+  put(c, zero, PAD4(len) - len);
+  c->stats.records++;
+  if (c->head - c->tail >= OSC_CAPTURE_RING / 8)
+    pthread_cond_signal(&c->ready);
+  pthread_mutex_unlock(&c->lock);
+}
+
+void osc_capture_close(osc_capture *c) {
+  if (c->fd < 0)
+    return;
+  pthread_mutex_lock(&c->lock);
+  c->stop = true;
+  pthread_cond_signal(&c->ready);
+  pthread_mutex_unlock(&c->lock);
+  pthread_join(c->thread, NULL);
+
+  osc_capture_footer f = {sizeof(osc_capture_header) + c->head,
+                          c->index_count, OSC_CAPTURE_INDEX_MAGIC};
+  write_all(c->fd, c->index, c->index_count * sizeof(*c->index));
+  write_all(c->fd, &f, sizeof(f));
+  close(c->fd);
+  c->fd = -1;
+  free(c->ring);
+  free(c->index);
+  c->ring = NULL;
+  c->index = NULL;
+}
+
+void osc_capture_get_stats(osc_capture *c, osc_capture_stats *st) {
+  pthread_mutex_lock(&c->lock);
+  *st = c->stats;
+  pthread_mutex_unlock(&c->lock);
+}
+
+void osc_capture_print_stats(const osc_capture_stats *st) {
+  printf("capture: %llu datagrams, %llu bytes written, %llu dropped, "
+         "%llu writes failed\n",
+         (unsigned long long)st->records, (unsigned long long)st->bytes,
+         (unsigned long long)st->dropped, (unsigned long long)st->failed);
+}
+
+int osc_capture_reader_open(osc_capture_reader *r, const char *path) {
+  memset(r, 0, sizeof(*r));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(osc_capture_header)) {
+    printf("ERROR: %s is not a capture\n", path);
+    close(fd);
+    return -1;
+  }
+  r->map_len = (size_t)st.st_size;
+  r->map = mmap(NULL, r->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (r->map == MAP_FAILED) {
+    perror("mmap");
+    r->map = NULL;
+    return -1;
+  }
+  const osc_capture_header *h = (const osc_capture_header *)r->map;
+  if (h->magic != OSC_CAPTURE_MAGIC || h->version != OSC_CAPTURE_VERSION) {
+    printf("ERROR: %s is not a capture\n", path);
+    osc_capture_reader_close(r);
+    return -1;
+  }
+  r->start_ns = h->start_ns;
+  r->pos = sizeof(*h);
+  r->end = r->map_len;
+
+  // a complete file ends with the index and its footer
+  osc_capture_footer f;
+  if (r->map_len >= sizeof(*h) + sizeof(f)) {
+    memcpy(&f, r->map + r->map_len - sizeof(f), sizeof(f));
+    size_t ix_len = (size_t)f.index_count * sizeof(osc_capture_index);
+    if (f.magic == OSC_CAPTURE_INDEX_MAGIC && f.index_offset >= sizeof(*h) &&
+        f.index_offset + ix_len + sizeof(f) == r->map_len) {
+      r->end = f.index_offset;
+      r->index = (const osc_capture_index *)(r->map + f.index_offset);
+      r->index_count = f.index_count;
+    }
+  }
+  return 0;
+}
+
+void osc_capture_reader_close(osc_capture_reader *r) {
+  if (r->map)
+    munmap((void *)r->map, r->map_len);
+  r->map = NULL;
+}
+
+bool osc_capture_next(osc_capture_reader *r, osc_capture_msg *m) {
+  osc_capture_record rec;
+  if (r->pos + sizeof(rec) > r->end)
+    return false;
+  memcpy(&rec, r->map + r->pos, sizeof(rec));
+  if (r->pos + sizeof(rec) + rec.len > r->end)
+    return false; // cut short
+  m->t_ns = rec.t_ns;
+  m->data = r->map + r->pos + sizeof(rec);
+  m->len = rec.len;
+  memset(&m->src, 0, sizeof(m->src));
+  m->src.ss_family = rec.family;
+  m->src_len = 0;
+  if (rec.family == AF_INET) {
+    struct sockaddr_in *a = (struct sockaddr_in *)&m->src;
+    a->sin_port = rec.port;
+    memcpy(&a->sin_addr, rec.addr, 4);
+    m->src_len = sizeof(*a);
+  } else if (rec.family == AF_INET6) {
+    struct sockaddr_in6 *a = (struct sockaddr_in6 *)&m->src;
+    a->sin6_port = rec.port;
+    memcpy(&a->sin6_addr, rec.addr, 16);
+    m->src_len = sizeof(*a);
+  }
+  r->pos += sizeof(rec) + PAD4(rec.len);
+  return true;
+}
+
+void osc_capture_seek(osc_capture_reader *r, uint64_t t_ns) {
+  r->pos = sizeof(osc_capture_header);
+  // the last index entry at or before t_ns
+  uint32_t lo = 0, hi = r->index_count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (r->index[mid].t_ns <= t_ns)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo > 0)
+    r->pos = r->index[lo - 1].offset;
+
+  size_t at = r->pos;
+  osc_capture_msg m;
+  while (osc_capture_next(r, &m) && m.t_ns < t_ns)
+    at = r->pos;
+  r->pos = at;
+}
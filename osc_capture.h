@@ -0,0 +1,125 @@
+#ifndef __OSC_CAPTURE_H__
+#define __OSC_CAPTURE_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/*
+ * Traffic capture, for replaying production load on the bench.
+ *
+ * A capture file is a header, then one record per received datagram: its
+ * time since the capture started, its source address and its bytes,
+ * padded to 4.  On close an index of (time, offset) pairs, one per
+ * OSC_CAPTURE_INDEX_MS of traffic, and a footer pointing at it are
+ * appended, so a reader can seek to a time offset without scanning.  A
+ * file cut short by a crash has no index; it still reads from the start.
+ *
+ * Workers only copy each datagram into a ring under a short lock; a
+ * writer thread drains the ring to the file every OSC_CAPTURE_FLUSH_MS,
+ * or sooner once an eighth of it is queued.  When the ring is full the
+ * datagram is dropped and counted rather than waiting for the disk.
+ */
+
+#define OSC_CAPTURE_MAGIC       0x4343534fu // "OSCC"
+#define OSC_CAPTURE_INDEX_MAGIC 0x4943534fu // "OSCI"
+#define OSC_CAPTURE_VERSION     1
+#define OSC_CAPTURE_RING        (4u << 20)
+#define OSC_CAPTURE_INDEX_MS    100
+#define OSC_CAPTURE_FLUSH_MS    50
+
+typedef struct osc_capture_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t start_ns; // CLOCK_REALTIME when the capture started
+} osc_capture_header;
+
+typedef struct osc_capture_record {
+  uint64_t t_ns;   // since the capture started
+  uint32_t len;    // datagram bytes that follow
+  uint16_t family; // AF_INET or AF_INET6
+  uint16_t port;   // network order
+  uint8_t  addr[16];
+} osc_capture_record;
+
+typedef struct osc_capture_index {
+  uint64_t t_ns;
+  uint64_t offset; // of the first record at or after t_ns
+} osc_capture_index;
+
+typedef struct osc_capture_footer {
+  uint64_t index_offset;
+  uint32_t index_count;
+  uint32_t magic;
+} osc_capture_footer;
+
+typedef struct osc_capture_stats {
+  uint64_t records;
+  uint64_t bytes;   // written to the file
+  uint64_t dropped; // ring full
+  uint64_t failed;  // flushes a write error lost, not counted in bytes
+} osc_capture_stats;
+
+typedef struct osc_capture {
+  int                fd;
+  uint64_t           start_mono; // CLOCK_MONOTONIC at the start
+  pthread_t          thread;
+  pthread_mutex_t    lock;       // guards everything below
+  pthread_cond_t     ready;
+  bool               stop;
+  char              *ring;
+  uint64_t           head, tail; // bytes queued and written, ever
+  osc_capture_index *index;
+  uint32_t           index_count, index_cap;
+  uint64_t           next_index_ns;
+  osc_capture_stats  stats;
+} osc_capture;
+
+/* Creates path and starts the writer. Returns 0 or -1. */
+int osc_capture_open(osc_capture *c, const char *path);
+
+/* Queues one received datagram; never blocks on the file. */
+void osc_capture_record_packet(osc_capture *c, const void *data, uint32_t len,
+                               const struct sockaddr_storage *src,
+                               socklen_t src_len);
+
+/* Drains the ring, appends the index and closes the file. */
+void osc_capture_close(osc_capture *c);
+
+void osc_capture_get_stats(osc_capture *c, osc_capture_stats *st);
+void osc_capture_print_stats(const osc_capture_stats *st);
+
+/*
+ * Reading a capture back.
+ */
+
+typedef struct osc_capture_msg {
+  uint64_t                t_ns;
+  const char             *data; // in the mapped file
+  uint32_t                len;
+  struct sockaddr_storage src;
+  socklen_t               src_len;
+} osc_capture_msg;
+
+typedef struct osc_capture_reader {
+  const char               *map;
+  size_t                    map_len;
+  size_t                    pos, end; // next record, end of the records
+  const osc_capture_index  *index;
+  uint32_t                  index_count;
+  uint64_t                  start_ns;
+} osc_capture_reader;
+
+/* Maps a capture file. Returns 0, or -1 if it is not one. */
+int osc_capture_reader_open(osc_capture_reader *r, const char *path);
+void osc_capture_reader_close(osc_capture_reader *r);
+
+/* Positions r at the first record at or after t_ns, through the index
+ * when the file has one. */
+void osc_capture_seek(osc_capture_reader *r, uint64_t t_ns);
+
+/* Reads the next record. Returns true, or false at the end. */
+bool osc_capture_next(osc_capture_reader *r, osc_capture_msg *m);
+
+#endif
@@ -9,6 +9,10 @@
 
 #include "tinyosc.h"
 #include "network.h"
+#include "osc_seqlock.h"
+#include "osc_ramp.h"
+#include "osc_subscribe.h"
+#include "osc_trie.h"
 
 #define CONFIG_MAX_STR_LEN           16
 #define LUT_CONTROL_POINT_COUNT     16
@@ -26,6 +30,10 @@ typedef struct LutControlPoint {
   float y;
 } LutControlPoint;
 
+// handle_send_lut decodes the points as one run of floats
+_Static_assert(sizeof(LutControlPoint) == 2 * sizeof(float),
+               "LutControlPoint must be two packed floats");
+
 /* now holds exactly 16 control points */
 typedef struct ConfigSendLut {
   LutControlPoint points[LUT_CONTROL_POINT_COUNT];
@@ -66,23 +74,73 @@ typedef struct ConfigInput {
 
 typedef struct Config {
   ConfigAnalogFormat analog_format;
-  int                clock_offset;
+  int                clock_offset; // ms added to every bundle timetag
   char               sync_mode[CONFIG_MAX_STR_LEN];
   ConfigInput        input[4];
   ConfigSend         send[4];
 } Config;
 
-/* Unified handler signature */
-typedef int (*OscHandler)(tosc_message *msg, connectionT *conn);
+extern Config config;
+
+/*
+ * Workers dispatch concurrently, so every access to config goes through a
+ * seqlock: one per ConfigInput, one per ConfigSend, and config_lock for the
+ * top-level fields (analog_format, clock_offset, sync_mode).  Writers hold
+ * the lock for the whole field; readers copy a snapshot and never block.
+ * Anything that renders frames reads the copy osc_frame.h publishes at
+ * each frame boundary instead.
+ */
+extern osc_seqlock config_lock;
+extern osc_seqlock config_input_lock[4];
+extern osc_seqlock config_send_lock[4];
+
+/* Unified handler signature; m holds the indices captured by the pattern */
+typedef int (*OscHandler)(tosc_message *msg, connectionT *conn,
+                          const osc_match *m);
 
-/* Dispatch table entry */
+struct osc_param;
+
+/* Dispatch table entry: a command with its handler, or a parameter of the
+ * registry in osc_params.h, which the generic SET applies */
 typedef struct dispatch_entry {
-  const char   *path_pattern;
-  const char   *type_sig;
-  OscHandler    handler;
+  const char              *path_pattern;
+  const char              *type_sig;
+  OscHandler               handler;
+  const struct osc_param  *param;
 } dispatch_entry;
 
+/* The commands, then a row per parameter; filled by dispatch_init */
+extern dispatch_entry dispatch_table[];
+
+/* Builds dispatch_table and compiles it into the lookup trie, clamps
+ * config into the parameter limits and builds the state image. Call once
+ * at startup. */
+void dispatch_init(void);
 void dispatch_message(tosc_message *osc, connectionT *conn);
 
+/* The state image field osc is a plain SET of, or -1 for a GET, a
+ * command, an address pattern or type tags the parameter does not take;
+ * the key of osc_ingest.h. */
+int dispatch_set_field(tosc_message *osc);
+
+/* Applies a SET that dispatch_set_field keyed to field; parse and match
+ * are the ticks the caller spent on it, for /stats. */
+void dispatch_set(tosc_message *osc, int field, uint64_t parse, uint64_t match,
+                  connectionT *conn);
+
+/* Pushes changed fields to /subscribe'd peers through via; call once per
+ * frame. Returns the number of datagrams. */
+int dispatch_push(connectionT *via);
+void dispatch_subs_stats(osc_subs_stats *st);
+void dispatch_image_stats(osc_image_stats *st);
+
+/* Ends the subscriptions made over conn's socket, before it is closed. */
+void dispatch_forget(const connectionT *conn);
+
+/* Advances /ramp'd fields to CLOCK_MONOTONIC now_ns; call once per frame
+ * before dispatch_push. Returns the number of fields changed. */
+int dispatch_ramps(uint64_t now_ns);
+void dispatch_ramp_stats(osc_ramp_stats *st);
+
 #endif
 
@@ -185,3 +185,7 @@ Config config = {
   }
 };
 
+
+osc_seqlock config_lock;
+osc_seqlock config_input_lock[4];
+osc_seqlock config_send_lock[4];
@@ -0,0 +1,178 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "osc_event.h"
+
+enum { OSC_EV_KIND_FREE = 0, OSC_EV_KIND_FD, OSC_EV_KIND_TIMER,
+       OSC_EV_KIND_WAKE };
+
+#define OSC_EV_BATCH 16
+
+static osc_ev_watch *find_watch(osc_ev_loop *loop, int fd) {
+  for (int i = 0; i < OSC_EV_MAX_WATCHES; i++) {
+    if (loop->watches[i].kind != OSC_EV_KIND_FREE && loop->watches[i].fd == fd)
+      return &loop->watches[i];
+  }
+  return NULL;
+}
+
+static int add_watch(osc_ev_loop *loop, int fd, int kind, uint32_t events,
+                     osc_ev_callback cb, void *data) {
+  for (int i = 0; i < OSC_EV_MAX_WATCHES; i++) {
+    osc_ev_watch *w = &loop->watches[i];
+    if (w->kind != OSC_EV_KIND_FREE)
+      continue;
+    struct epoll_event ev = {0};
+    ev.events = events | EPOLLET;
+    ev.data.ptr = w;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      perror("epoll_ctl");
+      return -1;
+    }
+    w->fd = fd;
+    w->kind = kind;
+    w->cb = cb;
+    w->data = data;
+    return 0;
+  }
+  fprintf(stderr, "osc_ev: too many watches\n");
+  return -1;
+}
+
+int osc_ev_init(osc_ev_loop *loop) {
+  memset(loop, 0, sizeof(*loop));
+  loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop->epfd < 0) {
+    perror("epoll_create1");
+    return -1;
+  }
+  loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (loop->wake_fd < 0) {
+    perror("eventfd");
+    close(loop->epfd);
+    return -1;
+  }
+  loop->running = true;
+  return add_watch(loop, loop->wake_fd, OSC_EV_KIND_WAKE, EPOLLIN, NULL, NULL);
+}
+
+void osc_ev_close(osc_ev_loop *loop) {
+  for (int i = 0; i < OSC_EV_MAX_WATCHES; i++) {
+    if (loop->watches[i].kind == OSC_EV_KIND_TIMER)
+      close(loop->watches[i].fd);
+  }
+  close(loop->wake_fd);
+  close(loop->epfd);
+}
+
+int osc_ev_add(osc_ev_loop *loop, int fd, uint32_t events, osc_ev_callback cb,
+               void *data) {
+  return add_watch(loop, fd, OSC_EV_KIND_FD, events, cb, data);
+}
+
+int osc_ev_modify(osc_ev_loop *loop, int fd, uint32_t events) {
+  osc_ev_watch *w = find_watch(loop, fd);
+  if (!w)
+    return -1;
+  struct epoll_event ev = {0};
+  ev.events = events | EPOLLET;
+  ev.data.ptr = w;
+  return epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void osc_ev_remove(osc_ev_loop *loop, int fd) {
+  osc_ev_watch *w = find_watch(loop, fd);
+  if (!w)
+    return;
+  epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+  w->kind = OSC_EV_KIND_FREE;
+  w->fd = -1;
+}
+
+static void ns_to_timespec(uint64_t ns, struct timespec *ts) {
+  ts->tv_sec = (time_t)(ns / 1000000000ull);
+  ts->tv_nsec = (long)(ns % 1000000000ull);
+}
+
+int osc_ev_set_timer(int fd, uint64_t initial_ns, uint64_t interval_ns) {
+  struct itimerspec its = {0};
+  ns_to_timespec(initial_ns, &its.it_value);
+  ns_to_timespec(interval_ns, &its.it_interval);
+  return timerfd_settime(fd, 0, &its, NULL);
+}
+
+int osc_ev_set_timer_abs(int fd, uint64_t deadline_ns) {
+  struct itimerspec its = {0};
+  ns_to_timespec(deadline_ns ? deadline_ns : 1, &its.it_value);
+  return timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+int osc_ev_add_timer(osc_ev_loop *loop, uint64_t initial_ns,
+                     uint64_t interval_ns, osc_ev_callback cb, void *data) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0) {
+    perror("timerfd_create");
+    return -1;
+  }
+  if (osc_ev_set_timer(fd, initial_ns, interval_ns) < 0 ||
+      add_watch(loop, fd, OSC_EV_KIND_TIMER, EPOLLIN, cb, data) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void osc_ev_on_wake(osc_ev_loop *loop, osc_ev_callback cb, void *data) {
+  osc_ev_watch *w = find_watch(loop, loop->wake_fd);
+  w->cb = cb;
+  w->data = data;
+}
+
+void osc_ev_wake(osc_ev_loop *loop) {
+  uint64_t one = 1;
+  ssize_t r = write(loop->wake_fd, &one, sizeof(one));
+  (void)r;
+}
+
+void osc_ev_stop(osc_ev_loop *loop) {
+  loop->running = false;
+  osc_ev_wake(loop);
+}
+
+int osc_ev_run(osc_ev_loop *loop) {
+  struct epoll_event events[OSC_EV_BATCH];
+
+  while (loop->running) {
+    int n = epoll_wait(loop->epfd, events, OSC_EV_BATCH, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      return -1;
+    }
+
+    for (int i = 0; i < n && loop->running; i++) {
+      osc_ev_watch *w = events[i].data.ptr;
+      uint32_t ev = events[i].events;
+      if (w->kind == OSC_EV_KIND_FREE)
+        continue; // removed by an earlier callback in this batch
+
+      if (w->kind == OSC_EV_KIND_TIMER || w->kind == OSC_EV_KIND_WAKE) {
+        // both counters reset on read; edge-triggered so read exactly once
+        uint64_t count = 0;
+        if (read(w->fd, &count, sizeof(count)) != sizeof(count))
+          continue;
+        ev = count > UINT32_MAX ? UINT32_MAX : (uint32_t)count;
+      }
+      if (w->cb)
+        w->cb(loop, w->fd, ev, w->data);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef __OSC_EVENT_H__
+#define __OSC_EVENT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * epoll readiness loop.  Every fd is registered edge-triggered, so a
+ * callback must drain its fd (read until EAGAIN) before returning.  Timers
+ * are timerfds and the wakeup fd is an eventfd; both are drained by the
+ * loop itself before their callback runs; a timer callback receives the
+ * number of expirations in place of the epoll events.  osc_ev_run blocks
+ * with no timeout until osc_ev_stop is called.
+ */
+
+#define OSC_EV_MAX_WATCHES  64
+
+struct osc_ev_loop;
+
+typedef void (*osc_ev_callback)(struct osc_ev_loop *loop, int fd,
+                                uint32_t events, void *data);
+
+typedef struct osc_ev_watch {
+  int             fd;
+  int             kind; // OSC_EV_KIND_*
+  osc_ev_callback cb;
+  void           *data;
+} osc_ev_watch;
+
+typedef struct osc_ev_loop {
+  int          epfd;
+  int          wake_fd;
+  volatile bool running;
+  osc_ev_watch watches[OSC_EV_MAX_WATCHES];
+} osc_ev_loop;
+
+int osc_ev_init(osc_ev_loop *loop);
+void osc_ev_close(osc_ev_loop *loop);
+
+/* Watches fd for events (EPOLLIN, EPOLLOUT). Returns 0 or -1. */
+int osc_ev_add(osc_ev_loop *loop, int fd, uint32_t events, osc_ev_callback cb,
+               void *data);
+
+/* Changes the events of a watched fd. Returns 0 or -1. */
+int osc_ev_modify(osc_ev_loop *loop, int fd, uint32_t events);
+
+/* Stops watching fd. The caller still owns and closes it. */
+void osc_ev_remove(osc_ev_loop *loop, int fd);
+
+/*
+ * Creates a CLOCK_MONOTONIC timerfd that first fires after initial_ns and
+ * then every interval_ns (0 for one-shot). Returns the fd, or -1.
+ */
+int osc_ev_add_timer(osc_ev_loop *loop, uint64_t initial_ns,
+                     uint64_t interval_ns, osc_ev_callback cb, void *data);
+
+/* Re-arms a timer created by osc_ev_add_timer; initial_ns 0 disarms it. */
+int osc_ev_set_timer(int fd, uint64_t initial_ns, uint64_t interval_ns);
+
+/* Arms a timer to fire once at an absolute CLOCK_MONOTONIC time. */
+int osc_ev_set_timer_abs(int fd, uint64_t deadline_ns);
+
+/* Sets the callback run on the loop thread after osc_ev_wake. */
+void osc_ev_on_wake(osc_ev_loop *loop, osc_ev_callback cb, void *data);
+
+/* Wakes the loop from any thread or signal handler. */
+void osc_ev_wake(osc_ev_loop *loop);
+
+/* Makes osc_ev_run return; safe from a signal handler. */
+void osc_ev_stop(osc_ev_loop *loop);
+
+int osc_ev_run(osc_ev_loop *loop);
+
+#endif
@@ -0,0 +1,302 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "osc_event.h"
+#include "osc_frame.h"
+
+static Config            frames[OSC_FRAME_BUFFERS];
+static _Atomic int       current;                  // published buffer
+static _Atomic int       refs[OSC_FRAME_BUFFERS]; // readers holding each
+static _Atomic uint64_t  writes;                  // SETs seen by dispatch
+static _Atomic int       bundles;                 // bundles being dispatched
+static _Atomic bool      gate;                    // set while publishing
+
+// LUTs compiled by the SET handlers, and the copies published with each
+// frame buffer; a table is copied only when its generation moved on
+static osc_lut     staged_lut[4][LUT_CHANNEL_COUNT];
+static uint32_t    staged_gen[4][LUT_CHANNEL_COUNT];
+static osc_seqlock staged_lock[4][LUT_CHANNEL_COUNT];
+static osc_lut     frame_lut[OSC_FRAME_BUFFERS][4][LUT_CHANNEL_COUNT];
+static uint32_t    frame_gen[OSC_FRAME_BUFFERS][4][LUT_CHANNEL_COUNT];
+
+static struct {
+  osc_ev_loop     loop;
+  pthread_t       thread;
+  bool            running;
+  int             fd;
+  osc_frame_hook  hook;
+  void           *ctx;
+  uint64_t        frame;
+  uint64_t        deadline;  // CLOCK_MONOTONIC ns of the armed boundary
+  uint64_t        published; // writes at the last publish
+  pthread_mutex_t stats_lock;
+  osc_frame_stats stats;
+} clk = {.stats_lock = PTHREAD_MUTEX_INITIALIZER};
+
+static uint64_t now_ns(clockid_t id) {
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+const Config *osc_frame_acquire(void) {
+  for (;;) {
+    int i = atomic_load(&current);
+    atomic_fetch_add(&refs[i], 1);
+    // the clock may have moved on and be rewriting i; take the new one
+    if (atomic_load(&current) == i)
+      return &frames[i];
+    atomic_fetch_sub(&refs[i], 1);
+  }
+}
+
+void osc_frame_release(const Config *c) {
+  atomic_fetch_sub(&refs[c - frames], 1);
+}
+
+void osc_frame_note_write(void) {
+  atomic_fetch_add_explicit(&writes, 1, memory_order_release);
+}
+
+// a bundle may not start while a publish is copying config
+void osc_frame_bundle_begin(void) {
+  for (;;) {
+    while (atomic_load(&gate))
+      sched_yield();
+    atomic_fetch_add(&bundles, 1);
+    if (!atomic_load(&gate))
+      return;
+    atomic_fetch_sub(&bundles, 1);
+  }
+}
+
+void osc_frame_bundle_end(void) { atomic_fetch_sub(&bundles, 1); }
+
+void osc_frame_stage_lut(int send, int channel, const ConfigSendLut *points) {
+  osc_lut lut;
+  osc_lut_compile(&lut, points, OSC_LUT_CUBIC);
+  osc_seqlock *l = &staged_lock[send][channel];
+  osc_seqlock_write_begin(l);
+  staged_lut[send][channel] = lut;
+  staged_gen[send][channel]++;
+  osc_seqlock_write_end(l);
+}
+
+const osc_lut *osc_frame_lut(const Config *frame, int send, int channel) {
+  return &frame_lut[frame - frames][send][channel];
+}
+
+// brings the tables of buffer b up to the staged ones
+static void snapshot_luts(int b) {
+  for (int s = 0; s < 4; s++) {
+    for (int c = 0; c < LUT_CHANNEL_COUNT; c++) {
+      osc_seqlock *l = &staged_lock[s][c];
+      uint32_t gen;
+      OSC_SEQLOCK_READ(l, gen, staged_gen[s][c]);
+      if (gen == frame_gen[b][s][c])
+        continue;
+      uint32_t q;
+      do {
+        q = osc_seqlock_read_begin(l);
+        frame_lut[b][s][c] = staged_lut[s][c];
+        frame_gen[b][s][c] = staged_gen[s][c];
+      } while (osc_seqlock_read_retry(l, q));
+    }
+  }
+}
+
+void osc_frame_snapshot(Config *c) {
+  OSC_SEQLOCK_COPY(&config_lock, &c->analog_format, &config.analog_format,
+                   sizeof(c->analog_format));
+  OSC_SEQLOCK_READ(&config_lock, c->clock_offset, config.clock_offset);
+  OSC_SEQLOCK_COPY(&config_lock, c->sync_mode, config.sync_mode,
+                   sizeof(c->sync_mode));
+  for (int i = 0; i < 4; i++) {
+    OSC_SEQLOCK_COPY(&config_input_lock[i], &c->input[i], &config.input[i],
+                     sizeof(c->input[i]));
+    OSC_SEQLOCK_COPY(&config_send_lock[i], &c->send[i], &config.send[i],
+                     sizeof(c->send[i]));
+  }
+}
+
+// publishes config into a buffer no reader holds; returns false if every
+// spare buffer is held
+static bool publish(void) {
+  int cur = atomic_load(&current);
+  int next = -1;
+  for (int i = 0; i < OSC_FRAME_BUFFERS; i++) {
+    if (i != cur && atomic_load(&refs[i]) == 0) {
+      next = i;
+      break;
+    }
+  }
+  if (next < 0)
+    return false;
+  osc_frame_snapshot(&frames[next]);
+  snapshot_luts(next);
+  atomic_store(&current, next);
+  return true;
+}
+
+// one frame period of the published analog_format, clamped to 1..1000 fps
+static uint64_t period_ns(const Config *c) {
+  float fps = c->analog_format.framerate;
+  if (!(fps >= 1.0f))
+    fps = 1.0f;
+  if (fps > 1000.0f)
+    fps = 1000.0f;
+  return (uint64_t)(1e9 / fps);
+}
+
+// the first boundary after now: "locked" aligns boundaries to realtime
+// multiples of the period plus clock_offset, anything else runs on from
+// the previous boundary
+static uint64_t next_boundary(const Config *c, uint64_t now) {
+  uint64_t period = period_ns(c);
+  if (strcmp(c->sync_mode, "locked") == 0) {
+    int64_t rt = (int64_t)now_ns(CLOCK_REALTIME) -
+                 (int64_t)c->clock_offset * 1000000;
+    uint64_t phase = (uint64_t)(rt % (int64_t)period + (int64_t)period) %
+                     period;
+    return now + (period - phase);
+  }
+  uint64_t next = clk.deadline + period;
+  if (clk.deadline == 0 || next <= now)
+    next = now + period;
+  return next;
+}
+
+static void on_tick(osc_ev_loop *l, int fd, uint32_t expirations,
+                    void *data) {
+  uint64_t boundary = clk.deadline;
+  const Config *c = osc_frame_acquire();
+  uint64_t period = period_ns(c);
+  osc_frame_release(c);
+
+  uint64_t w = atomic_load_explicit(&writes, memory_order_acquire);
+  int published = 0, no_buffer = 0, deferred = 0;
+  if (w != clk.published) {
+    // never publish half a bundle: hold new ones off and let those under
+    // way finish.  One stuck for half a frame defers the publish to the
+    // next boundary rather than splitting it.
+    atomic_store(&gate, true);
+    uint64_t start = now_ns(CLOCK_MONOTONIC);
+    while (atomic_load(&bundles) > 0) {
+      if (now_ns(CLOCK_MONOTONIC) - start > period / 2) {
+        deferred = 1;
+        break;
+      }
+      sched_yield();
+    }
+    w = atomic_load_explicit(&writes, memory_order_acquire);
+    if (!deferred && publish()) {
+      clk.published = w;
+      published = 1;
+    } else if (!deferred) {
+      no_buffer = 1;
+    }
+    atomic_store(&gate, false);
+  }
+
+  uint64_t now = now_ns(CLOCK_MONOTONIC);
+  uint64_t latency = now > boundary ? now - boundary : 0;
+  c = osc_frame_acquire(); // the new frame's rate and sync_mode
+  clk.deadline = next_boundary(c, now);
+  osc_frame_release(c);
+  osc_ev_set_timer_abs(fd, clk.deadline);
+
+  pthread_mutex_lock(&clk.stats_lock);
+  osc_frame_stats *st = &clk.stats;
+  st->frames++;
+  st->missed += latency / period;
+  if (latency > period / 10)
+    st->late++;
+  st->published += published;
+  st->no_buffer += no_buffer;
+  st->deferred += deferred;
+  st->publish_ns_sum += latency;
+  if (latency > st->publish_ns_max)
+    st->publish_ns_max = latency;
+  pthread_mutex_unlock(&clk.stats_lock);
+
+  if (clk.hook)
+    clk.hook(clk.frame, clk.ctx);
+  clk.frame++;
+}
+
+static void *clock_main(void *arg) {
+  osc_ev_run(&clk.loop);
+  return NULL;
+}
+
+int osc_frame_start(osc_frame_hook hook, void *ctx) {
+  for (int s = 0; s < 4; s++) {
+    for (int c = 0; c < LUT_CHANNEL_COUNT; c++) {
+      ConfigSendLut points;
+      OSC_SEQLOCK_COPY(&config_send_lock[s], &points, &config.send[s].lut[c],
+                       sizeof(points));
+      osc_frame_stage_lut(s, c, &points);
+    }
+  }
+  osc_frame_snapshot(&frames[0]);
+  snapshot_luts(0);
+  atomic_store(&current, 0);
+  clk.published = atomic_load(&writes);
+  clk.hook = hook;
+  clk.ctx = ctx;
+  clk.frame = 0;
+  clk.deadline = 0;
+
+  if (osc_ev_init(&clk.loop) < 0)
+    return -1;
+  clk.fd = osc_ev_add_timer(&clk.loop, 0, 0, on_tick, NULL);
+  if (clk.fd < 0) {
+    osc_ev_close(&clk.loop);
+    return -1;
+  }
+  clk.deadline = next_boundary(&frames[0], now_ns(CLOCK_MONOTONIC));
+  osc_ev_set_timer_abs(clk.fd, clk.deadline);
+
+  if (pthread_create(&clk.thread, NULL, clock_main, NULL) != 0) {
+    perror("pthread_create");
+    osc_ev_close(&clk.loop);
+    return -1;
+  }
+  clk.running = true;
+  return 0;
+}
+
+void osc_frame_stop(void) {
+  if (!clk.running)
+    return;
+  osc_ev_stop(&clk.loop);
+  pthread_join(clk.thread, NULL);
+  osc_ev_close(&clk.loop);
+  clk.running = false;
+}
+
+void osc_frame_get_stats(osc_frame_stats *st) {
+  pthread_mutex_lock(&clk.stats_lock);
+  *st = clk.stats;
+  pthread_mutex_unlock(&clk.stats_lock);
+}
+
+void osc_frame_print_stats(const osc_frame_stats *st) {
+  if (st->frames == 0)
+    return;
+  printf("frames: %llu, %llu published, %llu late, %llu missed, "
+         "publish avg %llu us max %llu us",
+         (unsigned long long)st->frames, (unsigned long long)st->published,
+         (unsigned long long)st->late, (unsigned long long)st->missed,
+         (unsigned long long)(st->publish_ns_sum / st->frames / 1000),
+         (unsigned long long)(st->publish_ns_max / 1000));
+  if (st->no_buffer)
+    printf(", %llu without a free buffer", (unsigned long long)st->no_buffer);
+  if (st->deferred)
+    printf(", %llu deferred by a bundle", (unsigned long long)st->deferred);
+  printf("\n");
+}
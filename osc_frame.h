@@ -0,0 +1,75 @@
+#ifndef __OSC_FRAME_H__
+#define __OSC_FRAME_H__
+
+#include <stdint.h>
+
+#include "osc_config.h"
+#include "osc_lut.h"
+
+/*
+ * Frame clock.  Handlers write into config, which is the staging copy.  A
+ * thread woken by a timerfd at analog_format.framerate publishes a
+ * snapshot of it at every frame boundary, so a renderer sees each frame's
+ * parameters as one consistent Config and never half of a SET or bundle.
+ *
+ * Each snapshot carries the LUTs of every send and channel compiled to
+ * dense tables (osc_lut.h); a LUT SET compiles its table at once, and it
+ * is published with the frame like any other field.
+ *
+ * Published snapshots live in three buffers.  Readers take the current one
+ * with osc_frame_acquire and hand it back with osc_frame_release; neither
+ * blocks.  The clock only writes a buffer no reader holds.
+ *
+ * With sync_mode "locked" the boundaries fall on multiples of the frame
+ * period in CLOCK_REALTIME, shifted by clock_offset ms, so devices with
+ * synchronized clocks tick together.  Any other mode runs free from the
+ * moment the clock starts.
+ */
+
+#define OSC_FRAME_BUFFERS 3
+
+typedef struct osc_frame_stats {
+  uint64_t frames;         // ticks handled
+  uint64_t missed;         // boundaries that passed without a tick
+  uint64_t late;           // published more than a tenth of a frame late
+  uint64_t published;      // ticks that published a new snapshot
+  uint64_t no_buffer;      // publishes skipped: readers held every buffer
+  uint64_t deferred;       // publishes put off: a bundle was still running
+  uint64_t publish_ns_sum; // boundary to snapshot published
+  uint64_t publish_ns_max;
+} osc_frame_stats;
+
+typedef void (*osc_frame_hook)(uint64_t frame, void *ctx);
+
+/* Publishes the current config and starts the clock thread; hook, if not
+ * NULL, runs on it after every publish. Returns 0 or -1. */
+int osc_frame_start(osc_frame_hook hook, void *ctx);
+
+/* Stops and joins the clock thread. */
+void osc_frame_stop(void);
+
+/* The config published for the current frame, held until released. */
+const Config *osc_frame_acquire(void);
+void osc_frame_release(const Config *c);
+
+/* Copies config section by section, each under its own seqlock: every
+ * section is consistent, but a bundle may be half applied. */
+void osc_frame_snapshot(Config *c);
+
+/* The compiled LUT of a send and channel in an acquired frame. */
+const osc_lut *osc_frame_lut(const Config *frame, int send, int channel);
+
+/* Compiles a send's LUT points into the table the next frame publishes;
+ * called by the LUT SET handler. */
+void osc_frame_stage_lut(int send, int channel, const ConfigSendLut *points);
+
+/* Called by dispatch after a SET, and around a bundle so a publish never
+ * splits it. */
+void osc_frame_note_write(void);
+void osc_frame_bundle_begin(void);
+void osc_frame_bundle_end(void);
+
+void osc_frame_get_stats(osc_frame_stats *st);
+void osc_frame_print_stats(const osc_frame_stats *st);
+
+#endif
@@ -0,0 +1,201 @@
+#include <math.h>
+#include <string.h>
+
+#if __AVX2__
+#include <immintrin.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "osc_frame.h"
+#include "osc_grade.h"
+
+#define BLOCK 512 // pixels graded per pass of the tables
+
+// Rec.709 luma weights
+#define KR 0.2126
+#define KB 0.0722
+#define KG (1.0 - KR - KB)
+
+void osc_grade_init(osc_grade *g) {
+  memset(g, 0, sizeof(*g));
+}
+
+static void mul3(double out[3][3], const double a[3][3],
+                 const double b[3][3]) {
+  double t[3][3];
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      t[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c];
+  memcpy(out, t, sizeof(t));
+}
+
+// folds color_matrix, saturation, hue, contrast and brightness into m
+static void build_matrix(osc_grade *g) {
+  double contrast = 2.0 * g->bcsh[1], sat = 2.0 * g->bcsh[2];
+  double offset = 0.5 - 0.5 * contrast + (g->bcsh[0] - 0.5);
+  double angle = 2.0 * M_PI * g->bcsh[3];
+  double cs = sat * cos(angle), sn = sat * sin(angle);
+
+  // RGB to luma and the two colour differences, and back
+  const double to_ycc[3][3] = {
+      {KR, KG, KB},
+      {-KR / (2 - 2 * KB), -KG / (2 - 2 * KB), 0.5},
+      {0.5, -KG / (2 - 2 * KR), -KB / (2 - 2 * KR)},
+  };
+  const double to_rgb[3][3] = {
+      {1.0, 0.0, 2 - 2 * KR},
+      {1.0, -KB / KG * (2 - 2 * KB), -KR / KG * (2 - 2 * KR)},
+      {1.0, 2 - 2 * KB, 0.0},
+  };
+  const double chroma[3][3] = {
+      {1.0, 0.0, 0.0},
+      {0.0, cs, -sn},
+      {0.0, sn, cs},
+  };
+  double cm[3][3], m[3][3];
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      cm[r][c] = g->color_matrix[r][c];
+
+  mul3(m, chroma, to_ycc);
+  mul3(m, to_rgb, m);
+  mul3(m, m, cm);
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++)
+      g->m[r][c] = (float)(contrast * m[r][c]);
+    g->m[r][3] = (float)offset;
+  }
+}
+
+// composes the Y table into each channel's
+static void build_luts(osc_grade *g, const Config *frame, int send) {
+  const osc_lut *y = osc_frame_lut(frame, send, LUT_CHANNEL_Y);
+  g->lut_identity = true;
+  for (int c = 0; c < 3; c++) {
+    const osc_lut *ch = osc_frame_lut(frame, send, LUT_CHANNEL_R + c);
+    osc_lut *out = &g->lut[c];
+    for (int i = 0; i < OSC_LUT_SIZE; i++) {
+      out->f[i] = osc_lut_eval(ch, y->f[i]);
+      float x = (float)i / (OSC_LUT_SIZE - 1);
+      if (fabsf(out->f[i] - x) > 1e-6f)
+        g->lut_identity = false;
+    }
+    out->f[OSC_LUT_SIZE] = out->f[OSC_LUT_SIZE - 1];
+    for (int i = 0; i < OSC_LUT_CODES + 2; i++)
+      out->u10[i] = ch->u10[y->u10[i < OSC_LUT_CODES ? i : OSC_LUT_CODES - 1]];
+  }
+}
+
+bool osc_grade_update(osc_grade *g, const Config *frame, int send) {
+  const ConfigSend *s = &frame->send[send];
+  float bcsh[4] = {s->brightness, s->contrast, s->saturation, s->hue};
+  bool linear = !g->built || memcmp(bcsh, g->bcsh, sizeof(bcsh)) != 0 ||
+                memcmp(frame->analog_format.color_matrix, g->color_matrix,
+                       sizeof(g->color_matrix)) != 0;
+  bool tables = !g->built || memcmp(s->lut, g->points, sizeof(g->points));
+  if (!linear && !tables)
+    return false;
+
+  if (linear) {
+    memcpy(g->bcsh, bcsh, sizeof(bcsh));
+    memcpy(g->color_matrix, frame->analog_format.color_matrix,
+           sizeof(g->color_matrix));
+    build_matrix(g);
+  }
+  if (tables) {
+    memcpy(g->points, s->lut, sizeof(g->points));
+    build_luts(g, frame, send);
+  }
+  g->built = true;
+  g->updates++;
+  return true;
+}
+
+static inline float clamp01(float v) {
+  v = v > 0.0f ? v : 0.0f;
+  return v < 1.0f ? v : 1.0f;
+}
+
+void osc_grade_pixel(const osc_grade *g, const float in[3], float out[3]) {
+  for (int c = 0; c < 3; c++) {
+    const float *m = g->m[c];
+    float v = m[0] * in[0] + m[1] * in[1] + m[2] * in[2] + m[3];
+    out[c] = g->lut_identity ? clamp01(v) : osc_lut_eval(&g->lut[c], v);
+  }
+}
+
+// the matrix over n pixels into dst; clamped when the tables are skipped
+static void matrix(const osc_grade *g, const float *r, const float *gr,
+                   const float *b, float *dst[3], int n) {
+  int i = 0;
+  bool clamp = g->lut_identity;
+#if __AVX2__
+  const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(1.0f);
+  for (; i + 8 <= n; i += 8) {
+    __m256 vr = _mm256_loadu_ps(r + i), vg = _mm256_loadu_ps(gr + i);
+    __m256 vb = _mm256_loadu_ps(b + i);
+    for (int c = 0; c < 3; c++) {
+      const float *m = g->m[c];
+      __m256 v = _mm256_add_ps(
+          _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), vr),
+                                      _mm256_mul_ps(_mm256_set1_ps(m[1]), vg)),
+                        _mm256_mul_ps(_mm256_set1_ps(m[2]), vb)),
+          _mm256_set1_ps(m[3]));
+      if (clamp)
+        v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+      _mm256_storeu_ps(dst[c] + i, v);
+    }
+  }
+#elif __SSE2__
+  const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1.0f);
+  for (; i + 4 <= n; i += 4) {
+    __m128 vr = _mm_loadu_ps(r + i), vg = _mm_loadu_ps(gr + i);
+    __m128 vb = _mm_loadu_ps(b + i);
+    for (int c = 0; c < 3; c++) {
+      const float *m = g->m[c];
+      __m128 v = _mm_add_ps(
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), vr),
+                                _mm_mul_ps(_mm_set1_ps(m[1]), vg)),
+                     _mm_mul_ps(_mm_set1_ps(m[2]), vb)),
+          _mm_set1_ps(m[3]));
+      if (clamp)
+        v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+      _mm_storeu_ps(dst[c] + i, v);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    // loaded first: dst may be r, gr and b
+    float vr = r[i], vg = gr[i], vb = b[i];
+    for (int c = 0; c < 3; c++) {
+      const float *m = g->m[c];
+      float v = m[0] * vr + m[1] * vg + m[2] * vb + m[3];
+      dst[c][i] = clamp ? clamp01(v) : v;
+    }
+  }
+}
+
+void osc_grade_apply(const osc_grade *g, const osc_picture *in,
+                     osc_picture *out) {
+  float block[3][BLOCK];
+  for (int y = 0; y < in->height; y++) {
+    const float *r = osc_picture_row(in, 0, y);
+    const float *gr = osc_picture_row(in, 1, y);
+    const float *b = osc_picture_row(in, 2, y);
+    float *o[3] = {osc_picture_row(out, 0, y), osc_picture_row(out, 1, y),
+                   osc_picture_row(out, 2, y)};
+    if (g->lut_identity) {
+      // the matrix reads a pixel before writing it, so in place is safe
+      matrix(g, r, gr, b, o, in->width);
+      continue;
+    }
+    for (int x = 0; x < in->width; x += BLOCK) {
+      int n = in->width - x < BLOCK ? in->width - x : BLOCK;
+      float *dst[3] = {block[0], block[1], block[2]};
+      matrix(g, r + x, gr + x, b + x, dst, n);
+      for (int c = 0; c < 3; c++)
+        osc_lut_apply(&g->lut[c], block[c], o[c] + x, n);
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef __OSC_GRADE_H__
+#define __OSC_GRADE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "osc_config.h"
+#include "osc_lut.h"
+#include "osc_picture.h"
+
+/*
+ * CPU reference for what a send does to colour, applied to whole frames.
+ *
+ * Per pixel, in this order:
+ *
+ *   analog_format.color_matrix  out = M * (r, g, b)
+ *   saturation, hue             scale and rotate chroma around the grey
+ *                               axis (Rec.709 luma), luma unchanged
+ *   contrast, brightness        around mid grey: c * (v - 0.5) + 0.5 + b
+ *   LUTs                        Y on every channel, then R, G or B;
+ *                               the result is clamped to [0, 1]
+ *
+ * brightness, contrast and saturation run 0..1 with 0.5 neutral (contrast
+ * and saturation gain 2 * value, brightness offset value - 0.5); hue is a
+ * fraction of a full turn.
+ *
+ * The linear steps fold into one 3x4 matrix and the Y LUT into each
+ * channel's table, both rebuilt by osc_grade_update only when one of
+ * their parameters changed.  osc_grade_apply then makes one pass over the
+ * frame: the matrix with SSE2 (AVX2 when built with -mavx2) into a small
+ * block, then the tables over that block while it is in cache.
+ */
+
+typedef struct osc_grade {
+  float    m[3][4];      // out = m * (r, g, b, 1)
+  osc_lut  lut[3];       // Y composed with R, G and B
+  bool     lut_identity; // tables only clamp; skipped
+  uint64_t updates;      // rebuilds
+  // what m and lut were built from
+  bool          built;
+  float         bcsh[4]; // brightness, contrast, saturation, hue
+  float         color_matrix[3][3];
+  ConfigSendLut points[LUT_CHANNEL_COUNT];
+} osc_grade;
+
+void osc_grade_init(osc_grade *g);
+
+/*
+ * Brings g up to a send of frame, which must come from osc_frame_acquire
+ * (the LUTs are its compiled tables). Returns true if it rebuilt.
+ */
+bool osc_grade_update(osc_grade *g, const Config *frame, int send);
+
+/* Grades one pixel; the scalar reference for osc_grade_apply. */
+void osc_grade_pixel(const osc_grade *g, const float in[3], float out[3]);
+
+/* Grades in into out, which must be as large; they may be the same. */
+void osc_grade_apply(const osc_grade *g, const osc_picture *in,
+                     osc_picture *out);
+
+#endif
@@ -7,11 +7,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/select.h>
+#include <time.h>
 #include <unistd.h>
 
-#include "globmatch.h"
 #include "network.h"
 #include "osc_config.h"
+#include "osc_frame.h"
+#include "osc_image.h"
+#include "osc_params.h"
+#include "osc_pattern.h"
+#include "osc_ramp.h"
+#include "osc_stats.h"
 #include "tinyosc.h"
 
 #include "osc_config_defaults.c"
@@ -20,469 +26,577 @@
 *** MESSAGE HANDLING
 **/
 
-#define OSC_BUF_SIZE 1024
-static char OSC_BUFFER[OSC_BUF_SIZE];
+// Replies are templates: the address and type tag are fixed bytes and only
+// the argument is written per reply.  GETs are answered from the state
+// image and parameter SETs applied from the registry by dispatch_message,
+// so the handlers below are the commands.
 
-// Helper macro to send OSC replies
-#define send_osc(conn, path, fmt, ...)                                         \
-  do {                                                                         \
-    int _len =                                                                 \
-        tosc_writeMessage(OSC_BUFFER, OSC_BUF_SIZE, path, fmt, __VA_ARGS__);   \
-    (conn)->send(conn, OSC_BUFFER, _len);                                      \
-  } while (0)
+#define OSC_ERROR_TEXT_MAX 64
 
 // Error reply
 static void send_error_message(connectionT *conn, const char *text) {
+  static const char head[12] = "/error\0\0,s\0"; // address, then type tag
+  char buf[sizeof(head) + OSC_ERROR_TEXT_MAX];
+  size_t n = strnlen(text, OSC_ERROR_TEXT_MAX - 1);
+  size_t len = sizeof(head) + ((n + 4) & ~(size_t)3);
+
   printf("ERROR: %s\n", text);
-  send_osc(conn, "/error", "s", text);
+  memcpy(buf, head, sizeof(head));
+  memcpy(buf + sizeof(head), text, n);
+  memset(buf + sizeof(head) + n, 0, len - sizeof(head) - n);
+  conn->send(conn, buf, len);
 }
 
 // /ack handler
-static int handle_ack(tosc_message *msg, connectionT *conn) {
-  send_osc(conn, "/ack", "", NULL);
+static int handle_ack(tosc_message *msg, connectionT *conn,
+                      const osc_match *m) {
+  static const char ack[12] = "/ack\0\0\0\0,\0\0"; // no arguments
+  conn->send(conn, ack, sizeof(ack));
   return 0;
 }
 
-// parse input index 1..4 from /input/{n}/...
-static int parse_input_index(tosc_message *msg, connectionT *conn) {
-  // /input/n
-  // 01234567
-  //        ^
+static int sync_all(tosc_message *msg, connectionT *conn, const osc_match *m);
+static int handle_subscribe(tosc_message *msg, connectionT *conn,
+                            const osc_match *m);
+static int handle_unsubscribe(tosc_message *msg, connectionT *conn,
+                              const osc_match *m);
+static int handle_ramp(tosc_message *msg, connectionT *conn,
+                       const osc_match *m);
+static int handle_stats(tosc_message *msg, connectionT *conn,
+                        const osc_match *m);
+
+// Commands; dispatch_init appends a row per entry of osc_params
+static const dispatch_entry dispatch_commands[] = {
+    {"/ack", "", handle_ack},
+    {"/sync", "h", sync_all},
+    {"/subscribe", "s", handle_subscribe},
+    {"/unsubscribe", "s", handle_unsubscribe},
+    {"/ramp", "sffs", handle_ramp},
+    {"/stats", "s", handle_stats},
+    {NULL, NULL, NULL}};
 
-  int d = msg->buffer[7] - '1';
-  if ((d < 0) || (d > 3)) {
-    send_error_message(conn, "Invalid input number");
-    tosc_printMessage(msg);
-    return -1;
+#define DISPATCH_MAX_ENTRIES 64
+
+dispatch_entry dispatch_table[DISPATCH_MAX_ENTRIES + 1];
+
+// dispatch_table compiled into a segment trie, payload = table index
+static osc_trie dispatch_trie;
+
+#define IMAGE_KEYS           64 // two captures of up to 8 positions each
+
+// every field of config as ready OSC messages, for /sync
+static osc_image state_image;
+// peers that get changed fields pushed every frame
+static osc_subs subscriptions;
+// fields moving towards a target, advanced every frame
+static osc_ramps ramps;
+// image field behind each (entry, captures), or -1
+static short image_field[DISPATCH_MAX_ENTRIES][IMAGE_KEYS];
+// and the other way: the entry and captures of each field
+static short     field_entry[OSC_IMAGE_MAX_FIELDS];
+static osc_match field_match[OSC_IMAGE_MAX_FIELDS];
+
+static int image_key(const osc_match *m) {
+  int key = 0;
+  for (int i = 0; i < m->count; i++) {
+    if (i > 1 || m->index[i] > 7)
+      return -1;
+    key |= m->index[i] << (3 * i);
   }
-  return d;
+  return key;
 }
 
-// parse send index 1..4 from /send/{n}/...
-static int parse_send_index(tosc_message *msg, connectionT *conn) {
-  // /send/n
-  // 0123456
-  //       ^
-
-  int d = msg->buffer[6] - '1';
-  if ((d < 0) || (d > 3)) {
-    send_error_message(conn, "Invalid send number");
-    tosc_printMessage(msg);
-    return -1;
+static void image_add(const char *path, osc_image_type type, int count,
+                      const void *value, osc_seqlock *lock) {
+  osc_match m;
+  int entry = osc_trie_match(&dispatch_trie, path, &m);
+  int key = image_key(&m);
+  int f = osc_image_add(&state_image, path, type, count, value, lock);
+  if (entry < 0 || entry >= DISPATCH_MAX_ENTRIES || key < 0 || f < 0) {
+    printf("ERROR: cannot add %s to the state image\n", path);
+    return;
   }
-  return d;
+  image_field[entry][key] = (short)f;
+  field_entry[f] = (short)entry;
+  field_match[f] = m;
 }
 
-// parse matrix row/col from /analog_format/color_matrix/{r}/{c}
-static int parse_matrix_coords(tosc_message *msg, connectionT *conn, int *row,
-                               int *col) {
-  // /analog_format/color_matrix/R/C
-  // 0123456789ABCDEF0123456789ABCDE
-  //                             ^ ^
-
-  int r = msg->buffer[0x1C] - '0';
-  int c = msg->buffer[0x1E] - '0';
-  if ((r < 0) || (r > 2) || (c < 0) || (c > 2)) {
-    send_error_message(conn, "Matrix index out of bounds");
-    tosc_printMessage(msg);
-    return -1;
+// registers every parameter, expanded over its indices
+static void build_state_image(void) {
+  char path[OSC_IMAGE_PATH_LEN];
+
+  memset(image_field, -1, sizeof(image_field));
+  osc_image_init(&state_image);
+  for (int k = 0; k < osc_param_count; k++) {
+    const osc_param *p = &osc_params[k];
+    osc_match m;
+    osc_param_first(p, &m);
+    do {
+      if (osc_param_path(p, &m, path, sizeof(path)) < 0) {
+        printf("ERROR: cannot expand %s\n", p->pattern);
+        break;
+      }
+      image_add(path, p->type, p->count, osc_param_value(p, &m),
+                osc_param_lock(p, &m));
+    } while (osc_param_next(p, &m));
   }
-  *row = r;
-  *col = c;
-  return 0;
+  osc_image_build(&state_image);
+  osc_subs_init(&subscriptions);
+  osc_ramps_init(&ramps);
 }
 
-char message_to_lut_channel(tosc_message *m, connectionT *conn) {
-  // /send/n/lut/C
-  // 0123456789ABC
-  //             ^
+void dispatch_init(void) {
+  osc_stats_init();
+  int n = 0;
+  for (int i = 0; dispatch_commands[i].path_pattern; i++)
+    dispatch_table[n++] = dispatch_commands[i];
+  for (int k = 0; k < osc_param_count && n < DISPATCH_MAX_ENTRIES; k++) {
+    const osc_param *p = &osc_params[k];
+    dispatch_table[n++] = (dispatch_entry){p->pattern, p->type_sig, NULL, p};
+  }
+  if (n == DISPATCH_MAX_ENTRIES)
+    printf("ERROR: more than %d dispatch entries\n", DISPATCH_MAX_ENTRIES);
+  dispatch_table[n] = (dispatch_entry){NULL, NULL, NULL, NULL};
 
-  char c = m->buffer[0xC];
-  if (c != 'Y' && c != 'R' && c != 'G' && c != 'B') {
-    send_error_message(conn, "Invalid LUT channel");
-    return -1;
+  osc_trie_init(&dispatch_trie);
+  for (int i = 0; dispatch_table[i].path_pattern; i++) {
+    if (osc_trie_add(&dispatch_trie, dispatch_table[i].path_pattern, i) < 0)
+      printf("ERROR: cannot compile pattern %s\n",
+             dispatch_table[i].path_pattern);
   }
-  return c;
+  // state restored from disk may predate a limit
+  int clamped = osc_params_sanitize(&config);
+  if (clamped)
+    printf("clamped %d restored values into range\n", clamped);
+  build_state_image();
 }
 
-// Handler generator macros
-
-#define DEFINE_HANDLER_INT(name, field)                                        \
-  static int name(tosc_message *msg, connectionT *conn) {                      \
-    const char *path = tosc_getAddress(msg);                                   \
-    int idx = parse_input_index(msg, conn);                                    \
-    if (idx < 0)                                                               \
-      return 0;                                                                \
-    if (msg->format[0] == '\0') {                                              \
-      send_osc(conn, path, "i", config.input[idx].field);                      \
-    } else {                                                                   \
-      int v = tosc_getNextInt32(msg);                                          \
-      config.input[idx].field = v;                                             \
-    }                                                                          \
-    return 0;                                                                  \
+// whether entry e takes a message with these type tags; an empty format
+// is a GET and is taken by every entry
+static bool accepts(const dispatch_entry *e, const char *format) {
+  if (format[0] == '\0' || e->type_sig[0] == '\0')
+    return true;
+  return e->param ? osc_param_accepts(e->param, format)
+                  : strcmp(e->type_sig, format) == 0;
+}
+
+// a SET of one entry, and of the field behind it if it has one
+static void apply_set(int entry, const osc_match *m, int field,
+                      tosc_message *osc, connectionT *conn) {
+  // a SET takes over from a ramp of its field; cancelled first so the
+  // next step cannot overwrite it
+  if (field >= 0)
+    osc_ramps_cancel(&ramps, field);
+  const dispatch_entry *e = &dispatch_table[entry];
+  if (e->param)
+    osc_param_set(e->param, m, osc);
+  else
+    e->handler(osc, conn, m);
+
+  // a SET re-encodes its field in the state image and, if that changed
+  // it, flags it for push and for the next published frame
+  if (field >= 0 && osc_image_refresh(&state_image, field)) {
+    osc_subs_mark(&subscriptions, field);
+    osc_frame_note_write();
   }
+}
 
-#define DEFINE_HANDLER_STR(name, field)                                        \
-  static int name(tosc_message *msg, connectionT *conn) {                      \
-    const char *path = tosc_getAddress(msg);                                   \
-    int idx = parse_input_index(msg, conn);                                    \
-    if (idx < 0)                                                               \
-      return 0;                                                                \
-    if (msg->format[0] == '\0') {                                              \
-      send_osc(conn, path, "s", config.input[idx].field);                      \
-    } else {                                                                   \
-      const char *s = tosc_getNextString(msg);                                 \
-      strncpy(config.input[idx].field, s, CONFIG_MAX_STR_LEN - 1);             \
-    }                                                                          \
-    return 0;                                                                  \
+#define PATTERN_CACHE 16
+
+// recent address patterns and the state image fields they matched, per
+// thread so a lookup takes no lock; the fields never change after
+// dispatch_init
+typedef struct pattern_entry {
+  char     pattern[OSC_PATTERN_MAX_LEN];
+  uint64_t fields[OSC_IMAGE_WORDS];
+  int      count;
+} pattern_entry;
+
+static __thread pattern_entry pattern_cache[PATTERN_CACHE];
+static __thread int pattern_next;
+
+// Sets the bits of the state image fields that pattern matches. Returns
+// how many, or -1 if the pattern does not compile.
+static int pattern_fields(const char *pattern, uint64_t *fields) {
+  for (int i = 0; i < PATTERN_CACHE; i++) {
+    pattern_entry *e = &pattern_cache[i];
+    if (e->pattern[0] && strcmp(e->pattern, pattern) == 0) {
+      memcpy(fields, e->fields, sizeof(e->fields));
+      return e->count;
+    }
   }
 
-#define DEFINE_HANDLER_FLOAT(name, field)                                      \
-  static int name(tosc_message *msg, connectionT *conn) {                      \
-    const char *path = tosc_getAddress(msg);                                   \
-    int idx = parse_input_index(msg, conn);                                    \
-    if (idx < 0)                                                               \
-      return 0;                                                                \
-    if (msg->format[0] == '\0') {                                              \
-      send_osc(conn, path, "f", config.input[idx].field);                      \
-    } else {                                                                   \
-      float v = tosc_getNextFloat(msg);                                        \
-      config.input[idx].field = v;                                             \
-    }                                                                          \
-    return 0;                                                                  \
+  osc_pattern p;
+  if (osc_pattern_compile(&p, pattern) < 0)
+    return -1;
+  int count = 0;
+  memset(fields, 0, OSC_IMAGE_WORDS * sizeof(uint64_t));
+  for (int i = 0; i < state_image.field_count; i++) {
+    if (osc_pattern_match(&p, state_image.fields[i].path)) {
+      fields[i >> 6] |= 1ull << (i & 63);
+      count++;
+    }
   }
 
-// Input handlers
-DEFINE_HANDLER_STR(handle_input_resolution, resolution)
-DEFINE_HANDLER_FLOAT(handle_input_framerate, framerate)
-DEFINE_HANDLER_STR(handle_input_colorspace, colorspace)
-DEFINE_HANDLER_INT(handle_input_bit_depth, bit_depth)
-DEFINE_HANDLER_STR(handle_input_chroma_subsampling, chroma_subsampling)
-
-static int handle_input_connected(tosc_message *msg, connectionT *conn) {
-  const char *addr = tosc_getAddress(msg);
-  int idx = parse_input_index(msg, conn);
-  if (idx < 0)
-    return 0;
+  pattern_entry *e = &pattern_cache[pattern_next];
+  pattern_next = (pattern_next + 1) % PATTERN_CACHE;
+  strcpy(e->pattern, pattern); // shorter than OSC_PATTERN_MAX_LEN: compiled
+  memcpy(e->fields, fields, sizeof(e->fields));
+  e->count = count;
+  return count;
+}
 
-  // GET (no format): reply with OSC boolean 'T' or 'F'
-  if (msg->format[0] == '\0') {
-    send_osc(conn, addr, config.input[idx].connected ? "T" : "F", NULL);
-  }
-  // SET: expect format 'T' or 'F'
-  else if (msg->format[0] == 'T' || msg->format[0] == 'F') {
-    config.input[idx].connected = (msg->format[0] == 'T');
+// An address pattern: a GET replies with every field it matches, packed
+// the handler time of entry i since t0, less what its replies took to
+// send, and that send time; starts the next entry's send time at 0
+static void record_handler(osc_stats_shard *st, int i, uint64_t t0) {
+  uint64_t spent = osc_stats_now() - t0, sent = st->send_ticks;
+  osc_stats_record(i, OSC_PHASE_HANDLER, spent > sent ? spent - sent : 0);
+  if (sent)
+    osc_stats_record(i, OSC_PHASE_SEND, sent);
+  st->send_ticks = 0;
+}
+
+// into bundles; a SET applies to each matched field whose entry takes the
+// message's type tags, and each entry it reaches is timed as if addressed
+// alone, the lookup from t0 being its match.  A GET's bundles are sent
+// once for all its fields, so each is recorded an even share of that.
+static void dispatch_pattern(tosc_message *osc, connectionT *conn,
+                             osc_stats_shard *st, uint64_t parse,
+                             uint64_t t0) {
+  uint64_t fields[OSC_IMAGE_WORDS];
+  int n = pattern_fields(osc->buffer, fields);
+  uint64_t match = osc_stats_now() - t0;
+  if (n <= 0) {
+    osc_stats_bump(&st->counter[OSC_STAT_INVALID_ADDRESS], 1);
+    send_error_message(conn, n < 0 ? "malformed address pattern"
+                                   : "invalid address");
+    return;
   }
-  // Error on any other format
-  else {
-    send_osc(conn, "/error", "s", "Expected boolean T or F");
+  if (osc->format[0] == '\0') {
+    uint64_t t1 = osc_stats_now();
+    osc_image_send_fields(&state_image, fields, conn, NULL);
+    uint64_t spent = (osc_stats_now() - t1) / (uint64_t)n;
+    uint64_t sent = st->send_ticks / (uint64_t)n;
+    st->send_ticks = 0;
+    for (int w = 0; w < OSC_IMAGE_WORDS; w++) {
+      for (uint64_t bits = fields[w]; bits; bits &= bits - 1) {
+        int i = field_entry[(w << 6) + __builtin_ctzll(bits)];
+        osc_stats_record(i, OSC_PHASE_PARSE, parse);
+        osc_stats_record(i, OSC_PHASE_MATCH, match);
+        osc_stats_record(i, OSC_PHASE_HANDLER,
+                         spent > sent ? spent - sent : 0);
+        if (sent)
+          osc_stats_record(i, OSC_PHASE_SEND, sent);
+      }
+    }
+    return;
   }
 
-  return 0;
+  char *args = osc->marker;
+  int applied = 0;
+  for (int w = 0; w < OSC_IMAGE_WORDS; w++) {
+    for (uint64_t bits = fields[w]; bits; bits &= bits - 1) {
+      int f = (w << 6) + __builtin_ctzll(bits);
+      int i = field_entry[f];
+      if (!accepts(&dispatch_table[i], osc->format))
+        continue;
+      osc->marker = args; // each handler reads the arguments afresh
+      osc_stats_record(i, OSC_PHASE_PARSE, parse);
+      osc_stats_record(i, OSC_PHASE_MATCH, match);
+      uint64_t t1 = osc_stats_now();
+      apply_set(i, &field_match[f], f, osc, conn);
+      record_handler(st, i, t1);
+      applied++;
+    }
+  }
+  if (applied == 0) {
+    osc_stats_bump(&st->counter[OSC_STAT_FORMAT_MISMATCH], 1);
+    send_error_message(conn, "format mismatch");
+  }
 }
 
-// clock_offset
-static int handle_clock_offset(tosc_message *msg, connectionT *conn) {
-  const char *path = "/clock_offset";
-  if (msg->format[0] == '\0')
-    send_osc(conn, path, "i", config.clock_offset);
-  else {
-    int v = tosc_getNextInt32(msg);
-    config.clock_offset = v;
+// Central dispatch.  Each phase is timed into the entry's histograms:
+// the parse the server noted, the match, the handler and its sends.  An
+// address the trie does not know may be a pattern over the state image.
+void dispatch_message(tosc_message *osc, connectionT *conn) {
+  osc_stats_shard *st = osc_stats_shard_get();
+  uint64_t parse = st->parse_ticks;
+  uint64_t t0 = st->parse_end ? st->parse_end : osc_stats_now();
+  st->parse_ticks = st->parse_end = st->send_ticks = 0;
+
+  osc_match m;
+  int i = osc_trie_match(&dispatch_trie, osc->buffer, &m);
+  uint64_t t1 = osc_stats_now();
+  osc_stats_bump(&st->counter[OSC_STAT_MESSAGES], 1);
+  if (i < 0) {
+    if (osc_pattern_is_pattern(osc->buffer)) {
+      dispatch_pattern(osc, conn, st, parse, t0);
+      return;
+    }
+    osc_stats_bump(&st->counter[OSC_STAT_INVALID_ADDRESS], 1);
+    send_error_message(conn, "invalid address");
+    return;
   }
-  return 0;
+  osc_stats_record(i, OSC_PHASE_PARSE, parse);
+  osc_stats_record(i, OSC_PHASE_MATCH, t1 - t0);
+  if (!accepts(&dispatch_table[i], osc->format)) {
+    osc_stats_bump(&st->counter[OSC_STAT_FORMAT_MISMATCH], 1);
+    send_error_message(conn, "format mismatch");
+    return;
+  }
+
+  int key = image_key(&m);
+  int field = key >= 0 ? image_field[i][key] : -1;
+  if (field >= 0 && osc->format[0] == '\0')
+    osc_image_send_field(&state_image, field, conn); // GET: reply as encoded
+  else
+    apply_set(i, &m, field, osc, conn);
+  record_handler(st, i, t1);
 }
 
-// sync_mode
-static int handle_sync_mode(tosc_message *msg, connectionT *conn) {
-  const char *path = "/sync_mode";
-  if (msg->format[0] == '\0')
-    send_osc(conn, path, "s", config.sync_mode);
-  else {
-    const char *s = tosc_getNextString(msg);
-    strncpy(config.sync_mode, s, CONFIG_MAX_STR_LEN - 1);
-  }
-  return 0;
+int dispatch_set_field(tosc_message *osc) {
+  osc_match m;
+  int i = osc_trie_match(&dispatch_trie, osc->buffer, &m);
+  if (i < 0 || !dispatch_table[i].param || osc->format[0] == '\0' ||
+      !accepts(&dispatch_table[i], osc->format))
+    return -1;
+  int key = image_key(&m);
+  return key >= 0 ? image_field[i][key] : -1;
 }
 
-// analog_format handlers
-static int handle_analog_resolution(tosc_message *msg, connectionT *conn) {
-  const char *path = "/analog_format/resolution";
-  if (msg->format[0] == '\0')
-    send_osc(conn, path, "s", config.analog_format.resolution);
-  else {
-    const char *s = tosc_getNextString(msg);
-    strncpy(config.analog_format.resolution, s, CONFIG_MAX_STR_LEN - 1);
-  }
-  return 0;
+// the entry and captures come from the field; the scan that keyed it
+// parsed and matched it
+void dispatch_set(tosc_message *osc, int field, uint64_t parse, uint64_t match,
+                  connectionT *conn) {
+  osc_stats_shard *st = osc_stats_shard_get();
+  st->parse_ticks = st->parse_end = st->send_ticks = 0;
+  osc_stats_bump(&st->counter[OSC_STAT_MESSAGES], 1);
+  int i = field_entry[field];
+  osc_stats_record(i, OSC_PHASE_PARSE, parse);
+  osc_stats_record(i, OSC_PHASE_MATCH, match);
+  uint64_t t0 = osc_stats_now();
+  apply_set(i, &field_match[field], field, osc, conn);
+  record_handler(st, i, t0);
 }
-static int handle_analog_framerate(tosc_message *msg, connectionT *conn) {
-  const char *path = "/analog_format/framerate";
-  if (msg->format[0] == '\0')
-    send_osc(conn, path, "f", config.analog_format.framerate);
-  else {
-    float v = tosc_getNextFloat(msg);
-    config.analog_format.framerate = v;
-  }
-  return 0;
+
+// /sync/seq ,h: the sequence a sync brought the peer up to
+static void send_sync_seq(connectionT *conn, uint64_t seq) {
+  static const char head[16] = "/sync/seq\0\0\0,h\0"; // address, type tag
+  char buf[sizeof(head) + 8];
+  uint32_t hi = htonl((uint32_t)(seq >> 32)), lo = htonl((uint32_t)seq);
+  memcpy(buf, head, sizeof(head));
+  memcpy(buf + sizeof(head), &hi, 4);
+  memcpy(buf + sizeof(head) + 4, &lo, 4);
+  conn->send(conn, buf, sizeof(buf));
 }
-static int handle_analog_colourspace(tosc_message *msg, connectionT *conn) {
-  const char *path = "/analog_format/colourspace";
-  if (msg->format[0] == '\0')
-    send_osc(conn, path, "s", config.analog_format.colourspace);
-  else {
-    const char *s = tosc_getNextString(msg);
-    strncpy(config.analog_format.colourspace, s, CONFIG_MAX_STR_LEN - 1);
+
+// sync_all: "/sync" sends the state image; "/sync ,h seq" only the fields
+// changed since seq, unless seq is unknown or that is most of them.  Both
+// end with /sync/seq and the usual ack.
+static int sync_all(tosc_message *msg, connectionT *conn, const osc_match *m) {
+  uint64_t seq;
+  if (msg->format[0] == 'h') {
+    uint64_t fields[OSC_IMAGE_WORDS];
+    int n = osc_image_changed_since(&state_image, tosc_getNextInt64(msg),
+                                    fields, &seq);
+    if (n >= 0 && n <= state_image.field_count / 2) {
+      osc_image_send_fields(&state_image, fields, conn, NULL);
+      send_sync_seq(conn, seq);
+      handle_ack(msg, conn, m);
+      return 0;
+    }
   }
+  osc_image_send(&state_image, conn, &seq);
+  send_sync_seq(conn, seq);
+  handle_ack(msg, conn, m);
   return 0;
 }
-static int handle_analog_color_matrix(tosc_message *msg, connectionT *conn) {
-  int r, c;
-  if (parse_matrix_coords(msg, conn, &r, &c) < 0)
+
+// /subscribe and /unsubscribe: the fields whose address matches the OSC
+// address pattern, for the peer that sent the message
+static int subscribe(tosc_message *msg, connectionT *conn, bool add) {
+  const char *pattern = tosc_getNextString(msg);
+  uint64_t fields[OSC_SUBS_WORDS];
+  int matched = pattern_fields(pattern, fields);
+  if (matched < 0) {
+    send_error_message(conn, "malformed address pattern");
+    return 0;
+  }
+  if (matched == 0) {
+    send_error_message(conn, "no address matches the pattern");
     return 0;
-  char path[64];
-  snprintf(path, sizeof(path), "/analog_format/color_matrix/%d/%d", r, c);
-  if (msg->format[0] == '\0')
-    send_osc(conn, path, "f", config.analog_format.color_matrix[r][c]);
-  else {
-    float v = tosc_getNextFloat(msg);
-    config.analog_format.color_matrix[r][c] = v;
   }
+  if (osc_subs_update(&subscriptions, conn, fields, add) < 0)
+    send_error_message(conn, "too many subscribers");
+  else
+    handle_ack(msg, conn, NULL);
   return 0;
 }
 
-// send_input
-static int handle_send_input(tosc_message *msg, connectionT *conn) {
-  int idx = parse_send_index(msg, conn);
-  if (idx < 0)
+static int handle_subscribe(tosc_message *msg, connectionT *conn,
+                            const osc_match *m) {
+  return subscribe(msg, conn, true);
+}
+
+static int handle_unsubscribe(tosc_message *msg, connectionT *conn,
+                              const osc_match *m) {
+  return subscribe(msg, conn, false);
+}
+
+// /ramp ,sffs address target seconds curve: moves a float of a send or
+// analog_format to target over seconds
+static int handle_ramp(tosc_message *msg, connectionT *conn,
+                       const osc_match *m) {
+  if (strcmp(msg->format, "sffs") != 0) {
+    send_error_message(conn, "format mismatch");
     return 0;
-  const char *path = tosc_getAddress(msg);
-  if (msg->format[0] == '\0')
-    send_osc(conn, path, "i", config.send[idx].input);
-  else {
-    int v = tosc_getNextInt32(msg);
-    config.send[idx].input = v;
   }
+  const char *path = tosc_getNextString(msg);
+  float target = tosc_getNextFloat(msg);
+  float seconds = tosc_getNextFloat(msg);
+  int curve = osc_ramp_curve_parse(tosc_getNextString(msg));
+
+  osc_match pm;
+  int entry = osc_trie_match(&dispatch_trie, path, &pm);
+  int key = entry >= 0 ? image_key(&pm) : -1;
+  int field = key >= 0 ? image_field[entry][key] : -1;
+  const osc_image_field *f = field >= 0 ? &state_image.fields[field] : NULL;
+  const osc_param *p = f ? dispatch_table[entry].param : NULL;
+  if (!p || !(p->flags & OSC_PARAM_RAMP)) {
+    send_error_message(conn, "not a rampable address");
+    return 0;
+  }
+  if (curve < 0) {
+    send_error_message(conn, "unknown ramp curve");
+    return 0;
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t now = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+  target = osc_param_clamp(p, target);
+  if (osc_ramps_start(&ramps, field, (float *)f->value, f->lock, target,
+                      seconds, (osc_ramp_curve)curve, now) < 0)
+    send_error_message(conn, "too many ramps");
   return 0;
 }
 
-// send floats
-#define DEFINE_SEND_FLOAT(name, field)                                         \
-  static int name(tosc_message *msg, connectionT *conn) {                      \
-    int idx = parse_send_index(msg, conn);                                     \
-    if (idx < 0)                                                               \
-      return 0;                                                                \
-    const char *path = tosc_getAddress(msg);                                   \
-    if (msg->format[0] == '\0')                                                \
-      send_osc(conn, path, "f", config.send[idx].field);                       \
-    else {                                                                     \
-      float v = tosc_getNextFloat(msg);                                        \
-      config.send[idx].field = v;                                              \
-    }                                                                          \
-    return 0;                                                                  \
-  }
-
-DEFINE_SEND_FLOAT(handle_send_scaleX, scaleX)
-DEFINE_SEND_FLOAT(handle_send_scaleY, scaleY)
-DEFINE_SEND_FLOAT(handle_send_posX, posX)
-DEFINE_SEND_FLOAT(handle_send_posY, posY)
-DEFINE_SEND_FLOAT(handle_send_rotation, rotation)
-DEFINE_SEND_FLOAT(handle_send_pitch, pitch)
-DEFINE_SEND_FLOAT(handle_send_yaw, yaw)
-DEFINE_SEND_FLOAT(handle_send_brightness, brightness)
-DEFINE_SEND_FLOAT(handle_send_contrast, contrast)
-DEFINE_SEND_FLOAT(handle_send_saturation, saturation)
-DEFINE_SEND_FLOAT(handle_send_hue, hue)
-
-static int handle_send_lut(tosc_message *msg, connectionT *conn) {
-    int idx = parse_send_index(msg, conn);
-    if (idx < 0) return 0;
-
-    char ch = message_to_lut_channel(msg, conn);
-    if (ch < 0) return 0;
-
-    LutChannel lc;
-    switch (ch) {
-      case 'Y': lc = LUT_CHANNEL_Y; break;
-      case 'R': lc = LUT_CHANNEL_R; break;
-      case 'G': lc = LUT_CHANNEL_G; break;
-      case 'B': lc = LUT_CHANNEL_B; break;
-      default:
-        send_error_message(conn, "Invalid LUT channel");
-        return 0;
+int dispatch_ramps(uint64_t now_ns) {
+  uint64_t changed[OSC_IMAGE_WORDS] = {0};
+  if (osc_ramps_step(&ramps, now_ns, changed) == 0)
+    return 0;
+  int n = 0;
+  for (int w = 0; w < OSC_IMAGE_WORDS; w++) {
+    for (uint64_t bits = changed[w]; bits; bits &= bits - 1) {
+      int field = (w << 6) + __builtin_ctzll(bits);
+      if (osc_image_refresh(&state_image, field)) {
+        osc_subs_mark(&subscriptions, field);
+        n++;
+      }
     }
+  }
+  if (n)
+    osc_frame_note_write();
+  return n;
+}
 
-    const char *path = tosc_getAddress(msg);
-    // format string of 32 'f's
-    char fmt[33];
-    for (int i = 0; i < 32; i++) fmt[i] = 'f';
-    fmt[32] = '\0';
-
-    if (msg->format[0] == '\0') {
-        int len = tosc_writeMessage(
-            OSC_BUFFER, OSC_BUF_SIZE, path, fmt,
-            config.send[idx].lut[lc].points[0].x,  config.send[idx].lut[lc].points[0].y,
-            config.send[idx].lut[lc].points[1].x,  config.send[idx].lut[lc].points[1].y,
-            config.send[idx].lut[lc].points[2].x,  config.send[idx].lut[lc].points[2].y,
-            config.send[idx].lut[lc].points[3].x,  config.send[idx].lut[lc].points[3].y,
-            config.send[idx].lut[lc].points[4].x,  config.send[idx].lut[lc].points[4].y,
-            config.send[idx].lut[lc].points[5].x,  config.send[idx].lut[lc].points[5].y,
-            config.send[idx].lut[lc].points[6].x,  config.send[idx].lut[lc].points[6].y,
-            config.send[idx].lut[lc].points[7].x,  config.send[idx].lut[lc].points[7].y,
-            config.send[idx].lut[lc].points[8].x,  config.send[idx].lut[lc].points[8].y,
-            config.send[idx].lut[lc].points[9].x,  config.send[idx].lut[lc].points[9].y,
-            config.send[idx].lut[lc].points[10].x, config.send[idx].lut[lc].points[10].y,
-            config.send[idx].lut[lc].points[11].x, config.send[idx].lut[lc].points[11].y,
-            config.send[idx].lut[lc].points[12].x, config.send[idx].lut[lc].points[12].y,
-            config.send[idx].lut[lc].points[13].x, config.send[idx].lut[lc].points[13].y,
-            config.send[idx].lut[lc].points[14].x, config.send[idx].lut[lc].points[14].y,
-            config.send[idx].lut[lc].points[15].x, config.send[idx].lut[lc].points[15].y
-        );
-        conn->send(conn, OSC_BUFFER, len);
-    } else {
-        for (int i = 0; i < LUT_CONTROL_POINT_COUNT; i++) {
-            float x = tosc_getNextFloat(msg);
-            float y = tosc_getNextFloat(msg);
-            config.send[idx].lut[lc].points[i].x = x;
-            config.send[idx].lut[lc].points[i].y = y;
-        }
-    }
+void dispatch_ramp_stats(osc_ramp_stats *st) {
+  osc_ramps_get_stats(&ramps, st);
+}
 
-    return 0;
+// one message of a /stats reply, appended to a bundle in buf; a full
+// bundle is sent first
+typedef struct stats_reply {
+  connectionT *conn;
+  char         buf[OSC_IMAGE_MTU];
+  tosc_bundle  bundle;
+  uint32_t     len;
+} stats_reply;
+
+static void stats_flush(stats_reply *r) {
+  if (r->len > 16)
+    r->conn->send(r->conn, r->buf, r->len);
+  tosc_writeBundle(&r->bundle, 1, r->buf, sizeof(r->buf)); // 1: immediately
+  r->len = 16;
 }
 
+static void stats_put(stats_reply *r, const char *msg, uint32_t len) {
+  if (r->len + 4 + len > sizeof(r->buf))
+    stats_flush(r);
+  uint32_t be = htonl(len);
+  memcpy(r->buf + r->len, &be, 4);
+  memcpy(r->buf + r->len + 4, msg, len);
+  r->len += 4 + len;
+}
 
-static int sync_all(tosc_message *msg, connectionT *conn);
+static int32_t clamp_ns(uint64_t ns) {
+  return ns > INT32_MAX ? INT32_MAX : (int32_t)ns;
+}
 
-// Dispatch table
-static dispatch_entry dispatch_table[] = {
-    {"/ack", "", handle_ack},
-    {"/sync", "", sync_all},
-    {"/sync_mode", "s", handle_sync_mode},
-    {"/input/[1-4]/connected", "T", handle_input_connected},
-    {"/input/[1-4]/resolution", "s", handle_input_resolution},
-    {"/input/[1-4]/framerate", "f", handle_input_framerate},
-    {"/input/[1-4]/colorspace", "s", handle_input_colorspace},
-    {"/input/[1-4]/bit_depth", "i", handle_input_bit_depth},
-    {"/input/[1-4]/chroma_subsampling", "s", handle_input_chroma_subsampling},
-    {"/clock_offset", "i", handle_clock_offset},
-    {"/analog_format/resolution", "s", handle_analog_resolution},
-    {"/analog_format/framerate", "f", handle_analog_framerate},
-    {"/analog_format/colourspace", "s", handle_analog_colourspace},
-    {"/analog_format/color_matrix/[0-2]/[0-2]", "f",
-     handle_analog_color_matrix},
-    {"/send/[1-4]/input", "i", handle_send_input},
-    {"/send/[1-4]/scaleX", "f", handle_send_scaleX},
-    {"/send/[1-4]/scaleY", "f", handle_send_scaleY},
-    {"/send/[1-4]/posX", "f", handle_send_posX},
-    {"/send/[1-4]/posY", "f", handle_send_posY},
-    {"/send/[1-4]/rotation", "f", handle_send_rotation},
-    {"/send/[1-4]/pitch", "f", handle_send_pitch},
-    {"/send/[1-4]/yaw", "f", handle_send_yaw},
-    {"/send/[1-4]/brightness", "f", handle_send_brightness},
-    {"/send/[1-4]/contrast", "f", handle_send_contrast},
-    {"/send/[1-4]/saturation", "f", handle_send_saturation},
-    {"/send/[1-4]/hue", "f", handle_send_hue},
-    {"/send/[1-4]/lut/[YRGB]", "ffffffffffffffffffffffffffffffff", handle_send_lut},
-    {NULL, NULL, NULL}};
+// /stats: replies with bundles of /stats/<counter> ,h for each counter
+// and, for each entry that saw traffic, /stats/handler ,sh then p50, p90,
+// p99 and max in ns (,i each) of parse, match, handler and send.
+// /stats ,s reset zeroes them all.
+static int handle_stats(tosc_message *msg, connectionT *conn,
+                        const osc_match *m) {
+  if (msg->format[0] == 's') {
+    if (strcmp(tosc_getNextString(msg), "reset") != 0) {
+      send_error_message(conn, "expected reset");
+      return 0;
+    }
+    osc_stats_reset();
+    handle_ack(msg, conn, m);
+    return 0;
+  }
 
-// Central dispatch
-void dispatch_message(tosc_message *osc, connectionT *conn) {
+  stats_reply r = {.conn = conn};
+  char out[256], addr[OSC_IMAGE_PATH_LEN];
+  stats_flush(&r);
+  for (int c = 0; c < OSC_STAT_COUNTERS; c++) {
+    snprintf(addr, sizeof(addr), "/stats/%s", osc_stats_counter_name(c));
+    uint32_t len = tosc_writeMessage(out, sizeof(out), addr, "h",
+                                     (long long)osc_stats_counter(c));
+    stats_put(&r, out, len);
+  }
   for (int i = 0; dispatch_table[i].path_pattern; i++) {
-    if (!globmatch((char *)osc->buffer, (char *)dispatch_table[i].path_pattern))
+    osc_hist_summary s[OSC_PHASE_COUNT];
+    for (int p = 0; p < OSC_PHASE_COUNT; p++)
+      osc_stats_summary(i, p, &s[p]);
+    if (s[OSC_PHASE_MATCH].count == 0)
       continue;
-    const char *sig = dispatch_table[i].type_sig;
-    if (sig[0] && strcmp(sig, osc->format) != 0) {
-      send_error_message(conn, "format mismatch");
-      return;
+    int32_t v[OSC_PHASE_COUNT][4];
+    for (int p = 0; p < OSC_PHASE_COUNT; p++) {
+      v[p][0] = clamp_ns(s[p].p50);
+      v[p][1] = clamp_ns(s[p].p90);
+      v[p][2] = clamp_ns(s[p].p99);
+      v[p][3] = clamp_ns(s[p].max);
     }
-    dispatch_table[i].handler(osc, conn);
-    return;
+    uint32_t len = tosc_writeMessage(
+        out, sizeof(out), "/stats/handler", "shiiiiiiiiiiiiiiii",
+        dispatch_table[i].path_pattern,
+        (long long)s[OSC_PHASE_MATCH].count, v[0][0], v[0][1], v[0][2],
+        v[0][3], v[1][0], v[1][1], v[1][2], v[1][3], v[2][0], v[2][1],
+        v[2][2], v[2][3], v[3][0], v[3][1], v[3][2], v[3][3]);
+    stats_put(&r, out, len);
   }
-  send_error_message(conn, "invalid address");
+  if (r.len > 16)
+    conn->send(conn, r.buf, r.len);
+  return 0;
 }
 
-// sync_all: broadcast via existing handlers
-static int sync_all(tosc_message *msg, connectionT *conn) {
-  char local_path[128];
-  tosc_message dummy;
-
-  for (dispatch_entry *e = dispatch_table; e->path_pattern; ++e) {
-    const char *pat = e->path_pattern;
+int dispatch_push(connectionT *via) {
+  return osc_subs_push(&subscriptions, &state_image, via);
+}
 
-    // skip sync and ack themselves
-    if (strcmp(pat, "/sync") == 0 || strcmp(pat, "/ack") == 0)
-      continue;
+void dispatch_subs_stats(osc_subs_stats *st) {
+  osc_subs_get_stats(&subscriptions, st);
+}
 
-    // Expand wildcards for /input/[1-4]/...
-    if (strncmp(pat, "/input/[1-4]/", 12) == 0) {
-      for (int n = 1; n <= 4; ++n) {
-        snprintf(local_path, sizeof(local_path), "/input/%d%s", n, pat + 12);
-        dummy.buffer = local_path;
-        size_t len = strlen(local_path);
-        dummy.format = dummy.buffer + len;
-        *dummy.format = '\0';
-        dummy.marker = dummy.format;
-        e->handler(&dummy, conn);
-      }
-    }
-    // Expand wildcards for /send/[1-4]/... (non-LUT)
-    else if (strncmp(pat, "/send/[1-4]/", 12) == 0 &&
-             strstr(pat, "/lut/") == NULL) {
-      for (int n = 1; n <= 4; ++n) {
-        snprintf(local_path, sizeof(local_path), "/send/%d%s", n, pat + 11);
-        dummy.buffer = local_path;
-        size_t len = strlen(local_path);
-        dummy.format = dummy.buffer + len;
-        *dummy.format = '\0';
-        dummy.marker = dummy.format;
-        e->handler(&dummy, conn);
-      }
-    }
-    // Expand LUT channels
-    else if (strcmp(pat, "/send/[1-4]/lut/[YRGB]") == 0) {
-      const char *channels = "YRGB";
-      for (int n = 1; n <= 4; ++n) {
-        for (int i = 0; i < LUT_CHANNEL_COUNT; ++i) {
-          char ch = channels[i];
-          snprintf(local_path, sizeof(local_path), "/send/%d/lut/%c", n, ch);
-          dummy.buffer = local_path;
-          size_t len = strlen(local_path);
-          dummy.format = dummy.buffer + len;
-          *dummy.format = '\0';
-          dummy.marker = dummy.format;
-          e->handler(&dummy, conn);
-        }
-      }
-    }
-    // Expand matrix elements
-    else if (strcmp(pat, "/analog_format/color_matrix/[0-2]/[0-2]") == 0) {
-      for (int r = 0; r < 3; ++r) {
-        for (int c = 0; c < 3; ++c) {
-          snprintf(local_path, sizeof(local_path),
-                   "/analog_format/color_matrix/%d/%d", r, c);
-          dummy.buffer = local_path;
-          size_t len = strlen(local_path);
-          dummy.format = dummy.buffer + len;
-          *dummy.format = '\0';
-          dummy.marker = dummy.format;
-          e->handler(&dummy, conn);
-        }
-      }
-    }
-    // No wildcard: direct call
-    else {
-      snprintf(local_path, sizeof(local_path), "%s", pat);
-      dummy.buffer = local_path;
-      size_t len = strlen(local_path);
-      dummy.format = dummy.buffer + len;
-      *dummy.format = '\0';
-      dummy.marker = dummy.format;
-      e->handler(&dummy, conn);
-    }
-  }
+void dispatch_image_stats(osc_image_stats *st) {
+  osc_image_get_stats(&state_image, st);
+}
 
-  // final ack
-  handle_ack(msg, conn);
-  return 0;
+void dispatch_forget(const connectionT *conn) {
+  osc_subs_forget(&subscriptions, conn->con.fd);
 }
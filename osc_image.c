@@ -0,0 +1,383 @@
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "osc_image.h"
+
+#define VALUE_MAX 256 // largest field snapshot, in bytes
+
+// bytes an OSC string of n characters takes, with its NUL and padding
+static uint32_t pad_str(uint32_t n) { return (n + 4) & ~3u; }
+
+static void put32(char *p, uint32_t v) {
+  v = htonl(v);
+  memcpy(p, &v, 4);
+}
+
+static int tag_count(const osc_image_field *f) {
+  return f->type == OSC_IMAGE_FLOAT ? f->count : 1;
+}
+
+static uint32_t max_arg_len(const osc_image_field *f) {
+  switch (f->type) {
+  case OSC_IMAGE_BOOL:   return 0;
+  case OSC_IMAGE_FLOAT:  return 4 * (uint32_t)f->count;
+  case OSC_IMAGE_STRING: return pad_str((uint32_t)f->count - 1);
+  default:               return 4;
+  }
+}
+
+static size_t value_size(const osc_image_field *f) {
+  switch (f->type) {
+  case OSC_IMAGE_INT:    return sizeof(int);
+  case OSC_IMAGE_INT8:
+  case OSC_IMAGE_BOOL:   return 1;
+  case OSC_IMAGE_FLOAT:  return sizeof(float) * (size_t)f->count;
+  default:               return (size_t)f->count;
+  }
+}
+
+void osc_image_init(osc_image *img) { memset(img, 0, sizeof(*img)); }
+
+int osc_image_add(osc_image *img, const char *path, osc_image_type type,
+                  int count, const void *value, osc_seqlock *lock) {
+  if (img->field_count == OSC_IMAGE_MAX_FIELDS ||
+      strlen(path) >= OSC_IMAGE_PATH_LEN || count < 1)
+    return -1;
+  osc_image_field *f = &img->fields[img->field_count];
+  memset(f, 0, sizeof(*f));
+  strcpy(f->path, path);
+  f->type = type;
+  f->count = count;
+  f->value = value;
+  f->lock = lock;
+  if (value_size(f) > VALUE_MAX)
+    return -1;
+  return img->field_count++;
+}
+
+// changes the argument length of a string field, shifting the rest of its
+// bundle and the offsets of the fields that follow in it
+static void resize(osc_image *img, osc_image_field *f, uint32_t len) {
+  int delta = (int)len - (int)f->arg_len;
+  if (delta == 0)
+    return;
+  char *p = img->bundles[f->bundle];
+  uint32_t end = f->arg + f->arg_len;
+  memmove(p + end + delta, p + end, img->bundle_len[f->bundle] - end);
+  img->bundle_len[f->bundle] += delta;
+  f->arg_len = len;
+  put32(p + f->msg, f->arg + f->arg_len - f->msg - 4);
+
+  osc_image_field *last = img->fields + img->field_count;
+  for (osc_image_field *g = f + 1; g < last && g->bundle == f->bundle; g++) {
+    g->msg += delta;
+    g->tag += delta;
+    g->arg += delta;
+  }
+}
+
+// writes a snapshot of the field's value into its bundle; returns true if
+// any byte changed
+static bool patch(osc_image *img, osc_image_field *f, const char *v) {
+  char *p = img->bundles[f->bundle];
+  char enc[VALUE_MAX];
+  uint32_t len = max_arg_len(f);
+  switch (f->type) {
+  case OSC_IMAGE_INT: {
+    int x;
+    memcpy(&x, v, sizeof(x));
+    put32(enc, (uint32_t)x);
+    break;
+  }
+  case OSC_IMAGE_INT8:
+    put32(enc, (uint32_t)(int)v[0]);
+    break;
+  case OSC_IMAGE_BOOL: {
+    char tag = v[0] ? 'T' : 'F';
+    bool changed = p[f->tag] != tag;
+    p[f->tag] = tag;
+    return changed;
+  }
+  case OSC_IMAGE_FLOAT:
+    for (int i = 0; i < f->count; i++) {
+      uint32_t bits;
+      memcpy(&bits, v + 4 * i, 4);
+      put32(enc + 4 * i, bits);
+    }
+    break;
+  case OSC_IMAGE_STRING: {
+    uint32_t n = (uint32_t)strnlen(v, (size_t)f->count - 1);
+    len = pad_str(n);
+    memcpy(enc, v, n);
+    memset(enc + n, 0, len - n);
+    if (len != f->arg_len) {
+      resize(img, f, len);
+      p = img->bundles[f->bundle];
+      memcpy(p + f->arg, enc, len);
+      return true;
+    }
+    break;
+  }
+  }
+  if (memcmp(p + f->arg, enc, len) == 0)
+    return false;
+  memcpy(p + f->arg, enc, len);
+  return true;
+}
+
+static void snapshot(const osc_image_field *f, char *v) {
+  OSC_SEQLOCK_COPY(f->lock, v, f->value, value_size(f));
+}
+
+// takes a bundle for writing, counting the times another writer had it
+static void lock_bundle(osc_image *img, int b) {
+  osc_seqlock *l = &img->bundle_lock[b];
+  if (atomic_load_explicit(&l->seq, memory_order_relaxed) & 1)
+    atomic_fetch_add_explicit(&img->contended, 1, memory_order_relaxed);
+  osc_seqlock_write_begin(l);
+}
+
+// appends the address and type tags of a field, leaving its argument empty
+static void append_header(osc_image *img, osc_image_field *f) {
+  char *p = img->bundles[f->bundle];
+  uint32_t len = img->bundle_len[f->bundle];
+  uint32_t path_len = (uint32_t)strlen(f->path);
+  int tags = tag_count(f);
+
+  f->msg = len;
+  len += 4;
+  memset(p + len, 0, pad_str(path_len) + pad_str(1 + tags));
+  memcpy(p + len, f->path, path_len);
+  len += pad_str(path_len);
+  f->tag = len + 1;
+  p[len] = ',';
+  char tag = f->type == OSC_IMAGE_FLOAT  ? 'f'
+           : f->type == OSC_IMAGE_STRING ? 's'
+           : f->type == OSC_IMAGE_BOOL   ? 'F'
+                                         : 'i';
+  memset(p + f->tag, tag, tags);
+  len += pad_str(1 + tags);
+  f->arg = len;
+  f->arg_len = f->type == OSC_IMAGE_STRING ? 0 : max_arg_len(f);
+  img->bundle_len[f->bundle] = len + f->arg_len;
+  put32(p + f->msg, f->arg + f->arg_len - f->msg - 4);
+}
+
+int osc_image_build(osc_image *img) {
+  static const char header[16] = "#bundle\0\0\0\0\0\0\0\0\1"; // immediately
+  int ok = 0;
+  uint32_t worst = OSC_IMAGE_MTU; // bundle length with every string at max
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  for (int b = 0; b < OSC_IMAGE_MAX_BUNDLES; b++)
+    osc_seqlock_write_begin(&img->bundle_lock[b]);
+  img->base = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+  atomic_store(&img->seq, img->base);
+  img->bundle_count = 0;
+  for (int i = 0; i < img->field_count; i++) {
+    osc_image_field *f = &img->fields[i];
+    uint32_t need = 4 + pad_str((uint32_t)strlen(f->path)) +
+                    pad_str(1 + (uint32_t)tag_count(f)) + max_arg_len(f);
+    if (worst + need > OSC_IMAGE_MTU) {
+      if (img->bundle_count == OSC_IMAGE_MAX_BUNDLES ||
+          sizeof(header) + need > OSC_IMAGE_MTU) {
+        printf("ERROR: state image cannot hold %s\n", f->path);
+        ok = -1;
+        img->field_count = i;
+        break;
+      }
+      int b = img->bundle_count++;
+      memcpy(img->bundles[b], header, sizeof(header));
+      img->bundle_len[b] = sizeof(header);
+      worst = sizeof(header);
+    }
+    f->bundle = (uint16_t)(img->bundle_count - 1);
+    worst += need;
+
+    char v[VALUE_MAX];
+    append_header(img, f);
+    snapshot(f, v);
+    patch(img, f, v);
+    f->seq = img->base;
+  }
+  for (int b = 0; b < OSC_IMAGE_MAX_BUNDLES; b++)
+    osc_seqlock_write_end(&img->bundle_lock[b]);
+  return ok;
+}
+
+bool osc_image_refresh(osc_image *img, int field) {
+  if (field < 0 || field >= img->field_count)
+    return false;
+  osc_image_field *f = &img->fields[field];
+  char v[VALUE_MAX];
+
+  // snapshot under the bundle lock: refreshes of one field take turns, so
+  // the last to patch it also read the newest value.  The sequence is
+  // taken under it too, so a reader that loads img->seq and then copies
+  // the bundle sees every change up to that sequence.
+  lock_bundle(img, f->bundle);
+  snapshot(f, v);
+  bool changed = patch(img, f, v);
+  if (changed)
+    f->seq = atomic_fetch_add(&img->seq, 1) + 1;
+  osc_seqlock_write_end(&img->bundle_lock[f->bundle]);
+  return changed;
+}
+
+// per-thread copy of the bundles, so a SET never waits on a slow send
+static __thread struct {
+  int      count;
+  uint16_t len[OSC_IMAGE_MAX_BUNDLES];
+  char     data[OSC_IMAGE_MAX_BUNDLES][OSC_IMAGE_MTU];
+} sync_copy;
+
+int osc_image_send(const osc_image *img, connectionT *conn, uint64_t *seq) {
+  // the sequence first: every change up to it is in its bundle by the
+  // time that bundle is copied
+  *seq = atomic_load(&img->seq);
+  sync_copy.count = img->bundle_count;
+  for (int b = 0; b < sync_copy.count; b++) {
+    const osc_seqlock *l = &img->bundle_lock[b];
+    uint32_t s = osc_seqlock_read_begin(l);
+    for (;;) {
+      uint16_t len = img->bundle_len[b];
+      if (len > OSC_IMAGE_MTU) // torn read; the retry discards it
+        len = OSC_IMAGE_MTU;
+      sync_copy.len[b] = len;
+      memcpy(sync_copy.data[b], img->bundles[b], len);
+      if (!osc_seqlock_read_retry(l, s))
+        break;
+      atomic_fetch_add_explicit(&((osc_image *)img)->retries, 1,
+                                memory_order_relaxed);
+      s = osc_seqlock_read_begin(l);
+    }
+  }
+
+  for (int b = 0; b < sync_copy.count; b++)
+    conn->send(conn, sync_copy.data[b], sync_copy.len[b]);
+  return sync_copy.count;
+}
+
+uint32_t osc_image_copy_field(const osc_image *img, int field, char *dst,
+                              uint32_t cap) {
+  const osc_image_field *f = &img->fields[field];
+  const osc_seqlock *l = &img->bundle_lock[f->bundle];
+  uint32_t s, start, len;
+  do {
+    s = osc_seqlock_read_begin(l);
+    // a string resize moves the field, so read its offsets in the snapshot
+    start = f->msg + 4u;
+    len = f->arg + f->arg_len - start;
+    if (start > OSC_IMAGE_MTU || len > OSC_IMAGE_MTU - start || len > cap)
+      len = 0; // torn read, which the retry discards, or too long
+    memcpy(dst, img->bundles[f->bundle] + start, len);
+  } while (osc_seqlock_read_retry(l, s));
+  return len;
+}
+
+size_t osc_image_send_field(const osc_image *img, int field,
+                            connectionT *conn) {
+  char out[OSC_IMAGE_MTU];
+  uint32_t len = osc_image_copy_field(img, field, out, sizeof(out));
+  return conn->send(conn, out, len);
+}
+
+int osc_image_changed_since(const osc_image *img, uint64_t since,
+                            uint64_t *fields, uint64_t *seq) {
+  // as in osc_image_send, a field changed up to *seq has its sequence
+  // stored by the time its bundle is read
+  *seq = atomic_load(&img->seq);
+  if (since < img->base || since > *seq)
+    return -1;
+  int n = 0;
+  memset(fields, 0, OSC_IMAGE_WORDS * sizeof(uint64_t));
+  for (int i = 0; i < img->field_count;) {
+    int b = img->fields[i].bundle, first = i, count;
+    const osc_seqlock *l = &img->bundle_lock[b];
+    uint32_t s;
+    do {
+      s = osc_seqlock_read_begin(l);
+      count = 0;
+      for (i = first; i < img->field_count && img->fields[i].bundle == b;
+           i++) {
+        uint64_t bit = 1ull << (i & 63);
+        if (img->fields[i].seq > since) {
+          fields[i >> 6] |= bit;
+          count++;
+        } else {
+          fields[i >> 6] &= ~bit;
+        }
+      }
+    } while (osc_seqlock_read_retry(l, s));
+    n += count;
+  }
+  return n;
+}
+
+// starts a bundle of immediate messages
+static uint32_t bundle_begin(char *buf) {
+  static const char header[16] = "#bundle\0\0\0\0\0\0\0\0\1";
+  memcpy(buf, header, sizeof(header));
+  return sizeof(header);
+}
+
+// copies a field's message after its element size at buf + len; returns
+// the message length, or 0 if it does not fit the datagram
+static uint32_t append_field(const osc_image *img, int field, char *buf,
+                             uint32_t len) {
+  if (len + 4 >= OSC_IMAGE_MTU)
+    return 0;
+  uint32_t n = osc_image_copy_field(img, field, buf + len + 4,
+                                    OSC_IMAGE_MTU - len - 4);
+  put32(buf + len, n);
+  return n;
+}
+
+int osc_image_send_fields(const osc_image *img, const uint64_t *fields,
+                          connectionT *conn, int *messages) {
+  char buf[OSC_IMAGE_MTU];
+  uint32_t len = 0;
+  int packets = 0, sent = 0;
+  for (int w = 0; w < OSC_IMAGE_WORDS; w++) {
+    for (uint64_t bits = fields[w]; bits; bits &= bits - 1) {
+      int field = w * 64 + __builtin_ctzll(bits);
+      if (field >= img->field_count)
+        break;
+      if (len == 0)
+        len = bundle_begin(buf);
+      uint32_t n = append_field(img, field, buf, len);
+      if (n == 0 && len > 16) { // full: send and start the next bundle
+        conn->send(conn, buf, len);
+        packets++;
+        len = bundle_begin(buf);
+        n = append_field(img, field, buf, len);
+      }
+      if (n == 0)
+        continue;
+      len += 4 + n;
+      sent++;
+    }
+  }
+  if (len > 16) {
+    conn->send(conn, buf, len);
+    packets++;
+  }
+  if (messages)
+    *messages = sent;
+  return packets;
+}
+
+void osc_image_get_stats(const osc_image *img, osc_image_stats *st) {
+  st->contended = atomic_load(&img->contended);
+  st->retries = atomic_load(&img->retries);
+}
+
+void osc_image_print_stats(const osc_image_stats *st) {
+  printf("state image: %llu refreshes waited on another writer, "
+         "%llu /sync bundle copies retried\n",
+         (unsigned long long)st->contended, (unsigned long long)st->retries);
+}
@@ -0,0 +1,120 @@
+#ifndef __OSC_IMAGE_H__
+#define __OSC_IMAGE_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "network.h"
+#include "osc_seqlock.h"
+
+/*
+ * Pre-encoded OSC image of the whole state, for /sync.
+ *
+ * Every field is kept as a ready OSC message, packed in order into
+ * #bundles that each fit one datagram.  A SET refreshes only its own
+ * field: numbers and booleans are patched in place, a string that changes
+ * length shifts the rest of its bundle.  Bundles are laid out as if every
+ * string were at its longest, so a field never moves to another bundle.
+ * Each bundle has its own seqlock, so SETs of fields in different bundles
+ * never wait on each other.  A /sync copies the bundles out, each under
+ * its lock, and sends them; a GET copies out the one message of its field.
+ *
+ * Every change that alters a field's bytes stamps it with the next
+ * sequence number, so a peer can ask for what changed since the sequence
+ * it last saw.  Sequences start at the boot time in realtime nanoseconds,
+ * so a sequence from an earlier run is older than every field.
+ */
+
+#define OSC_IMAGE_MTU          1452 // 1500-byte MTU less IPv6 and UDP headers
+#define OSC_IMAGE_MAX_BUNDLES  16
+#define OSC_IMAGE_MAX_FIELDS   256
+#define OSC_IMAGE_PATH_LEN     48
+#define OSC_IMAGE_WORDS        (OSC_IMAGE_MAX_FIELDS / 64) // field bitmaps
+
+typedef enum {
+  OSC_IMAGE_INT,    // int, sent as 'i'
+  OSC_IMAGE_INT8,   // char, sent as 'i'
+  OSC_IMAGE_BOOL,   // char, sent as 'T' or 'F'
+  OSC_IMAGE_FLOAT,  // count floats, sent as 'f' each
+  OSC_IMAGE_STRING, // char[count], sent as 's'
+} osc_image_type;
+
+typedef struct osc_image_field {
+  char            path[OSC_IMAGE_PATH_LEN];
+  osc_image_type  type;
+  int             count;  // floats, or the string buffer size
+  const void     *value;  // where the field lives in config
+  osc_seqlock    *lock;   // guards value
+  uint16_t        bundle;
+  uint16_t        msg;     // offset of the element size in the bundle
+  uint16_t        tag;     // offset of the first type tag
+  uint16_t        arg;     // offset of the first argument
+  uint16_t        arg_len; // encoded argument bytes
+  uint64_t        seq;     // sequence of the last change
+} osc_image_field;
+
+typedef struct osc_image_stats {
+  uint64_t contended; // refreshes that waited on another writer's bundle
+  uint64_t retries;   // /sync bundle copies a writer tore
+} osc_image_stats;
+
+typedef struct osc_image {
+  uint64_t         base; // sequence at build
+  _Atomic uint64_t seq;  // sequence of the latest change
+  int              field_count;
+  osc_image_field  fields[OSC_IMAGE_MAX_FIELDS];
+  int              bundle_count;
+  // guards a bundle, its length, and the offsets and sequences of its
+  // fields
+  osc_seqlock      bundle_lock[OSC_IMAGE_MAX_BUNDLES];
+  uint16_t         bundle_len[OSC_IMAGE_MAX_BUNDLES];
+  char             bundles[OSC_IMAGE_MAX_BUNDLES][OSC_IMAGE_MTU];
+  _Atomic uint64_t contended;
+  _Atomic uint64_t retries;
+} osc_image;
+
+void osc_image_init(osc_image *img);
+
+/* Registers a field; returns its id or -1 if the image is full. */
+int osc_image_add(osc_image *img, const char *path, osc_image_type type,
+                  int count, const void *value, osc_seqlock *lock);
+
+/* Lays out and encodes every field. Returns 0, or -1 if they do not fit. */
+int osc_image_build(osc_image *img);
+
+/* Re-encodes one field from its current value. Returns true if that
+ * changed its bytes, and so its sequence. */
+bool osc_image_refresh(osc_image *img, int field);
+
+/* Sends every bundle to conn; returns the number of datagrams. Stores the
+ * sequence the bundles are current to in *seq; they may also hold changes
+ * after it. */
+int osc_image_send(const osc_image *img, connectionT *conn, uint64_t *seq);
+
+/*
+ * Sets the bits of the fields changed after since, and stores the current
+ * sequence in *seq. Returns how many changed, or -1 if since is not a
+ * sequence of this image (from an earlier run, or ahead of it).
+ */
+int osc_image_changed_since(const osc_image *img, uint64_t since,
+                            uint64_t *fields, uint64_t *seq);
+
+/* Sends the fields whose bits are set, packed into bundles; returns the
+ * number of datagrams and, in *messages if not NULL, of fields sent. */
+int osc_image_send_fields(const osc_image *img, const uint64_t *fields,
+                          connectionT *conn, int *messages);
+
+/* Copies one field's message into dst; returns its length, or 0 if it is
+ * longer than cap. */
+uint32_t osc_image_copy_field(const osc_image *img, int field, char *dst,
+                              uint32_t cap);
+
+/* Sends one field's message, as the reply to a GET. Returns its length. */
+size_t osc_image_send_field(const osc_image *img, int field,
+                            connectionT *conn);
+
+void osc_image_get_stats(const osc_image *img, osc_image_stats *st);
+void osc_image_print_stats(const osc_image_stats *st);
+
+#endif
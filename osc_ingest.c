@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "osc_ingest.h"
+#include "osc_stats.h"
+
+void osc_ingest_init(osc_ingest *g) {
+  memset(g, 0, sizeof(*g));
+  g->run = 1;
+}
+
+// no SET before a new run collapses into one after it
+static void next_run(osc_ingest *g) {
+  if (++g->run == 0) {
+    memset(g->seen, 0, sizeof(g->seen));
+    g->run = 1;
+  }
+}
+
+int osc_ingest_scan(osc_ingest *g, osc_rx_ring *r, int n, osc_ingest_key key) {
+  memset(g->kind, OSC_INGEST_OTHER, (size_t)n);
+  if (n < 2)
+    return 0; // nothing to collapse into; parsed where it is dispatched
+  g->stats.batches++;
+
+  // newest first: the first SET of a field seen in a run is the one kept.
+  // Each clock read ends one phase and starts the next, as in
+  // dispatch_bundle.
+  int collapsed = 0;
+  next_run(g);
+  uint64_t t0 = osc_stats_now();
+  for (int i = n - 1; i >= 0; i--) {
+    int len = (int)r->hdr[i].msg_len;
+    if (len == 0)
+      continue;
+    char *buf = r->buf[i];
+    if (len >= 16 && tosc_isBundle(buf)) {
+      g->stats.barriers++;
+      next_run(g);
+      continue;
+    }
+    tosc_message *m = &g->msg[i];
+    if (tosc_parseMessageChecked(m, buf, len) != 0) {
+      t0 = osc_stats_now();
+      continue; // changes nothing; dropped where it is dispatched
+    }
+    uint64_t t1 = osc_stats_now();
+    int f = m->format[0] ? key(m) : -1; // a GET reads the field
+    uint64_t t2 = m->format[0] ? osc_stats_now() : t1;
+    uint64_t parse = t1 - t0;
+    t0 = t2;
+    if (f < 0 || f >= OSC_IMAGE_MAX_FIELDS) {
+      g->stats.barriers++;
+      next_run(g);
+      continue;
+    }
+    g->stats.sets++;
+    g->field[i] = (int16_t)f;
+    g->parse_ticks[i] = parse;
+    g->match_ticks[i] = t2 - t1;
+    if (g->seen[f] == g->run) {
+      g->kind[i] = OSC_INGEST_SUPERSEDED;
+      collapsed++;
+    } else {
+      g->seen[f] = g->run;
+      g->kind[i] = OSC_INGEST_SET;
+    }
+  }
+  g->stats.collapsed += (uint64_t)collapsed;
+  return collapsed;
+}
+
+void osc_ingest_print_stats(const osc_ingest_stats *st) {
+  printf("ingest: %llu batches scanned, %llu of %llu SETs collapsed, "
+         "%llu barriers\n",
+         (unsigned long long)st->batches, (unsigned long long)st->collapsed,
+         (unsigned long long)st->sets, (unsigned long long)st->barriers);
+}
@@ -0,0 +1,65 @@
+#ifndef __OSC_INGEST_H__
+#define __OSC_INGEST_H__
+
+#include <stdint.h>
+
+#include "osc_image.h"
+#include "osc_io.h"
+#include "tinyosc.h"
+
+/*
+ * Last-writer-wins over a receive batch.  Before the datagrams one
+ * recvmmsg returned are dispatched, each plain message is parsed once and
+ * every SET of a parameter is keyed by the state image field it writes.
+ * A SET followed later in the batch by another SET of the same field is
+ * superseded: the later one overwrites all of it, so it is never applied.
+ * During a fader sweep that leaves one handler call per field and batch.
+ *
+ * Anything that may read state or is ordered by a timetag is a barrier: a
+ * bundle, a GET, a command or an address pattern.  A SET only collapses
+ * into a later one with no barrier between them, so every reply, bundle
+ * and scheduled bundle sees the batch as if each write had been applied
+ * in order.
+ *
+ * Belongs to one worker thread.
+ */
+
+// the state image field msg is a plain SET of, or -1 if it is anything
+// else
+typedef int (*osc_ingest_key)(tosc_message *msg);
+
+typedef enum osc_ingest_kind {
+  OSC_INGEST_OTHER,      // dispatched as received
+  OSC_INGEST_SET,        // a SET of field[i], parsed into msg[i]
+  OSC_INGEST_SUPERSEDED, // a SET a later one in the batch overwrites
+} osc_ingest_kind;
+
+typedef struct osc_ingest_stats {
+  uint64_t batches;   // scanned, of more than one datagram
+  uint64_t sets;      // SETs keyed to a field
+  uint64_t collapsed; // superseded and never applied
+  uint64_t barriers;
+} osc_ingest_stats;
+
+typedef struct osc_ingest {
+  uint8_t          kind[OSC_IO_BATCH];
+  int16_t          field[OSC_IO_BATCH];
+  tosc_message     msg[OSC_IO_BATCH];
+  uint64_t         parse_ticks[OSC_IO_BATCH]; // of a SET, for osc_stats
+  uint64_t         match_ticks[OSC_IO_BATCH];
+  uint32_t         seen[OSC_IMAGE_MAX_FIELDS]; // run a field was last set in
+  uint32_t         run; // a barrier starts the next one
+  osc_ingest_stats stats;
+} osc_ingest;
+
+void osc_ingest_init(osc_ingest *g);
+
+/*
+ * Classifies the first n datagrams of r into g->kind, last to first.
+ * Returns how many are superseded.
+ */
+int osc_ingest_scan(osc_ingest *g, osc_rx_ring *r, int n, osc_ingest_key key);
+
+void osc_ingest_print_stats(const osc_ingest_stats *st);
+
+#endif
@@ -0,0 +1,104 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "osc_io.h"
+
+void osc_rx_ring_init(osc_rx_ring *r) {
+  memset(r, 0, sizeof(*r));
+  for (int i = 0; i < OSC_IO_BATCH; i++) {
+    r->iov[i].iov_base = r->buf[i];
+    r->iov[i].iov_len = OSC_IO_SLOT_SIZE;
+    r->hdr[i].msg_hdr.msg_iov = &r->iov[i];
+    r->hdr[i].msg_hdr.msg_iovlen = 1;
+    r->hdr[i].msg_hdr.msg_name = &r->addr[i];
+  }
+}
+
+int osc_io_recv_batch(int fd, osc_rx_ring *r, osc_io_stats *stats) {
+  // recvmmsg overwrites msg_namelen with the actual address length
+  for (int i = 0; i < OSC_IO_BATCH; i++)
+    r->hdr[i].msg_hdr.msg_namelen = sizeof(r->addr[i]);
+
+  int n;
+  do {
+    n = recvmmsg(fd, r->hdr, OSC_IO_BATCH, MSG_DONTWAIT, NULL);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    perror("recvmmsg");
+    return -1;
+  }
+
+  stats->rx_calls++;
+  stats->rx_packets += n;
+  return n;
+}
+
+size_t osc_io_queue(int fd, osc_tx_queue *q, const struct sockaddr *addr,
+                    socklen_t addr_len, const void *buf, size_t len,
+                    osc_io_stats *stats) {
+  if (len > OSC_IO_SLOT_SIZE || addr_len > sizeof(q->addr[0]))
+    return 0;
+  if (q->count == OSC_IO_BATCH || (q->count && q->fd != fd))
+    osc_io_flush(q, stats);
+
+  q->fd = fd;
+  int i = q->count++;
+  memcpy(q->buf[i], buf, len);
+  memcpy(&q->addr[i], addr, addr_len);
+  q->iov[i].iov_base = q->buf[i];
+  q->iov[i].iov_len = len;
+  memset(&q->hdr[i], 0, sizeof(q->hdr[i]));
+  q->hdr[i].msg_hdr.msg_iov = &q->iov[i];
+  q->hdr[i].msg_hdr.msg_iovlen = 1;
+  q->hdr[i].msg_hdr.msg_name = &q->addr[i];
+  q->hdr[i].msg_hdr.msg_namelen = addr_len;
+  return len;
+}
+
+int osc_io_flush(osc_tx_queue *q, osc_io_stats *stats) {
+  int done = 0;
+  while (done < q->count) {
+    int n = sendmmsg(q->fd, q->hdr + done, q->count - done, MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        perror("sendmmsg");
+      break;
+    }
+    stats->tx_calls++;
+    stats->tx_packets += n;
+    done += n;
+  }
+  // the socket is full: the rest are not waited for
+  for (int i = done; i < q->count; i++) {
+    if (q->overflow)
+      q->overflow(q->overflow_ctx, q->fd, (struct sockaddr *)&q->addr[i],
+                  q->hdr[i].msg_hdr.msg_namelen, q->buf[i], q->iov[i].iov_len);
+    else
+      stats->tx_dropped++;
+  }
+  q->count = 0;
+  return done;
+}
+
+void osc_io_print_stats(const osc_io_stats *stats) {
+  printf("rx: %llu packets in %llu calls (%.2f/call)\n",
+         (unsigned long long)stats->rx_packets,
+         (unsigned long long)stats->rx_calls,
+         stats->rx_calls ? (double)stats->rx_packets / stats->rx_calls : 0.0);
+  if (stats->rx_malformed)
+    printf("rx: %llu malformed packets dropped\n",
+           (unsigned long long)stats->rx_malformed);
+  printf("tx: %llu packets in %llu calls (%.2f/call)\n",
+         (unsigned long long)stats->tx_packets,
+         (unsigned long long)stats->tx_calls,
+         stats->tx_calls ? (double)stats->tx_packets / stats->tx_calls : 0.0);
+  if (stats->tx_dropped)
+    printf("tx: %llu packets dropped, the socket was full\n",
+           (unsigned long long)stats->tx_dropped);
+}
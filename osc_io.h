@@ -0,0 +1,73 @@
+#ifndef __OSC_IO_H__
+#define __OSC_IO_H__
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/*
+ * Batched datagram I/O: a ring of receive slots filled by one recvmmsg,
+ * and a reply queue flushed with one sendmmsg.  Needs _GNU_SOURCE, which
+ * the Makefile defines for every translation unit.
+ */
+
+#define OSC_IO_BATCH      32
+#define OSC_IO_SLOT_SIZE  2048
+
+typedef struct osc_io_stats {
+  uint64_t rx_packets;
+  uint64_t rx_calls;
+  uint64_t rx_malformed; // dropped by the parser
+  uint64_t tx_packets;
+  uint64_t tx_calls;
+  uint64_t tx_dropped; // refused by a full socket with no overflow
+} osc_io_stats;
+
+typedef struct osc_rx_ring {
+  struct mmsghdr          hdr[OSC_IO_BATCH];
+  struct iovec            iov[OSC_IO_BATCH];
+  struct sockaddr_storage addr[OSC_IO_BATCH];
+  char                    buf[OSC_IO_BATCH][OSC_IO_SLOT_SIZE];
+} osc_rx_ring;
+
+// takes a reply the socket would not, instead of waiting for it
+typedef void (*osc_io_overflow)(void *ctx, int fd, const struct sockaddr *addr,
+                                socklen_t addr_len, const void *buf,
+                                size_t len);
+
+typedef struct osc_tx_queue {
+  struct mmsghdr          hdr[OSC_IO_BATCH];
+  struct iovec            iov[OSC_IO_BATCH];
+  struct sockaddr_storage addr[OSC_IO_BATCH];
+  char                    buf[OSC_IO_BATCH][OSC_IO_SLOT_SIZE];
+  int                     count;
+  int                     fd; // socket the queued replies go out on
+  osc_io_overflow         overflow; // NULL drops what the socket refuses
+  void                   *overflow_ctx;
+} osc_tx_queue;
+
+void osc_rx_ring_init(osc_rx_ring *r);
+
+/*
+ * Fills as many slots as are ready without blocking. Returns the number of
+ * datagrams received (slot i has hdr[i].msg_len bytes from addr[i]), 0 if
+ * the socket is drained, or -1 on error.
+ */
+int osc_io_recv_batch(int fd, osc_rx_ring *r, osc_io_stats *stats);
+
+/*
+ * Copies a reply into the queue, flushing first if the queue is full or
+ * holds replies for another socket. Returns len, or 0 if the datagram does
+ * not fit a slot.
+ */
+size_t osc_io_queue(int fd, osc_tx_queue *q, const struct sockaddr *addr,
+                    socklen_t addr_len, const void *buf, size_t len,
+                    osc_io_stats *stats);
+
+/* Sends every queued reply the socket takes without blocking and hands
+ * the rest to q->overflow. Returns the number sent. */
+int osc_io_flush(osc_tx_queue *q, osc_io_stats *stats);
+
+void osc_io_print_stats(const osc_io_stats *stats);
+
+#endif
@@ -0,0 +1,118 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "osc_listen.h"
+
+// copy src into dst, failing rather than truncating
+static int copy_part(char *dst, size_t dst_len, const char *src) {
+  size_t n = strlen(src);
+  if (n >= dst_len)
+    return -1;
+  memcpy(dst, src, n + 1);
+  return 0;
+}
+
+// split "[host:]port[@iface]" into its parts; host is "" when absent
+static int parse_spec(const char *spec, char *host, size_t host_len,
+                      char *port, size_t port_len, char *iface,
+                      size_t iface_len) {
+  char tmp[128];
+  if (copy_part(tmp, sizeof(tmp), spec) < 0)
+    return -1;
+
+  iface[0] = '\0';
+  char *at = strrchr(tmp, '@');
+  if (at) {
+    *at = '\0';
+    if (copy_part(iface, iface_len, at + 1) < 0)
+      return -1;
+  }
+
+  host[0] = '\0';
+  char *p = tmp;
+  if (*p == '[') {
+    char *close = strchr(p, ']');
+    if (!close || close[1] != ':')
+      return -1;
+    *close = '\0';
+    if (copy_part(host, host_len, p + 1) < 0)
+      return -1;
+    p = close + 2;
+  } else {
+    char *colon = strrchr(p, ':');
+    if (colon) {
+      *colon = '\0';
+      if (copy_part(host, host_len, p) < 0)
+        return -1;
+      p = colon + 1;
+    }
+  }
+
+  if (*p == '\0')
+    return -1;
+  return copy_part(port, port_len, p);
+}
+
+int osc_listen_open(const char *spec, int type, int flags) {
+  char host[64], port[16], iface[32];
+  if (parse_spec(spec, host, sizeof(host), port, sizeof(port), iface,
+                 sizeof(iface)) < 0) {
+    fprintf(stderr, "invalid listen address '%s'\n", spec);
+    return -1;
+  }
+
+  struct addrinfo hints = {0}, *res = NULL;
+  hints.ai_family = host[0] ? AF_UNSPEC : AF_INET;
+  hints.ai_socktype = type;
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+  int err = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+  if (err != 0) {
+    fprintf(stderr, "%s: %s\n", spec, gai_strerror(err));
+    return -1;
+  }
+
+  int fd = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK, 0);
+  if (fd < 0) {
+    perror("socket");
+    freeaddrinfo(res);
+    return -1;
+  }
+
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if ((flags & OSC_LISTEN_REUSEPORT) &&
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+    perror("SO_REUSEPORT");
+    goto fail;
+  }
+  if (res->ai_family == AF_INET6)
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &one, sizeof(one));
+  if (iface[0] && setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, iface,
+                             strlen(iface) + 1) < 0) {
+    perror("SO_BINDTODEVICE");
+    goto fail;
+  }
+
+  if (bind(fd, res->ai_addr, res->ai_addrlen) < 0) {
+    fprintf(stderr, "bind %s: %s\n", spec, strerror(errno));
+    goto fail;
+  }
+  if (type == SOCK_STREAM && listen(fd, 16) < 0) {
+    perror("listen");
+    goto fail;
+  }
+
+  freeaddrinfo(res);
+  return fd;
+
+fail:
+  close(fd);
+  freeaddrinfo(res);
+  return -1;
+}
@@ -0,0 +1,23 @@
+#ifndef __OSC_LISTEN_H__
+#define __OSC_LISTEN_H__
+
+#define OSC_LISTEN_MAX        8
+#define OSC_LISTEN_DEFAULT    "9000"
+
+/* osc_listen_open flags */
+#define OSC_LISTEN_REUSEPORT  0x1 // share the address between workers
+
+/*
+ * Opens a non-blocking socket of the given type (SOCK_DGRAM, SOCK_STREAM)
+ * bound as described by spec:
+ *
+ *   port               all IPv4 interfaces, e.g. "9000"
+ *   host:port          IPv4 address or name, e.g. "127.0.0.1:9000"
+ *   [addr]:port        IPv6 address, e.g. "[::]:9000" (IPV6_V6ONLY is set)
+ *   ...@iface          restrict to a device, e.g. "9000@eth0"
+ *
+ * Returns the fd, or -1 after printing the reason.
+ */
+int osc_listen_open(const char *spec, int type, int flags);
+
+#endif
@@ -0,0 +1,209 @@
+#include <string.h>
+
+#if __AVX2__
+#include <immintrin.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "osc_lut.h"
+
+// the used control points of a LUT, sorted by x, with their slopes
+typedef struct curve {
+  int    n;
+  double x[LUT_CONTROL_POINT_COUNT];
+  double y[LUT_CONTROL_POINT_COUNT];
+  double m[LUT_CONTROL_POINT_COUNT];
+} curve;
+
+static bool unused(const LutControlPoint *p) {
+  return p->x == -1.0f && p->y == -1.0f;
+}
+
+// sorts the used points into c; of two points at the same x the later
+// one wins
+static void collect(curve *c, const ConfigSendLut *src) {
+  c->n = 0;
+  for (int i = 0; i < LUT_CONTROL_POINT_COUNT; i++) {
+    const LutControlPoint *p = &src->points[i];
+    if (unused(p) || p->x != p->x || p->y != p->y)
+      continue;
+    int k = c->n;
+    while (k > 0 && c->x[k - 1] > p->x)
+      k--;
+    if (k > 0 && c->x[k - 1] == p->x) {
+      c->y[k - 1] = p->y;
+      continue;
+    }
+    memmove(c->x + k + 1, c->x + k, (c->n - k) * sizeof(double));
+    memmove(c->y + k + 1, c->y + k, (c->n - k) * sizeof(double));
+    c->x[k] = p->x;
+    c->y[k] = p->y;
+    c->n++;
+  }
+}
+
+// Fritsch-Butland slopes: zero where the curve turns, elsewhere a weighted
+// harmonic mean of the neighbouring secants, which keeps each segment
+// within its end values
+static void slopes(curve *c) {
+  int n = c->n;
+  double d[LUT_CONTROL_POINT_COUNT];
+  for (int k = 0; k + 1 < n; k++)
+    d[k] = (c->y[k + 1] - c->y[k]) / (c->x[k + 1] - c->x[k]);
+  if (n < 2)
+    return;
+  c->m[0] = d[0];
+  c->m[n - 1] = d[n - 2];
+  for (int k = 1; k + 1 < n; k++) {
+    if (d[k - 1] * d[k] <= 0.0) {
+      c->m[k] = 0.0;
+      continue;
+    }
+    double h0 = c->x[k] - c->x[k - 1], h1 = c->x[k + 1] - c->x[k];
+    c->m[k] = 3.0 * (h0 + h1) /
+              ((2.0 * h1 + h0) / d[k - 1] + (h1 + 2.0 * h0) / d[k]);
+  }
+}
+
+static void prepare(curve *c, const ConfigSendLut *src,
+                    osc_lut_interp interp) {
+  collect(c, src);
+  if (interp == OSC_LUT_CUBIC)
+    slopes(c);
+}
+
+// the curve at x; *seg caches the segment of the last call, since the
+// compiler walks x upwards
+static double eval(const curve *c, osc_lut_interp interp, double x,
+                   int *seg) {
+  int n = c->n;
+  if (n == 0)
+    return x;
+  if (x <= c->x[0])
+    return c->y[0];
+  if (x >= c->x[n - 1])
+    return c->y[n - 1];
+
+  int k = *seg;
+  if (k > n - 2 || c->x[k] > x)
+    k = 0;
+  while (c->x[k + 1] < x)
+    k++;
+  *seg = k;
+
+  double h = c->x[k + 1] - c->x[k];
+  double t = (x - c->x[k]) / h;
+  if (interp == OSC_LUT_LINEAR)
+    return c->y[k] + t * (c->y[k + 1] - c->y[k]);
+  double t2 = t * t, t3 = t2 * t;
+  return (2.0 * t3 - 3.0 * t2 + 1.0) * c->y[k] +
+         (t3 - 2.0 * t2 + t) * h * c->m[k] +
+         (-2.0 * t3 + 3.0 * t2) * c->y[k + 1] +
+         (t3 - t2) * h * c->m[k + 1];
+}
+
+float osc_lut_curve(const ConfigSendLut *src, osc_lut_interp interp,
+                    float x) {
+  curve c;
+  int seg = 0;
+  prepare(&c, src, interp);
+  return (float)eval(&c, interp, x, &seg);
+}
+
+int osc_lut_compile(osc_lut *lut, const ConfigSendLut *src,
+                    osc_lut_interp interp) {
+  curve c;
+  int seg = 0;
+  prepare(&c, src, interp);
+
+  for (int i = 0; i < OSC_LUT_SIZE; i++)
+    lut->f[i] = (float)eval(&c, interp, (double)i / (OSC_LUT_SIZE - 1),
+                            &seg);
+  lut->f[OSC_LUT_SIZE] = lut->f[OSC_LUT_SIZE - 1];
+
+  seg = 0;
+  for (int i = 0; i < OSC_LUT_CODES; i++) {
+    double v = eval(&c, interp, (double)i / (OSC_LUT_CODES - 1), &seg);
+    v = v * (OSC_LUT_CODES - 1) + 0.5;
+    lut->u10[i] = v <= 0.0                 ? 0
+                : v >= OSC_LUT_CODES - 1.0 ? OSC_LUT_CODES - 1
+                                           : (uint16_t)v;
+  }
+  lut->u10[OSC_LUT_CODES] = lut->u10[OSC_LUT_CODES + 1] =
+      lut->u10[OSC_LUT_CODES - 1];
+  return c.n;
+}
+
+// the kernels compute exactly what osc_lut_eval does, lane by lane:
+// clamp, scale, truncate, then a + t * (b - a)
+void osc_lut_apply(const osc_lut *lut, const float *in, float *out,
+                   size_t n) {
+  size_t i = 0;
+#if __AVX2__
+  const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(1.0f);
+  const __m256 scale = _mm256_set1_ps((float)(OSC_LUT_SIZE - 1));
+  for (; i + 8 <= n; i += 8) {
+    // max(x, 0) yields 0 for NaN, as the scalar clamp does
+    __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i), lo), hi);
+    __m256 p = _mm256_mul_ps(x, scale);
+    __m256i k = _mm256_cvttps_epi32(p);
+    __m256 t = _mm256_sub_ps(p, _mm256_cvtepi32_ps(k));
+    __m256 a = _mm256_i32gather_ps(lut->f, k, 4);
+    __m256 b = _mm256_i32gather_ps(lut->f + 1, k, 4);
+    _mm256_storeu_ps(out + i,
+                     _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a))));
+  }
+#elif __SSE2__
+  const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps((float)(OSC_LUT_SIZE - 1));
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lo), hi);
+    __m128 p = _mm_mul_ps(x, scale);
+    __m128i ki = _mm_cvttps_epi32(p);
+    __m128 t = _mm_sub_ps(p, _mm_cvtepi32_ps(ki));
+    int32_t k[4];
+    _mm_storeu_si128((__m128i *)k, ki);
+    const float *f = lut->f;
+    __m128 a = _mm_setr_ps(f[k[0]], f[k[1]], f[k[2]], f[k[3]]);
+    __m128 b = _mm_setr_ps(f[k[0] + 1], f[k[1] + 1], f[k[2] + 1],
+                           f[k[3] + 1]);
+    _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a))));
+  }
+#endif
+  for (; i < n; i++)
+    out[i] = osc_lut_eval(lut, in[i]);
+}
+
+void osc_lut_apply_u10(const osc_lut *lut, const uint16_t *in,
+                       uint16_t *out, size_t n) {
+  size_t i = 0;
+#if __AVX2__
+  // gather 32 bits at each code and keep the low half; u10 is padded so
+  // code 1023 can read one past
+  const __m256i max = _mm256_set1_epi16(OSC_LUT_CODES - 1);
+  const __m256i low = _mm256_set1_epi32(0xffff);
+  const int *table = (const int *)lut->u10;
+  for (; i + 16 <= n; i += 16) {
+    __m256i c = _mm256_min_epu16(
+        _mm256_loadu_si256((const __m256i *)(in + i)), max);
+    __m256i c0 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(c));
+    __m256i c1 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(c, 1));
+    __m256i v0 = _mm256_and_si256(_mm256_i32gather_epi32(table, c0, 2), low);
+    __m256i v1 = _mm256_and_si256(_mm256_i32gather_epi32(table, c1, 2), low);
+    __m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1),
+                                         _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i *)(out + i), v);
+  }
+#endif
+  // without a gather a plain load per code is as fast as it gets
+  for (; i + 4 <= n; i += 4) {
+    uint16_t c0 = in[i], c1 = in[i + 1], c2 = in[i + 2], c3 = in[i + 3];
+    out[i]     = lut->u10[c0 < OSC_LUT_CODES ? c0 : OSC_LUT_CODES - 1];
+    out[i + 1] = lut->u10[c1 < OSC_LUT_CODES ? c1 : OSC_LUT_CODES - 1];
+    out[i + 2] = lut->u10[c2 < OSC_LUT_CODES ? c2 : OSC_LUT_CODES - 1];
+    out[i + 3] = lut->u10[c3 < OSC_LUT_CODES ? c3 : OSC_LUT_CODES - 1];
+  }
+  for (; i < n; i++)
+    out[i] = lut->u10[in[i] < OSC_LUT_CODES ? in[i] : OSC_LUT_CODES - 1];
+}
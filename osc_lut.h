@@ -0,0 +1,72 @@
+#ifndef __OSC_LUT_H__
+#define __OSC_LUT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "osc_config.h"
+
+/*
+ * Dense 1-D LUTs compiled from the control points of a ConfigSendLut.
+ *
+ * Points equal to the (-1,-1) sentinel are unused; the rest are sorted by
+ * x and joined by a monotone cubic (Fritsch-Butland slopes, so the curve
+ * never overshoots between points) or by straight lines.  Outside the
+ * first and last point the curve holds their y.  No points compiles the
+ * identity, one point a constant.
+ *
+ * The float table samples the curve at OSC_LUT_SIZE even steps over
+ * [0, 1] and is read with linear interpolation; the 10-bit table maps
+ * each code 0..1023 straight to its output code.
+ */
+
+#ifndef OSC_LUT_SIZE
+#define OSC_LUT_SIZE 1024 // float table entries; 4096 for finer curves
+#endif
+
+_Static_assert(OSC_LUT_SIZE >= 2, "OSC_LUT_SIZE must be at least 2");
+
+#define OSC_LUT_CODES 1024 // 10-bit samples
+
+typedef enum {
+  OSC_LUT_LINEAR,
+  OSC_LUT_CUBIC, // monotone
+} osc_lut_interp;
+
+typedef struct osc_lut {
+  // f[i] = curve(i / (OSC_LUT_SIZE - 1)); the last entry repeats so the
+  // interpolation at x = 1 can read one past
+  float    f[OSC_LUT_SIZE + 1];
+  // u10[c] = curve(c / 1023) * 1023, rounded; padded for 32-bit gathers
+  uint16_t u10[OSC_LUT_CODES + 2];
+} osc_lut;
+
+/* Compiles the points of src. Returns how many control points it used. */
+int osc_lut_compile(osc_lut *lut, const ConfigSendLut *src,
+                    osc_lut_interp interp);
+
+/* The curve itself at x, straight from the points; the reference the
+ * tables approximate. */
+float osc_lut_curve(const ConfigSendLut *src, osc_lut_interp interp,
+                    float x);
+
+/* One sample through the float table, clamped to [0, 1] (NaN reads as 0);
+ * what osc_lut_apply computes for each sample. */
+static inline float osc_lut_eval(const osc_lut *lut, float x) {
+  x = x > 0.0f ? x : 0.0f;
+  x = x < 1.0f ? x : 1.0f;
+  float p = x * (float)(OSC_LUT_SIZE - 1);
+  int k = (int)p;
+  float t = p - (float)k;
+  return lut->f[k] + t * (lut->f[k + 1] - lut->f[k]);
+}
+
+/* Applies the float table to n samples; in and out may be the same. */
+void osc_lut_apply(const osc_lut *lut, const float *in, float *out,
+                   size_t n);
+
+/* Applies the 10-bit table to n codes; codes above 1023 read as 1023. */
+void osc_lut_apply_u10(const osc_lut *lut, const uint16_t *in,
+                       uint16_t *out, size_t n);
+
+#endif
@@ -0,0 +1,285 @@
+#include <string.h>
+
+#include "osc_frame.h"
+#include "osc_params.h"
+
+#define TOP(f)   offsetof(Config, f)
+#define INPUT(f) offsetof(Config, input[0].f)
+#define SEND(f)  offsetof(Config, send[0].f)
+
+#define INPUT_STRIDE ((uint16_t)sizeof(ConfigInput))
+#define SEND_STRIDE  ((uint16_t)sizeof(ConfigSend))
+
+// LUT points are compiled to the table the next frame publishes
+static void stage_lut(const osc_match *m, const void *value) {
+  osc_frame_stage_lut(m->index[0], (LutChannel)m->index[1], value);
+}
+
+#define STR     OSC_IMAGE_STRING, CONFIG_MAX_STR_LEN
+#define NUM(t)  OSC_IMAGE_##t, 1
+
+// in the order /sync has always sent them
+const osc_param osc_params[] = {
+    {"/sync_mode", "s", STR, TOP(sync_mode), {0}, &config_lock},
+    {"/input/[1-4]/connected", "T", NUM(BOOL), INPUT(connected),
+     {INPUT_STRIDE}, config_input_lock, true},
+    {"/input/[1-4]/resolution", "s", STR, INPUT(resolution), {INPUT_STRIDE},
+     config_input_lock, true},
+    {"/input/[1-4]/framerate", "f", NUM(FLOAT), INPUT(framerate),
+     {INPUT_STRIDE}, config_input_lock, true, 0.0f, 240.0f},
+    {"/input/[1-4]/colorspace", "s", STR, INPUT(colorspace), {INPUT_STRIDE},
+     config_input_lock, true},
+    {"/input/[1-4]/bit_depth", "i", NUM(INT8), INPUT(bit_depth),
+     {INPUT_STRIDE}, config_input_lock, true, 0.0f, 16.0f},
+    {"/input/[1-4]/chroma_subsampling", "s", STR, INPUT(chroma_subsampling),
+     {INPUT_STRIDE}, config_input_lock, true},
+    {"/clock_offset", "i", NUM(INT), TOP(clock_offset), {0}, &config_lock},
+    {"/analog_format/resolution", "s", STR, TOP(analog_format.resolution),
+     {0}, &config_lock},
+    {"/analog_format/framerate", "f", NUM(FLOAT), TOP(analog_format.framerate),
+     {0}, &config_lock, false, 0.0f, 240.0f, OSC_PARAM_RAMP},
+    {"/analog_format/colourspace", "s", STR, TOP(analog_format.colourspace),
+     {0}, &config_lock},
+    {"/analog_format/color_matrix/[0-2]/[0-2]", "f", NUM(FLOAT),
+     TOP(analog_format.color_matrix), {3 * sizeof(float), sizeof(float)},
+     &config_lock, false, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/input", "i", NUM(INT), SEND(input), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 4.0f},
+    {"/send/[1-4]/scaleX", "f", NUM(FLOAT), SEND(scaleX), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/scaleY", "f", NUM(FLOAT), SEND(scaleY), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/posX", "f", NUM(FLOAT), SEND(posX), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/posY", "f", NUM(FLOAT), SEND(posY), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/rotation", "f", NUM(FLOAT), SEND(rotation), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/pitch", "f", NUM(FLOAT), SEND(pitch), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/yaw", "f", NUM(FLOAT), SEND(yaw), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/brightness", "f", NUM(FLOAT), SEND(brightness),
+     {SEND_STRIDE}, config_send_lock, true, 0.0f, 1.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/contrast", "f", NUM(FLOAT), SEND(contrast), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 1.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/saturation", "f", NUM(FLOAT), SEND(saturation),
+     {SEND_STRIDE}, config_send_lock, true, 0.0f, 1.0f, OSC_PARAM_RAMP},
+    {"/send/[1-4]/hue", "f", NUM(FLOAT), SEND(hue), {SEND_STRIDE},
+     config_send_lock, true, 0.0f, 0.0f, OSC_PARAM_RAMP},
+    // the signature is 32 'f's, decoded straight into the x,y pairs
+    {"/send/[1-4]/lut/[YRGB]", "ffffffffffffffffffffffffffffffff",
+     OSC_IMAGE_FLOAT, 2 * LUT_CONTROL_POINT_COUNT, SEND(lut),
+     {SEND_STRIDE, sizeof(ConfigSendLut)}, config_send_lock, true, 0.0f,
+     0.0f, 0, stage_lut},
+};
+
+const int osc_param_count = sizeof(osc_params) / sizeof(osc_params[0]);
+
+// the characters of the "[...]" set at s, in order, into out; returns
+// how many, or -1 if it is not closed
+static int set_chars(const char *s, char *out, int cap) {
+  int n = 0;
+  for (s++; *s && *s != ']'; s++) {
+    char lo = *s, hi = *s;
+    if (s[1] == '-' && s[2] && s[2] != ']') {
+      hi = s[2];
+      s += 2;
+    }
+    for (int c = lo; c <= hi && n < cap; c++)
+      out[n++] = (char)c;
+  }
+  return *s == ']' ? n : -1;
+}
+
+// the size of each index range of p into range; returns their count
+static int ranges(const osc_param *p, int *range) {
+  char chars[256];
+  int n = 0;
+  for (const char *s = p->pattern; *s; s++) {
+    if (*s != '[')
+      continue;
+    if (n < OSC_MAX_CAPTURES)
+      range[n++] = set_chars(s, chars, sizeof(chars));
+    s = strchr(s, ']');
+    if (!s)
+      break;
+  }
+  return n;
+}
+
+int osc_param_first(const osc_param *p, osc_match *m) {
+  int range[OSC_MAX_CAPTURES];
+  memset(m, 0, sizeof(*m));
+  m->count = ranges(p, range);
+  return m->count;
+}
+
+bool osc_param_next(const osc_param *p, osc_match *m) {
+  int range[OSC_MAX_CAPTURES];
+  ranges(p, range);
+  for (int i = m->count - 1; i >= 0; i--) {
+    if (++m->index[i] < range[i])
+      return true;
+    m->index[i] = 0;
+  }
+  return false;
+}
+
+int osc_param_path(const osc_param *p, const osc_match *m, char *buf,
+                   size_t len) {
+  char chars[256];
+  size_t n = 0;
+  int k = 0;
+  for (const char *s = p->pattern; *s; s++) {
+    char c = *s;
+    if (c == '[') {
+      int count = set_chars(s, chars, sizeof(chars));
+      if (count < 0 || k >= m->count || m->index[k] >= count)
+        return -1;
+      c = chars[m->index[k++]];
+      s = strchr(s, ']');
+    }
+    if (n + 1 >= len)
+      return -1;
+    buf[n++] = c;
+  }
+  buf[n] = '\0';
+  return (int)n;
+}
+
+static char *value_in(Config *c, const osc_param *p, const osc_match *m) {
+  char *v = (char *)c + p->offset;
+  for (int i = 0; i < m->count && i < 2; i++)
+    v += (size_t)m->index[i] * p->stride[i];
+  return v;
+}
+
+void *osc_param_value(const osc_param *p, const osc_match *m) {
+  return value_in(&config, p, m);
+}
+
+osc_seqlock *osc_param_lock(const osc_param *p, const osc_match *m) {
+  return p->lock_per_index ? &p->lock[m->index[0]] : p->lock;
+}
+
+bool osc_param_accepts(const osc_param *p, const char *format) {
+  if (p->type == OSC_IMAGE_BOOL)
+    return strcmp(format, "T") == 0 || strcmp(format, "F") == 0;
+  return strcmp(format, p->type_sig) == 0;
+}
+
+float osc_param_clamp(const osc_param *p, float v) {
+  if (v != v) // NaN fails both comparisons below
+    return p->min;
+  if (p->min == p->max)
+    return v;
+  return v < p->min ? p->min : v > p->max ? p->max : v;
+}
+
+// ints are compared as ints, so a wide one without limits stays exact
+static int clamp_int(const osc_param *p, int v) {
+  if (p->min == p->max)
+    return v;
+  return v < (int)p->min ? (int)p->min : v > (int)p->max ? (int)p->max : v;
+}
+
+void osc_param_set(const osc_param *p, const osc_match *m, tosc_message *msg) {
+  char *v = osc_param_value(p, m);
+  osc_seqlock *lock = osc_param_lock(p, m);
+  union {
+    int   i;
+    float f;
+  } arg = {0};
+  const char *s = NULL;
+  switch (p->type) {
+  case OSC_IMAGE_INT:
+  case OSC_IMAGE_INT8:
+    arg.i = clamp_int(p, tosc_getNextInt32(msg));
+    break;
+  case OSC_IMAGE_FLOAT:
+    if (p->count == 1)
+      arg.f = osc_param_clamp(p, tosc_getNextFloat(msg));
+    break;
+  case OSC_IMAGE_STRING:
+    s = tosc_getNextString(msg);
+    break;
+  case OSC_IMAGE_BOOL:
+    break;
+  }
+
+  char copy[2 * LUT_CONTROL_POINT_COUNT * sizeof(float)];
+  size_t size = p->type == OSC_IMAGE_FLOAT ? p->count * sizeof(float) : 0;
+  osc_seqlock_write_begin(lock);
+  switch (p->type) {
+  case OSC_IMAGE_INT:
+    *(int *)v = arg.i;
+    break;
+  case OSC_IMAGE_INT8:
+    *v = (char)arg.i;
+    break;
+  case OSC_IMAGE_BOOL:
+    *v = msg->format[0] == 'T';
+    break;
+  case OSC_IMAGE_FLOAT:
+    if (p->count == 1) {
+      *(float *)v = arg.f;
+    } else {
+      tosc_getNextFloats(msg, (float *)v, p->count);
+      for (int i = 0; i < p->count; i++)
+        ((float *)v)[i] = osc_param_clamp(p, ((float *)v)[i]);
+    }
+    break;
+  case OSC_IMAGE_STRING:
+    strncpy(v, s, p->count - 1);
+    break;
+  }
+  if (p->on_set && size <= sizeof(copy))
+    memcpy(copy, v, size);
+  osc_seqlock_write_end(lock);
+
+  if (p->on_set && size <= sizeof(copy))
+    p->on_set(m, copy);
+}
+
+int osc_params_sanitize(Config *c) {
+  int changed = 0;
+  for (int k = 0; k < osc_param_count; k++) {
+    const osc_param *p = &osc_params[k];
+    osc_match m;
+    osc_param_first(p, &m);
+    do {
+      char *v = value_in(c, p, &m);
+      switch (p->type) {
+      case OSC_IMAGE_INT: {
+        int x = clamp_int(p, *(int *)v);
+        changed += x != *(int *)v;
+        *(int *)v = x;
+        break;
+      }
+      case OSC_IMAGE_INT8: {
+        char x = (char)clamp_int(p, *v);
+        changed += x != *v;
+        *v = x;
+        break;
+      }
+      case OSC_IMAGE_BOOL:
+        changed += *v != 0 && *v != 1;
+        *v = *v != 0;
+        break;
+      case OSC_IMAGE_FLOAT:
+        for (int i = 0; i < p->count; i++) {
+          float *f = (float *)v + i, x = osc_param_clamp(p, *f);
+          changed += x != *f;
+          *f = x;
+        }
+        break;
+      case OSC_IMAGE_STRING:
+        changed += memchr(v, '\0', p->count) == NULL;
+        v[p->count - 1] = '\0';
+        break;
+      }
+    } while (osc_param_next(p, &m));
+  }
+  return changed;
+}
@@ -0,0 +1,70 @@
+#ifndef __OSC_PARAMS_H__
+#define __OSC_PARAMS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "osc_config.h"
+#include "osc_image.h"
+
+/*
+ * The parameter registry: one row per parameter of Config, from which
+ * dispatch_init builds the dispatch entries, the state image (and so GET,
+ * /sync and push) and the ramp and range checks.  Adding a parameter is
+ * adding a row.
+ *
+ * Each "[...]" set in a pattern is an index range; the value of indices
+ * (i, j) is at offset + i * stride[0] + j * stride[1] in config, under
+ * lock, or lock[i] when there is one lock per instance.
+ */
+
+#define OSC_PARAM_RAMP 0x1 // a single float that /ramp may move
+
+typedef struct osc_param {
+  const char     *pattern;
+  const char     *type_sig;
+  osc_image_type  type;
+  int             count;     // floats, or the string buffer size
+  size_t          offset;    // of indices (0, 0) in Config
+  uint16_t        stride[2]; // bytes per step of each index
+  osc_seqlock    *lock;
+  bool            lock_per_index;
+  float           min, max;  // numbers are clamped into these unless equal
+  unsigned        flags;
+  // runs after a SET with a copy of the value taken under the lock
+  void          (*on_set)(const osc_match *m, const void *value);
+} osc_param;
+
+extern const osc_param osc_params[];
+extern const int       osc_param_count;
+
+/* Fills m with the first indices of p. Returns the number of indices. */
+int osc_param_first(const osc_param *p, osc_match *m);
+
+/* Steps m to p's next indices, the last varying fastest. Returns false
+ * after the last. */
+bool osc_param_next(const osc_param *p, osc_match *m);
+
+/* Writes the address of p at indices m. Returns its length, or -1. */
+int osc_param_path(const osc_param *p, const osc_match *m, char *buf,
+                   size_t len);
+
+void        *osc_param_value(const osc_param *p, const osc_match *m);
+osc_seqlock *osc_param_lock(const osc_param *p, const osc_match *m);
+
+/* True if p takes a message with these type tags; a boolean takes T or
+ * F. */
+bool osc_param_accepts(const osc_param *p, const char *format);
+
+/* v within p's limits; NaN becomes p->min, limits or not. */
+float osc_param_clamp(const osc_param *p, float v);
+
+/* Applies a SET whose type tags p accepts, clamped into p's limits. */
+void osc_param_set(const osc_param *p, const osc_match *m, tosc_message *msg);
+
+/* Clamps every number of c into its limits and terminates every string,
+ * as for state restored from disk. Returns how many values it changed. */
+int osc_params_sanitize(Config *c);
+
+#endif
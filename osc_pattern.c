@@ -0,0 +1,259 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "osc_pattern.h"
+
+#define SET_WORDS (OSC_PATTERN_MAX_NFA / 64)
+
+typedef struct nfa_state {
+  uint64_t on[4]; // chars of the consuming edge
+  int16_t  next;  // where it goes, or -1
+  int16_t  eps[2];
+} nfa_state;
+
+typedef struct nfa {
+  nfa_state s[OSC_PATTERN_MAX_NFA];
+  int       count;
+  int       accept;
+} nfa;
+
+static void set_char(uint64_t *on, unsigned c) { on[c >> 6] |= 1ull << (c & 63); }
+
+static bool has_char(const uint64_t *on, unsigned c) {
+  return (on[c >> 6] >> (c & 63)) & 1;
+}
+
+// every character but NUL and '/', which no wildcard crosses
+static void set_segment_chars(uint64_t *on) {
+  for (unsigned c = 1; c < 256; c++)
+    if (c != '/')
+      set_char(on, c);
+}
+
+static int new_state(nfa *n) {
+  if (n->count >= OSC_PATTERN_MAX_NFA)
+    return -1;
+  nfa_state *s = &n->s[n->count];
+  memset(s, 0, sizeof(*s));
+  s->next = s->eps[0] = s->eps[1] = -1;
+  return n->count++;
+}
+
+// parses "[...]" at p into on; returns the length or -1
+static int parse_set(const char *p, uint64_t *on) {
+  uint64_t in[4] = {0};
+  int i = 1;
+  bool negate = p[i] == '!' || p[i] == '^';
+  if (negate)
+    i++;
+  bool first = true;
+  for (; p[i] && (p[i] != ']' || first); i++, first = false) {
+    unsigned lo = (unsigned char)p[i], hi = lo;
+    if (p[i + 1] == '-' && p[i + 2] && p[i + 2] != ']') {
+      hi = (unsigned char)p[i + 2];
+      i += 2;
+    }
+    for (unsigned c = lo; c <= hi; c++)
+      set_char(in, c);
+  }
+  if (p[i] != ']')
+    return -1;
+  for (unsigned c = 1; c < 256; c++)
+    if (c != '/' && has_char(in, c) != negate)
+      set_char(on, c);
+  return i + 1;
+}
+
+// Thompson construction: each piece hangs off the open state cur and
+// leaves a new open state, which is accepting once the pattern ends
+static int build_nfa(nfa *n, const char *p) {
+  n->count = 0;
+  int cur = new_state(n);
+  while (*p) {
+    nfa_state *s = &n->s[cur];
+    if (p[0] == '/' && p[1] == '/') {
+      // "/" then any number of "segment/"
+      int l = new_state(n), a = new_state(n), seg = new_state(n),
+          more = new_state(n), up = new_state(n);
+      if (up < 0)
+        return -1;
+      set_char(n->s[cur].on, '/');
+      n->s[cur].next = l;
+      n->s[l].eps[0] = a;
+      set_segment_chars(n->s[l].on);
+      n->s[l].next = seg;
+      n->s[seg].eps[0] = more;
+      n->s[seg].eps[1] = up;
+      set_segment_chars(n->s[more].on);
+      n->s[more].next = seg;
+      set_char(n->s[up].on, '/');
+      n->s[up].next = l;
+      cur = a;
+      p += 2;
+    } else if (*p == '*') {
+      int a = new_state(n);
+      if (a < 0)
+        return -1;
+      set_segment_chars(n->s[cur].on);
+      n->s[cur].next = cur;
+      n->s[cur].eps[0] = a;
+      cur = a;
+      p++;
+    } else if (*p == '{') {
+      // a split per alternative, each a literal chain into join
+      int join = new_state(n);
+      if (join < 0)
+        return -1;
+      p++;
+      for (;;) {
+        int a = new_state(n);
+        if (a < 0)
+          return -1;
+        n->s[cur].eps[0] = a;
+        for (; *p && *p != ',' && *p != '}'; p++) {
+          int b = new_state(n);
+          if (b < 0)
+            return -1;
+          set_char(n->s[a].on, (unsigned char)*p);
+          n->s[a].next = b;
+          a = b;
+        }
+        n->s[a].eps[0] = join;
+        if (*p != ',')
+          break;
+        p++;
+        int split = new_state(n);
+        if (split < 0)
+          return -1;
+        n->s[cur].eps[1] = split;
+        cur = split;
+      }
+      if (*p != '}')
+        return -1;
+      cur = join;
+      p++;
+    } else {
+      int a = new_state(n);
+      if (a < 0)
+        return -1;
+      s = &n->s[cur];
+      if (*p == '?') {
+        set_segment_chars(s->on);
+        p++;
+      } else if (*p == '[') {
+        int len = parse_set(p, s->on);
+        if (len < 0)
+          return -1;
+        p += len;
+      } else {
+        set_char(s->on, (unsigned char)*p++);
+      }
+      s->next = a;
+      cur = a;
+    }
+  }
+  n->accept = cur;
+  return 0;
+}
+
+static void closure(const nfa *n, uint64_t *set) {
+  int stack[OSC_PATTERN_MAX_NFA], top = 0;
+  for (int i = 0; i < n->count; i++)
+    if ((set[i >> 6] >> (i & 63)) & 1)
+      stack[top++] = i;
+  while (top > 0) {
+    const nfa_state *s = &n->s[stack[--top]];
+    for (int e = 0; e < 2; e++) {
+      int t = s->eps[e];
+      if (t >= 0 && !((set[t >> 6] >> (t & 63)) & 1)) {
+        set[t >> 6] |= 1ull << (t & 63);
+        stack[top++] = t;
+      }
+    }
+  }
+}
+
+bool osc_pattern_is_pattern(const char *address) {
+  return strpbrk(address, "*?[{") != NULL || strstr(address, "//") != NULL;
+}
+
+int osc_pattern_compile(osc_pattern *p, const char *pattern) {
+  static __thread nfa n;
+  memset(p, 0, sizeof(*p));
+  if (strnlen(pattern, OSC_PATTERN_MAX_LEN) >= OSC_PATTERN_MAX_LEN ||
+      build_nfa(&n, pattern) < 0)
+    return -1;
+
+  // characters the NFA cannot tell apart share a class; class 0 is those
+  // no edge consumes, so it is dead from every state
+  uint64_t sig[OSC_PATTERN_MAX_CLASSES][SET_WORDS];
+  uint8_t rep[OSC_PATTERN_MAX_CLASSES];
+  memset(sig[0], 0, sizeof(sig[0]));
+  rep[0] = 0;
+  p->classes = 1;
+  for (unsigned c = 1; c < 256; c++) {
+    uint64_t s[SET_WORDS] = {0};
+    for (int i = 0; i < n.count; i++)
+      if (has_char(n.s[i].on, c))
+        s[i >> 6] |= 1ull << (i & 63);
+    int k = 0;
+    while (k < p->classes && memcmp(sig[k], s, sizeof(s)) != 0)
+      k++;
+    if (k == p->classes) {
+      if (k >= OSC_PATTERN_MAX_CLASSES)
+        return -1;
+      memcpy(sig[k], s, sizeof(s));
+      rep[k] = (uint8_t)c;
+      p->classes++;
+    }
+    p->class_of[c] = (uint8_t)k;
+  }
+
+  // subset construction
+  uint64_t dstate[OSC_PATTERN_MAX_STATES][SET_WORDS] = {{0}};
+  dstate[0][0] = 1;
+  closure(&n, dstate[0]);
+  p->states = 1;
+  for (int d = 0; d < p->states; d++) {
+    p->accept[d] = (dstate[d][n.accept >> 6] >> (n.accept & 63)) & 1;
+    p->next[d][0] = -1;
+    for (int k = 1; k < p->classes; k++) {
+      uint64_t to[SET_WORDS] = {0};
+      bool any = false;
+      for (int i = 0; i < n.count; i++) {
+        const nfa_state *s = &n.s[i];
+        if (((dstate[d][i >> 6] >> (i & 63)) & 1) && s->next >= 0 &&
+            has_char(s->on, rep[k])) {
+          to[s->next >> 6] |= 1ull << (s->next & 63);
+          any = true;
+        }
+      }
+      if (!any) {
+        p->next[d][k] = -1;
+        continue;
+      }
+      closure(&n, to);
+      int e = 0;
+      while (e < p->states && memcmp(dstate[e], to, sizeof(to)) != 0)
+        e++;
+      if (e == p->states) {
+        if (e >= OSC_PATTERN_MAX_STATES)
+          return -1;
+        memcpy(dstate[e], to, sizeof(to));
+        p->states++;
+      }
+      p->next[d][k] = (int8_t)e;
+    }
+  }
+  return 0;
+}
+
+bool osc_pattern_match(const osc_pattern *p, const char *address) {
+  int s = 0;
+  for (const unsigned char *c = (const unsigned char *)address; *c; c++) {
+    s = p->next[s][p->class_of[*c]];
+    if (s < 0)
+      return false;
+  }
+  return p->accept[s];
+}
@@ -0,0 +1,45 @@
+#ifndef __OSC_PATTERN_H__
+#define __OSC_PATTERN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * OSC address patterns, as a client sends them: the incoming address is
+ * the pattern and the server's addresses are what it is matched against.
+ *
+ *   ?       any one character but '/'
+ *   *       any run of characters but '/', possibly empty
+ *   [a-z]   one character of the set; [!a-z] (or [^a-z]) one not in it
+ *   {a,bc}  one of the comma-separated strings
+ *   //      any number of whole levels, so /send//hue matches /send/1/hue
+ *
+ * A pattern is compiled once to a DFA: a Thompson NFA of its pieces, then
+ * subset construction over the classes of characters the pattern tells
+ * apart, so a match is one table lookup per character of the address.
+ */
+
+#define OSC_PATTERN_MAX_LEN     128
+#define OSC_PATTERN_MAX_NFA     256
+#define OSC_PATTERN_MAX_STATES  64
+#define OSC_PATTERN_MAX_CLASSES 48
+
+typedef struct osc_pattern {
+  uint8_t class_of[256]; // char -> character class
+  int     classes;
+  int     states;
+  // next state by state and class; -1 is the dead state
+  int8_t  next[OSC_PATTERN_MAX_STATES][OSC_PATTERN_MAX_CLASSES];
+  bool    accept[OSC_PATTERN_MAX_STATES];
+} osc_pattern;
+
+/* True if address uses any pattern syntax, and so is not one address. */
+bool osc_pattern_is_pattern(const char *address);
+
+/* Compiles pattern. Returns 0, or -1 if it is malformed or its DFA would
+ * be too big. */
+int osc_pattern_compile(osc_pattern *p, const char *pattern);
+
+bool osc_pattern_match(const osc_pattern *p, const char *address);
+
+#endif
@@ -0,0 +1,215 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "osc_frame.h"
+#include "osc_persist.h"
+
+#define PAGE 4096
+#define SLOT_LEN ((sizeof(osc_persist_slot) + PAGE - 1) / PAGE * PAGE)
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// CRC-32 (IEEE), bit by bit: a Config is a few kilobytes
+static uint32_t crc32(const void *data, size_t len) {
+  const uint8_t *b = data;
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= b[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static bool slot_ok(const osc_persist_slot *s) {
+  return crc32(&s->config, sizeof(s->config)) == s->crc;
+}
+
+// a fresh file: both slots hold the defaults in config
+static int format(osc_persist *p) {
+  memset(p->map, 0, p->map_len);
+  for (int i = 0; i < 2; i++) {
+    p->slot[i]->config = config;
+    p->slot[i]->crc = crc32(&config, sizeof(config));
+  }
+  if (msync(p->map, p->map_len, MS_SYNC) < 0)
+    return -1;
+  p->header->magic = OSC_PERSIST_MAGIC;
+  p->header->version = OSC_PERSIST_VERSION;
+  p->header->config_size = sizeof(Config);
+  p->header->active = 0;
+  return msync(p->map, PAGE, MS_SYNC);
+}
+
+int osc_persist_open(osc_persist *p, const char *path) {
+  memset(p, 0, sizeof(*p));
+  pthread_mutex_init(&p->stats_lock, NULL);
+  p->stats.restored = -1;
+  p->map_len = PAGE + 2 * SLOT_LEN;
+  p->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (p->fd < 0) {
+    perror(path);
+    return -1;
+  }
+  struct stat st;
+  if (fstat(p->fd, &st) < 0)
+    st.st_size = 0;
+  bool fresh = st.st_size == 0;
+  bool fits = (size_t)st.st_size == p->map_len;
+  if (!fits && ftruncate(p->fd, p->map_len) < 0) {
+    perror(path);
+    close(p->fd);
+    p->fd = -1;
+    return -1;
+  }
+  p->map = mmap(NULL, p->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, p->fd,
+                0);
+  if (p->map == MAP_FAILED) {
+    perror("mmap");
+    close(p->fd);
+    p->fd = -1;
+    p->map = NULL;
+    return -1;
+  }
+  p->header = (osc_persist_header *)p->map;
+  p->slot[0] = (osc_persist_slot *)(p->map + PAGE);
+  p->slot[1] = (osc_persist_slot *)(p->map + PAGE + SLOT_LEN);
+
+  const osc_persist_header *h = p->header;
+  int use = -1;
+  if (fits && h->magic == OSC_PERSIST_MAGIC &&
+      h->version == OSC_PERSIST_VERSION && h->config_size == sizeof(Config)) {
+    // the named slot, or the other one if a crash tore it
+    int a = h->active & 1;
+    if (slot_ok(p->slot[a]))
+      use = a;
+    else if (slot_ok(p->slot[a ^ 1]))
+      use = a ^ 1;
+  }
+  if (use < 0) {
+    if (!fresh)
+      printf("ERROR: %s holds no usable state, starting from defaults\n",
+             path);
+    if (format(p) < 0) {
+      perror("msync");
+      munmap(p->map, p->map_len);
+      close(p->fd);
+      p->fd = -1;
+      p->map = NULL;
+      return -1;
+    }
+    use = 0;
+  } else {
+    config = p->slot[use]->config;
+    p->stats.restored = use;
+  }
+  p->header->active = use;
+  p->gen = p->slot[use]->gen;
+  p->last = p->slot[use]->config;
+  return 0;
+}
+
+int osc_persist_save(osc_persist *p) {
+  Config c;
+  osc_frame_snapshot(&c);
+  if (memcmp(&c, &p->last, sizeof(c)) == 0)
+    return 0;
+
+  uint64_t start = now_ns();
+  int next = (p->header->active & 1) ^ 1;
+  osc_persist_slot *s = p->slot[next];
+  s->config = c;
+  s->gen = p->gen + 1;
+  s->crc = crc32(&c, sizeof(c));
+  // the slot must be on disk before the header names it
+  int ok = msync(s, SLOT_LEN, MS_SYNC) == 0;
+  if (ok) {
+    p->header->active = next;
+    ok = msync(p->header, PAGE, MS_SYNC) == 0;
+  }
+  if (ok) {
+    p->gen++;
+    p->last = c;
+  }
+  uint64_t ns = now_ns() - start;
+
+  pthread_mutex_lock(&p->stats_lock);
+  if (ok)
+    p->stats.saves++;
+  else
+    p->stats.failed++;
+  p->stats.save_ns_sum += ns;
+  if (ns > p->stats.save_ns_max)
+    p->stats.save_ns_max = ns;
+  pthread_mutex_unlock(&p->stats_lock);
+  return ok ? 1 : -1;
+}
+
+static void on_timer(osc_ev_loop *l, int fd, uint32_t expirations,
+                     void *data) {
+  osc_persist_save(data);
+}
+
+static void *persist_main(void *arg) {
+  osc_persist *p = arg;
+  osc_ev_run(&p->loop);
+  return NULL;
+}
+
+int osc_persist_start(osc_persist *p) {
+  uint64_t interval = OSC_PERSIST_INTERVAL_MS * 1000000ull;
+  if (osc_ev_init(&p->loop) < 0)
+    return -1;
+  if (osc_ev_add_timer(&p->loop, interval, interval, on_timer, p) < 0 ||
+      pthread_create(&p->thread, NULL, persist_main, p) != 0) {
+    osc_ev_close(&p->loop);
+    return -1;
+  }
+  p->running = true;
+  return 0;
+}
+
+void osc_persist_close(osc_persist *p) {
+  if (p->running) {
+    osc_ev_stop(&p->loop);
+    pthread_join(p->thread, NULL);
+    osc_ev_close(&p->loop);
+    p->running = false;
+  }
+  if (p->map) {
+    osc_persist_save(p);
+    munmap(p->map, p->map_len);
+    p->map = NULL;
+  }
+  if (p->fd >= 0)
+    close(p->fd);
+  p->fd = -1;
+}
+
+void osc_persist_get_stats(osc_persist *p, osc_persist_stats *st) {
+  pthread_mutex_lock(&p->stats_lock);
+  *st = p->stats;
+  pthread_mutex_unlock(&p->stats_lock);
+}
+
+void osc_persist_print_stats(const osc_persist_stats *st) {
+  printf("persist: %llu saves", (unsigned long long)st->saves);
+  if (st->saves)
+    printf(", avg %llu us max %llu us",
+           (unsigned long long)(st->save_ns_sum / st->saves / 1000),
+           (unsigned long long)(st->save_ns_max / 1000));
+  if (st->failed)
+    printf(", %llu failed", (unsigned long long)st->failed);
+  if (st->restored >= 0)
+    printf(", restored from slot %c", "AB"[st->restored]);
+  printf("\n");
+}
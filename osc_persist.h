@@ -0,0 +1,86 @@
+#ifndef __OSC_PERSIST_H__
+#define __OSC_PERSIST_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "osc_config.h"
+#include "osc_event.h"
+
+/*
+ * Crash-safe persistent config.
+ *
+ * The state file is mapped once and holds a header page and two slots,
+ * A and B, each a raw copy of Config with a generation and a CRC-32.  At
+ * startup the slot the header names is checked and copied over config:
+ * one mmap and a memcpy, no parsing.  If it is torn the other slot is
+ * used, and if both are (or the file is new or from another layout
+ * version) config keeps its defaults.
+ *
+ * A background thread snapshots config every OSC_PERSIST_INTERVAL_MS and,
+ * if it changed, writes it to the slot not in use, msyncs that slot, then
+ * flips the header to it and msyncs the header.  A crash at any point
+ * leaves the previous slot intact and named.  The packet loop never
+ * waits for any of this.
+ */
+
+#define OSC_PERSIST_MAGIC       0x5043534fu // "OSCP"
+#define OSC_PERSIST_VERSION     1
+#define OSC_PERSIST_INTERVAL_MS 100
+
+typedef struct osc_persist_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t config_size; // sizeof(Config) that wrote the file
+  uint32_t active;      // slot with the latest state, 0 or 1
+} osc_persist_header;
+
+typedef struct osc_persist_slot {
+  uint64_t gen; // saves before this one
+  uint32_t crc; // of config
+  uint32_t pad;
+  Config   config;
+} osc_persist_slot;
+
+typedef struct osc_persist_stats {
+  int      restored;  // slot config came from, or -1
+  uint64_t saves;
+  uint64_t failed;    // msyncs that failed
+  uint64_t save_ns_sum;
+  uint64_t save_ns_max;
+} osc_persist_stats;
+
+typedef struct osc_persist {
+  int                 fd;
+  char               *map;
+  size_t              map_len;
+  osc_persist_header *header;
+  osc_persist_slot   *slot[2];
+  uint64_t            gen;  // of the active slot
+  Config              last; // what it holds
+  osc_ev_loop         loop;
+  pthread_t           thread;
+  bool                running;
+  pthread_mutex_t     stats_lock;
+  osc_persist_stats   stats;
+} osc_persist;
+
+/* Maps path, creating it if needed, and restores config from it. Call
+ * before dispatch_init. Returns 0 or -1. */
+int osc_persist_open(osc_persist *p, const char *path);
+
+/* Starts the thread that saves config. Returns 0 or -1. */
+int osc_persist_start(osc_persist *p);
+
+/* Stops the thread, saves a last time and unmaps the file. */
+void osc_persist_close(osc_persist *p);
+
+/* Saves config now if it changed; what the thread runs. Returns 1 if it
+ * saved, 0 if unchanged, -1 if a msync failed. */
+int osc_persist_save(osc_persist *p);
+
+void osc_persist_get_stats(osc_persist *p, osc_persist_stats *st);
+void osc_persist_print_stats(const osc_persist_stats *st);
+
+#endif
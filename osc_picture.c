@@ -0,0 +1,31 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc_picture.h"
+
+int osc_picture_alloc(osc_picture *p, int width, int height) {
+  memset(p, 0, sizeof(*p));
+  if (width < 1 || height < 1)
+    return -1;
+  size_t per_line = OSC_PICTURE_ALIGN / sizeof(float);
+  p->width = width;
+  p->height = height;
+  p->stride = ((size_t)width + per_line - 1) / per_line * per_line;
+  size_t bytes = p->stride * (size_t)height * sizeof(float);
+  for (int c = 0; c < 3; c++) {
+    p->plane[c] = aligned_alloc(OSC_PICTURE_ALIGN, bytes);
+    if (!p->plane[c]) {
+      osc_picture_free(p);
+      return -1;
+    }
+    memset(p->plane[c], 0, bytes);
+  }
+  return 0;
+}
+
+void osc_picture_free(osc_picture *p) {
+  for (int c = 0; c < 3; c++) {
+    free(p->plane[c]);
+    p->plane[c] = NULL;
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef __OSC_PICTURE_H__
+#define __OSC_PICTURE_H__
+
+#include <stddef.h>
+
+/*
+ * A frame as three float planes, R, G and B, nominally in [0, 1].  Rows
+ * start 32-byte aligned and are stride floats apart, so SIMD kernels can
+ * run whole rows.
+ */
+
+#define OSC_PICTURE_ALIGN 32
+
+typedef struct osc_picture {
+  int    width;
+  int    height;
+  size_t stride;   // floats from one row to the next
+  float *plane[3]; // R, G, B
+} osc_picture;
+
+/* Allocates the planes, zeroed. Returns 0 or -1. */
+int osc_picture_alloc(osc_picture *p, int width, int height);
+void osc_picture_free(osc_picture *p);
+
+static inline float *osc_picture_row(const osc_picture *p, int c, int y) {
+  return p->plane[c] + (size_t)y * p->stride;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "osc_ramp.h"
+
+static const char *curve_names[OSC_RAMP_CURVES] = {
+    "linear", "ease_in", "ease_out", "ease_in_out"};
+
+void osc_ramps_init(osc_ramps *r) {
+  memset(r, 0, sizeof(*r));
+  memset(r->slot, -1, sizeof(r->slot));
+  pthread_mutex_init(&r->lock, NULL);
+}
+
+int osc_ramp_curve_parse(const char *name) {
+  for (int c = 0; c < OSC_RAMP_CURVES; c++)
+    if (strcmp(name, curve_names[c]) == 0)
+      return c;
+  return -1;
+}
+
+float osc_ramp_shape(osc_ramp_curve curve, float t) {
+  switch (curve) {
+  case OSC_RAMP_EASE_IN:
+    return t * t;
+  case OSC_RAMP_EASE_OUT:
+    return 1.0f - (1.0f - t) * (1.0f - t);
+  case OSC_RAMP_EASE_IN_OUT:
+    return t * t * (3.0f - 2.0f * t);
+  default:
+    return t;
+  }
+}
+
+int osc_ramps_start(osc_ramps *r, int field, float *value, osc_seqlock *lock,
+                    float target, float seconds, osc_ramp_curve curve,
+                    uint64_t now_ns) {
+  osc_ramp ramp = {
+      .field = field,
+      .value = value,
+      .lock = lock,
+      .to = target,
+      .start_ns = now_ns,
+      .ns = seconds > 0.0f ? (uint64_t)((double)seconds * 1e9) : 0,
+      .curve = curve,
+  };
+  OSC_SEQLOCK_READ(lock, ramp.from, *value);
+
+  pthread_mutex_lock(&r->lock);
+  int i = r->slot[field];
+  if (i >= 0) {
+    r->stats.replaced++;
+  } else {
+    i = atomic_load_explicit(&r->count, memory_order_relaxed);
+    if (i == OSC_RAMP_MAX) {
+      pthread_mutex_unlock(&r->lock);
+      return -1;
+    }
+    r->slot[field] = (int16_t)i;
+    atomic_store_explicit(&r->count, i + 1, memory_order_relaxed);
+  }
+  r->active[i] = ramp;
+  r->stats.started++;
+  pthread_mutex_unlock(&r->lock);
+  return 0;
+}
+
+// moves the last ramp into slot i; called with the lock held
+static void remove_at(osc_ramps *r, int i) {
+  int last = atomic_load_explicit(&r->count, memory_order_relaxed) - 1;
+  r->slot[r->active[i].field] = -1;
+  if (i != last) {
+    r->active[i] = r->active[last];
+    r->slot[r->active[i].field] = (int16_t)i;
+  }
+  atomic_store_explicit(&r->count, last, memory_order_relaxed);
+}
+
+bool osc_ramps_cancel(osc_ramps *r, int field) {
+  if (atomic_load_explicit(&r->count, memory_order_relaxed) == 0)
+    return false;
+  pthread_mutex_lock(&r->lock);
+  int i = r->slot[field];
+  if (i >= 0) {
+    remove_at(r, i);
+    r->stats.cancelled++;
+  }
+  pthread_mutex_unlock(&r->lock);
+  return i >= 0;
+}
+
+int osc_ramps_step(osc_ramps *r, uint64_t now_ns, uint64_t *changed) {
+  if (atomic_load_explicit(&r->count, memory_order_relaxed) == 0)
+    return 0;
+  int n = 0;
+  // held across the writes so a SET that cancels a ramp is never
+  // overwritten by a step already under way
+  pthread_mutex_lock(&r->lock);
+  for (int i = 0; i < atomic_load_explicit(&r->count, memory_order_relaxed);) {
+    osc_ramp *rp = &r->active[i];
+    uint64_t elapsed = now_ns > rp->start_ns ? now_ns - rp->start_ns : 0;
+    bool done = elapsed >= rp->ns;
+    float v = rp->to;
+    if (!done) {
+      float t = (float)((double)elapsed / (double)rp->ns);
+      v = rp->from + (rp->to - rp->from) * osc_ramp_shape(rp->curve, t);
+    }
+
+    osc_seqlock_write_begin(rp->lock);
+    bool moved = *rp->value != v;
+    *rp->value = v;
+    osc_seqlock_write_end(rp->lock);
+    if (moved) {
+      changed[rp->field >> 6] |= 1ull << (rp->field & 63);
+      r->stats.steps++;
+      n++;
+    }
+
+    if (done) {
+      remove_at(r, i);
+      r->stats.finished++;
+    } else {
+      i++;
+    }
+  }
+  pthread_mutex_unlock(&r->lock);
+  return n;
+}
+
+void osc_ramps_get_stats(osc_ramps *r, osc_ramp_stats *st) {
+  pthread_mutex_lock(&r->lock);
+  *st = r->stats;
+  pthread_mutex_unlock(&r->lock);
+}
+
+void osc_ramps_print_stats(const osc_ramp_stats *st) {
+  if (st->started == 0)
+    return;
+  printf("ramps: %llu started (%llu replaced), %llu finished, %llu "
+         "cancelled, %llu steps\n",
+         (unsigned long long)st->started, (unsigned long long)st->replaced,
+         (unsigned long long)st->finished, (unsigned long long)st->cancelled,
+         (unsigned long long)st->steps);
+}
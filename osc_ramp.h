@@ -0,0 +1,94 @@
+#ifndef __OSC_RAMP_H__
+#define __OSC_RAMP_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "osc_image.h"
+#include "osc_seqlock.h"
+
+/*
+ * Parameter ramps.  A ramp moves one float field from its value when the
+ * ramp starts to a target over a duration, along a curve.  Ramps are
+ * advanced once per frame tick, by time rather than by counting ticks, so
+ * a late or missed tick does not stretch them; each step writes the field
+ * under its seqlock like a SET would.
+ *
+ * Active ramps are kept packed at the front of an array, with each state
+ * image field's slot in it, so a step costs one pass over the ramps that
+ * are running and starting, replacing or cancelling one is O(1).  A plain
+ * SET of a field cancels its ramp: the SET wins.
+ */
+
+#define OSC_RAMP_MAX 64
+
+typedef enum {
+  OSC_RAMP_LINEAR,
+  OSC_RAMP_EASE_IN,     // t^2
+  OSC_RAMP_EASE_OUT,    // 1 - (1 - t)^2
+  OSC_RAMP_EASE_IN_OUT, // 3t^2 - 2t^3
+  OSC_RAMP_CURVES
+} osc_ramp_curve;
+
+typedef struct osc_ramp {
+  int             field;    // state image field
+  float          *value;    // where it lives in config
+  osc_seqlock    *lock;     // guards value
+  float           from, to;
+  uint64_t        start_ns; // CLOCK_MONOTONIC
+  uint64_t        ns;       // duration
+  osc_ramp_curve  curve;
+} osc_ramp;
+
+typedef struct osc_ramp_stats {
+  uint64_t started;
+  uint64_t replaced;  // started on a field already ramping
+  uint64_t finished;
+  uint64_t cancelled; // by a SET of the field
+  uint64_t steps;     // field writes
+} osc_ramp_stats;
+
+typedef struct osc_ramps {
+  pthread_mutex_t lock;  // guards active, slot and stats
+  _Atomic int     count; // active ramps
+  osc_ramp        active[OSC_RAMP_MAX];
+  int16_t         slot[OSC_IMAGE_MAX_FIELDS]; // index in active, or -1
+  osc_ramp_stats  stats;
+} osc_ramps;
+
+void osc_ramps_init(osc_ramps *r);
+
+/* The curve called name ("linear", "ease_in", "ease_out", "ease_in_out"),
+ * or -1. */
+int osc_ramp_curve_parse(const char *name);
+
+/* Position along curve at t in [0, 1]. */
+float osc_ramp_shape(osc_ramp_curve curve, float t);
+
+/*
+ * Starts a ramp of field from the current *value to target over seconds
+ * (0 or less: the next step sets it), replacing any ramp it has. Returns
+ * 0, or -1 if OSC_RAMP_MAX ramps are running.
+ */
+int osc_ramps_start(osc_ramps *r, int field, float *value, osc_seqlock *lock,
+                    float target, float seconds, osc_ramp_curve curve,
+                    uint64_t now_ns);
+
+/* Drops the ramp of field, if any; cheap when no ramp is running. Returns
+ * true if there was one. */
+bool osc_ramps_cancel(osc_ramps *r, int field);
+
+/*
+ * Writes every active ramp's value at now_ns and retires those that
+ * reached their target. Sets the bits of the fields whose value changed
+ * in changed (OSC_IMAGE_WORDS words, not cleared first) and returns how
+ * many there were.
+ */
+int osc_ramps_step(osc_ramps *r, uint64_t now_ns, uint64_t *changed);
+
+void osc_ramps_get_stats(osc_ramps *r, osc_ramp_stats *st);
+void osc_ramps_print_stats(const osc_ramp_stats *st);
+
+#endif
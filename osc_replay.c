@@ -0,0 +1,233 @@
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "osc_config.h"
+#include "osc_frame.h"
+#include "osc_replay.h"
+#include "tinyosc.h"
+
+#define MAX_DATAGRAM 65536
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// replies of an in-process replay, counted rather than sent
+static osc_replay_result *counting;
+
+static size_t count_send(connectionT *conn, const void *buf, size_t len) {
+  counting->replies++;
+  counting->reply_bytes += len;
+  return len;
+}
+
+// what osc_server does with a datagram, minus holding bundles for their
+// timetag
+static void dispatch_datagram(char *buf, int len, connectionT *conn,
+                              osc_replay_result *res) {
+  if (len >= 16 && tosc_isBundle(buf)) {
+    tosc_bundle bundle;
+    tosc_message osc;
+    tosc_parseBundle(&bundle, buf, len);
+    osc_frame_bundle_begin();
+    while (tosc_getNextMessage(&bundle, &osc)) {
+      dispatch_message(&osc, conn);
+      res->messages++;
+    }
+    osc_frame_bundle_end();
+    return;
+  }
+  tosc_message osc;
+  if (tosc_parseMessageChecked(&osc, buf, len) != 0) {
+    res->malformed++;
+    return;
+  }
+  dispatch_message(&osc, conn);
+  res->messages++;
+}
+
+// a datagram the server answers: a GET, /sync or /ack
+static bool wants_reply(const char *buf, uint32_t len) {
+  if (len >= 16 && tosc_isBundle(buf))
+    return false;
+  size_t a = strnlen(buf, len); // a capture need not be NUL-terminated
+  if ((a == 5 && memcmp(buf, "/sync", 5) == 0) ||
+      (a == 4 && memcmp(buf, "/ack", 4) == 0))
+    return true;
+  size_t tag = (a + 4) & ~(size_t)3;
+  return tag + 1 < len && buf[tag] == ',' && buf[tag + 1] == '\0';
+}
+
+static int open_target(const char *target) {
+  char host[256];
+  const char *colon = strrchr(target, ':');
+  if (!colon || (size_t)(colon - target) >= sizeof(host)) {
+    printf("ERROR: target must be host:port\n");
+    return -1;
+  }
+  memcpy(host, target, colon - target);
+  host[colon - target] = '\0';
+  struct addrinfo hints = {.ai_socktype = SOCK_DGRAM}, *ai;
+  if (getaddrinfo(host, colon + 1, &hints, &ai) != 0) {
+    printf("ERROR: cannot resolve %s\n", target);
+    return -1;
+  }
+  int fd = socket(ai->ai_family, SOCK_DGRAM, 0);
+  if (fd < 0 || connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+    perror("replay socket");
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(ai);
+  return fd;
+}
+
+// reads replies already waiting, or waits up to timeout_ms for one;
+// returns how many came
+static int drain_replies(int fd, int timeout_ms, osc_replay_result *res) {
+  static char buf[MAX_DATAGRAM];
+  int n = 0;
+  struct pollfd p = {.fd = fd, .events = POLLIN};
+  while (poll(&p, 1, n == 0 ? timeout_ms : 0) > 0) {
+    ssize_t len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (len < 0)
+      break;
+    res->replies++;
+    res->reply_bytes += (uint64_t)len;
+    n++;
+  }
+  return n;
+}
+
+// waits until the monotonic time at, sleeping while it is far off
+static void wait_until(uint64_t at) {
+  uint64_t now = now_ns();
+  if (at > now + 100000) {
+    uint64_t until = at - 50000;
+    struct timespec ts = {(time_t)(until / 1000000000ull),
+                          (long)(until % 1000000000ull)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR)
+      ;
+  }
+  while (now_ns() < at)
+    ;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint64_t percentile(const uint64_t *sorted, uint64_t n, double q) {
+  if (n == 0)
+    return 0;
+  uint64_t i = (uint64_t)(q * (double)(n - 1) + 0.5);
+  return sorted[i];
+}
+
+int osc_replay_run(osc_capture_reader *r, const osc_replay_opts *opts,
+                   osc_replay_result *res) {
+  memset(res, 0, sizeof(*res));
+  int fd = -1;
+  if (opts->target && (fd = open_target(opts->target)) < 0)
+    return -1;
+
+  static char buf[MAX_DATAGRAM];
+  connectionT conn = {0};
+  conn.send = count_send;
+  counting = res;
+
+  uint64_t cap = 4096, *lat = malloc(cap * sizeof(*lat));
+  osc_capture_seek(r, opts->from_ns);
+  osc_capture_msg m;
+  uint64_t start = now_ns(), first_t = 0;
+  while ((!opts->limit || res->datagrams < opts->limit) &&
+         osc_capture_next(r, &m)) {
+    if (res->datagrams == 0)
+      first_t = m.t_ns;
+    if (opts->speed > 0)
+      wait_until(start + (uint64_t)((double)(m.t_ns - first_t) / opts->speed));
+    uint32_t len = m.len < sizeof(buf) ? m.len : sizeof(buf);
+    memcpy(buf, m.data, len);
+
+    uint64_t t0 = now_ns(), ns = 0;
+    bool timed = true;
+    if (fd < 0) {
+      memcpy(&conn.con.addr, &m.src, sizeof(m.src));
+      conn.con.addr_len = m.src_len;
+      dispatch_datagram(buf, (int)len, &conn, res);
+      ns = now_ns() - t0;
+    } else {
+      send(fd, buf, len, 0);
+      timed = wants_reply(buf, len);
+      if (timed) {
+        if (drain_replies(fd, OSC_REPLAY_REPLY_MS, res) > 0) {
+          ns = now_ns() - t0;
+        } else {
+          res->lost++;
+          timed = false;
+        }
+      } else {
+        drain_replies(fd, 0, res);
+      }
+    }
+    res->datagrams++;
+    if (timed && lat) {
+      if (res->timed == cap) {
+        uint64_t *grown = realloc(lat, 2 * cap * sizeof(*lat));
+        if (grown) {
+          lat = grown;
+          cap *= 2;
+        }
+      }
+      if (res->timed < cap)
+        lat[res->timed++] = ns;
+    }
+  }
+  if (fd >= 0) {
+    drain_replies(fd, OSC_REPLAY_REPLY_MS, res); // stragglers
+    close(fd);
+  }
+  res->elapsed_ns = now_ns() - start;
+
+  if (lat && res->timed) {
+    qsort(lat, res->timed, sizeof(*lat), cmp_u64);
+    res->p50 = percentile(lat, res->timed, 0.50);
+    res->p90 = percentile(lat, res->timed, 0.90);
+    res->p99 = percentile(lat, res->timed, 0.99);
+    res->p999 = percentile(lat, res->timed, 0.999);
+    res->max = lat[res->timed - 1];
+  }
+  free(lat);
+  return 0;
+}
+
+void osc_replay_print(const osc_replay_result *res) {
+  double s = res->elapsed_ns / 1e9;
+  printf("replay: %llu datagrams", (unsigned long long)res->datagrams);
+  if (res->messages) // only counted in-process
+    printf(" (%llu messages)", (unsigned long long)res->messages);
+  printf(" in %.3f s, %.0f/s\n", s, s > 0 ? res->datagrams / s : 0.0);
+  printf("replay: latency over %llu: p50 %.1f us, p90 %.1f us, p99 %.1f us, "
+         "p99.9 %.1f us, max %.1f us\n",
+         (unsigned long long)res->timed, res->p50 / 1e3, res->p90 / 1e3,
+         res->p99 / 1e3, res->p999 / 1e3, res->max / 1e3);
+  printf("replay: %llu replies, %llu bytes", (unsigned long long)res->replies,
+         (unsigned long long)res->reply_bytes);
+  if (res->malformed)
+    printf(", %llu malformed", (unsigned long long)res->malformed);
+  if (res->lost)
+    printf(", %llu replies lost", (unsigned long long)res->lost);
+  printf("\n");
+}
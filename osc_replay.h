@@ -0,0 +1,50 @@
+#ifndef __OSC_REPLAY_H__
+#define __OSC_REPLAY_H__
+
+#include <stdint.h>
+
+#include "osc_capture.h"
+
+/*
+ * Feeds a capture back, either in-process through dispatch_message or
+ * over UDP to a running server, and measures it.
+ *
+ * In-process, each datagram's latency is its parse and dispatch, and the
+ * replies are counted instead of sent.  Over UDP, a datagram that asks
+ * for a reply (a GET, /sync or /ack) is timed from send until its first
+ * reply comes back, up to OSC_REPLAY_REPLY_MS; everything else is sent
+ * without waiting and any replies are counted as they arrive.
+ *
+ * speed scales the captured timing: 1 replays in real time, 10 ten
+ * times as fast, 0 as fast as possible.
+ */
+
+#define OSC_REPLAY_REPLY_MS 100
+
+typedef struct osc_replay_opts {
+  double      speed;
+  uint64_t    from_ns;   // start this far into the capture
+  uint64_t    limit;     // datagrams, 0 for all
+  const char *target;    // host:port, or NULL for in-process
+} osc_replay_opts;
+
+typedef struct osc_replay_result {
+  uint64_t datagrams;
+  uint64_t messages;     // including those in bundles
+  uint64_t malformed;
+  uint64_t replies;
+  uint64_t reply_bytes;
+  uint64_t timed;        // datagrams with a latency
+  uint64_t lost;         // replies that never came, over UDP
+  uint64_t elapsed_ns;
+  uint64_t p50, p90, p99, p999, max; // latency, ns
+} osc_replay_result;
+
+/* Replays r from opts->from_ns. Returns 0, or -1 if the target cannot be
+ * reached. dispatch_init must have run for an in-process replay. */
+int osc_replay_run(osc_capture_reader *r, const osc_replay_opts *opts,
+                   osc_replay_result *res);
+
+void osc_replay_print(const osc_replay_result *res);
+
+#endif
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "osc_sched.h"
+#include "tinyosc.h"
+
+#define NTP_UNIX_OFFSET 2208988800ull // seconds from 1900 to 1970
+
+uint64_t osc_sched_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t osc_sched_timetag_to_ns(uint64_t timetag, int offset_ms) {
+  uint64_t sec = timetag >> 32;
+  if (timetag == TINYOSC_TIMETAG_IMMEDIATELY || sec < NTP_UNIX_OFFSET)
+    return 0;
+
+  uint64_t frac_ns = ((timetag & 0xffffffffull) * 1000000000ull) >> 32;
+  int64_t unix_ns = (int64_t)((sec - NTP_UNIX_OFFSET) * 1000000000ull + frac_ns);
+
+  struct timespec real;
+  clock_gettime(CLOCK_REALTIME, &real);
+  int64_t real_ns = (int64_t)real.tv_sec * 1000000000ll + real.tv_nsec;
+
+  int64_t due = (int64_t)osc_sched_now_ns() + (unix_ns - real_ns) +
+                (int64_t)offset_ms * 1000000ll;
+  return due > 0 ? (uint64_t)due : 0;
+}
+
+void osc_sched_init(osc_sched *s, osc_sched_fire fire, void *ctx) {
+  memset(s, 0, sizeof(*s));
+  s->origin_ns = osc_sched_now_ns();
+  s->fire = fire;
+  s->ctx = ctx;
+}
+
+// tick index of a time, rounded down
+static uint64_t floor_tick(const osc_sched *s, uint64_t ns) {
+  return ns <= s->origin_ns ? 0 : (ns - s->origin_ns) / OSC_SCHED_TICK_NS;
+}
+
+static void link_entry(osc_sched *s, int level, int idx, osc_sched_entry *e) {
+  e->prev = NULL;
+  e->next = s->slots[level][idx];
+  if (e->next)
+    e->next->prev = e;
+  s->slots[level][idx] = e;
+  s->occupied[level][idx >> 6] |= 1ull << (idx & 63);
+}
+
+static void unlink_entry(osc_sched *s, int level, int idx,
+                         osc_sched_entry *e) {
+  if (e->prev)
+    e->prev->next = e->next;
+  else
+    s->slots[level][idx] = e->next;
+  if (e->next)
+    e->next->prev = e->prev;
+  if (!s->slots[level][idx])
+    s->occupied[level][idx >> 6] &= ~(1ull << (idx & 63));
+}
+
+// file an entry on the level whose span covers its distance from now_tick
+static void place(osc_sched *s, osc_sched_entry *e) {
+  uint64_t delta = e->due_tick - s->now_tick;
+  uint64_t tick = e->due_tick;
+  int level = 0;
+  while (level < OSC_SCHED_LEVELS - 1 && delta >= (1ull << (8 * (level + 1))))
+    level++;
+  if (level == OSC_SCHED_LEVELS - 1 && delta >= (1ull << (8 * OSC_SCHED_LEVELS)))
+    tick = s->now_tick + (1ull << (8 * OSC_SCHED_LEVELS)) - 1; // re-filed later
+  link_entry(s, level, (int)((tick >> (8 * level)) & 0xff), e);
+}
+
+static void cascade(osc_sched *s, int level, int idx) {
+  osc_sched_entry *e = s->slots[level][idx];
+  s->slots[level][idx] = NULL;
+  s->occupied[level][idx >> 6] &= ~(1ull << (idx & 63));
+  while (e) {
+    osc_sched_entry *next = e->next;
+    place(s, e);
+    e = next;
+  }
+}
+
+// first occupied slot at or after from on a level, or -1
+static int next_occupied(const osc_sched *s, int level, int from) {
+  for (int w = from >> 6; w < OSC_SCHED_SLOTS / 64; w++) {
+    uint64_t bits = s->occupied[level][w];
+    if (w == from >> 6)
+      bits &= ~0ull << (from & 63);
+    if (bits)
+      return (w << 6) + __builtin_ctzll(bits);
+  }
+  return -1;
+}
+
+static void record_late(osc_sched_stats *st, uint64_t late) {
+  int b = 0;
+  while (b < OSC_SCHED_ERROR_BUCKETS - 1 && late >= (10000ull << b))
+    b++;
+  st->late_hist[b]++;
+  st->late_ns_sum += late;
+  if (late > st->late_ns_max)
+    st->late_ns_max = late;
+}
+
+int osc_sched_add(osc_sched *s, uint64_t due_ns, const char *data,
+                  uint32_t len, connectionT *conn) {
+  uint64_t now = osc_sched_now_ns();
+  if (due_ns <= now) {
+    s->stats.immediate++;
+    return 1;
+  }
+  // round up so an entry never fires before its timetag
+  uint64_t due_tick =
+      (due_ns - s->origin_ns + OSC_SCHED_TICK_NS - 1) / OSC_SCHED_TICK_NS;
+  if (due_tick <= floor_tick(s, now)) {
+    s->stats.immediate++;
+    return 1;
+  }
+
+  if (s->pending == 0)
+    s->now_tick = floor_tick(s, now); // idle wheel: nothing to cascade
+
+  osc_sched_entry *e;
+  if (s->pending >= OSC_SCHED_MAX_PENDING ||
+      !(e = malloc(sizeof(*e) + len))) {
+    s->stats.dropped++;
+    return -1;
+  }
+  e->due_ns = due_ns;
+  e->due_tick = due_tick;
+  e->conn = conn;
+  e->addr_len = conn->con.addr_len;
+  memcpy(&e->addr, &conn->con.addr, conn->con.addr_len);
+  e->len = len;
+  memcpy(e->data, data, len);
+
+  place(s, e);
+  s->pending++;
+  s->stats.scheduled++;
+  if (s->pending > s->stats.max_pending)
+    s->stats.max_pending = s->pending;
+  return 0;
+}
+
+void osc_sched_run(osc_sched *s, uint64_t now_ns) {
+  uint64_t target = floor_tick(s, now_ns);
+
+  while (s->now_tick <= target) {
+    if (s->pending == 0) {
+      s->now_tick = target + 1;
+      break;
+    }
+
+    uint64_t t = s->now_tick;
+    if ((t & 0xff) == 0) {
+      if ((t & 0xffff) == 0) {
+        if ((t & 0xffffff) == 0)
+          cascade(s, 3, (int)((t >> 24) & 0xff));
+        cascade(s, 2, (int)((t >> 16) & 0xff));
+      }
+      cascade(s, 1, (int)((t >> 8) & 0xff));
+    }
+
+    int idx = (int)(t & 0xff);
+    osc_sched_entry *e;
+    while ((e = s->slots[0][idx])) {
+      unlink_entry(s, 0, idx, e);
+      if (e->due_tick > t) { // clamped far-future entry
+        place(s, e);
+        continue;
+      }
+      s->pending--;
+      s->stats.fired++;
+      record_late(&s->stats, now_ns > e->due_ns ? now_ns - e->due_ns : 0);
+      s->fire(s->ctx, e);
+      free(e);
+    }
+
+    // skip empty slots up to the next occupied one or the next cascade
+    int next = idx < 0xff ? next_occupied(s, 0, idx + 1) : -1;
+    s->now_tick = next >= 0 ? (t & ~0xffull) + (uint64_t)next : (t | 0xff) + 1;
+    if (s->now_tick > target + 1)
+      s->now_tick = target + 1;
+  }
+}
+
+// whether reaching tick t (a multiple of 256) moves entries down a level
+static int cascade_pending(const osc_sched *s, uint64_t t) {
+  for (int level = 1; level < OSC_SCHED_LEVELS; level++) {
+    int idx = (int)((t >> (8 * level)) & 0xff);
+    if (s->occupied[level][idx >> 6] & (1ull << (idx & 63)))
+      return 1;
+    if (idx != 0)
+      break; // higher levels only cascade when this index wraps to 0
+  }
+  return 0;
+}
+
+uint64_t osc_sched_next_deadline(const osc_sched *s) {
+  if (s->pending == 0)
+    return 0;
+  uint64_t t = s->now_tick;
+  if ((t & 0xff) == 0 && cascade_pending(s, t))
+    return s->origin_ns + t * OSC_SCHED_TICK_NS;
+  int next = next_occupied(s, 0, (int)(t & 0xff));
+  uint64_t tick = next >= 0 ? (t & ~0xffull) + (uint64_t)next : (t | 0xff) + 1;
+  return s->origin_ns + tick * OSC_SCHED_TICK_NS;
+}
+
+void osc_sched_clear(osc_sched *s) {
+  for (int level = 0; level < OSC_SCHED_LEVELS; level++) {
+    for (int idx = 0; idx < OSC_SCHED_SLOTS; idx++) {
+      osc_sched_entry *e = s->slots[level][idx];
+      while (e) {
+        osc_sched_entry *next = e->next;
+        free(e);
+        e = next;
+      }
+      s->slots[level][idx] = NULL;
+    }
+  }
+  memset(s->occupied, 0, sizeof(s->occupied));
+  s->pending = 0;
+}
+
+int osc_sched_forget(osc_sched *s, const connectionT *conn) {
+  int n = 0;
+  for (int level = 0; level < OSC_SCHED_LEVELS && s->pending; level++) {
+    for (int idx = 0; idx < OSC_SCHED_SLOTS; idx++) {
+      osc_sched_entry *e = s->slots[level][idx];
+      while (e) {
+        osc_sched_entry *next = e->next;
+        if (e->conn == conn) {
+          unlink_entry(s, level, idx, e);
+          free(e);
+          s->pending--;
+          n++;
+        }
+        e = next;
+      }
+    }
+  }
+  return n;
+}
+
+void osc_sched_print_stats(const osc_sched_stats *st) {
+  printf("sched: %llu immediate, %llu held, %llu fired, %llu dropped, "
+         "max %llu pending\n",
+         (unsigned long long)st->immediate, (unsigned long long)st->scheduled,
+         (unsigned long long)st->fired, (unsigned long long)st->dropped,
+         (unsigned long long)st->max_pending);
+  if (st->fired == 0)
+    return;
+  printf("sched: late by %.1f us mean, %.1f us max\n",
+         st->late_ns_sum / 1000.0 / st->fired, st->late_ns_max / 1000.0);
+  for (int b = 0; b < OSC_SCHED_ERROR_BUCKETS; b++) {
+    if (st->late_hist[b])
+      printf("sched:   < %6llu us: %llu\n", 10ull << b,
+             (unsigned long long)st->late_hist[b]);
+  }
+}
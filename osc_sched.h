@@ -0,0 +1,97 @@
+#ifndef __OSC_SCHED_H__
+#define __OSC_SCHED_H__
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "network.h"
+
+/*
+ * Holds future-dated bundles until their timetag.
+ *
+ * A hierarchical timing wheel of OSC_SCHED_LEVELS x 256 slots with a
+ * OSC_SCHED_TICK_NS tick.  Insert and expiry are O(1); an entry is moved
+ * down at most once per level as the wheel turns.  The owner drives it
+ * with a timerfd armed by osc_sched_next_deadline, so an idle wheel costs
+ * no wakeups.  Entries are never fired early: a timetag is rounded up to
+ * the next tick.
+ */
+
+#define OSC_SCHED_LEVELS       4
+#define OSC_SCHED_SLOTS        256
+#define OSC_SCHED_TICK_NS      250000ull // 0.25 ms
+#define OSC_SCHED_MAX_PENDING  65536
+
+typedef struct osc_sched_entry {
+  struct osc_sched_entry *prev;
+  struct osc_sched_entry *next;
+  uint64_t                due_ns;   // CLOCK_MONOTONIC
+  uint64_t                due_tick;
+  connectionT            *conn;     // listener the bundle arrived on
+  struct sockaddr_storage addr;     // peer, for replies
+  socklen_t               addr_len;
+  uint32_t                len;
+  char                    data[];   // the bundle, copied
+} osc_sched_entry;
+
+typedef void (*osc_sched_fire)(void *ctx, osc_sched_entry *e);
+
+#define OSC_SCHED_ERROR_BUCKETS 16
+
+typedef struct osc_sched_stats {
+  uint64_t immediate; // run on arrival: immediate, past or due this tick
+  uint64_t scheduled; // held in the wheel
+  uint64_t fired;     // held and then run
+  uint64_t dropped;   // wheel full or out of memory
+  uint64_t max_pending;
+  uint64_t late_ns_sum;   // fire time minus timetag, over fired entries
+  uint64_t late_ns_max;
+  // late_hist[i] counts fired entries that were < 2^i * 10us late
+  uint64_t late_hist[OSC_SCHED_ERROR_BUCKETS];
+} osc_sched_stats;
+
+typedef struct osc_sched {
+  osc_sched_entry *slots[OSC_SCHED_LEVELS][OSC_SCHED_SLOTS];
+  uint64_t         occupied[OSC_SCHED_LEVELS][OSC_SCHED_SLOTS / 64];
+  uint64_t         origin_ns; // monotonic time of tick 0
+  uint64_t         now_tick;  // every tick before this has been expired
+  uint32_t         pending;
+  osc_sched_fire   fire;
+  void            *ctx;
+  osc_sched_stats  stats;
+} osc_sched;
+
+void osc_sched_init(osc_sched *s, osc_sched_fire fire, void *ctx);
+
+/* Frees every pending entry without firing it. */
+void osc_sched_clear(osc_sched *s);
+
+/* Frees the pending entries that arrived on conn, which is going away.
+ * Returns how many. */
+int osc_sched_forget(osc_sched *s, const connectionT *conn);
+
+/*
+ * Converts an NTP timetag to CLOCK_MONOTONIC nanoseconds, shifted by
+ * offset_ms. TINYOSC_TIMETAG_IMMEDIATELY and timetags before the Unix
+ * epoch map to 0, meaning "now".
+ */
+uint64_t osc_sched_timetag_to_ns(uint64_t timetag, int offset_ms);
+
+/*
+ * Queues a copy of the bundle to run at due_ns. Returns 1 if it is already
+ * due and the caller should run it now, 0 if it was queued, -1 if dropped.
+ */
+int osc_sched_add(osc_sched *s, uint64_t due_ns, const char *data,
+                  uint32_t len, connectionT *conn);
+
+/* Fires everything due at or before now_ns. */
+void osc_sched_run(osc_sched *s, uint64_t now_ns);
+
+/* Monotonic time the owner's timer should next fire, or 0 if idle. */
+uint64_t osc_sched_next_deadline(const osc_sched *s);
+
+uint64_t osc_sched_now_ns(void);
+
+void osc_sched_print_stats(const osc_sched_stats *st);
+
+#endif
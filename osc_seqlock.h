@@ -0,0 +1,71 @@
+#ifndef __OSC_SEQLOCK_H__
+#define __OSC_SEQLOCK_H__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Sequence lock.  Writers serialize on the sequence itself: a writer moves
+ * it from even to odd with a CAS, writes, then makes it even again.
+ * Readers never block; they copy the data and retry if the sequence was
+ * odd or changed meanwhile.  Suits small, rarely contended records such as
+ * one ConfigSend.
+ */
+
+typedef struct osc_seqlock {
+  _Atomic uint32_t seq;
+} osc_seqlock;
+
+static inline void osc_seqlock_write_begin(osc_seqlock *l) {
+  uint32_t s = atomic_load_explicit(&l->seq, memory_order_relaxed);
+  for (;;) {
+    if ((s & 1) == 0 &&
+        atomic_compare_exchange_weak_explicit(&l->seq, &s, s + 1,
+                                              memory_order_acquire,
+                                              memory_order_relaxed))
+      break;
+    s = atomic_load_explicit(&l->seq, memory_order_relaxed);
+  }
+  atomic_thread_fence(memory_order_release);
+}
+
+static inline void osc_seqlock_write_end(osc_seqlock *l) {
+  atomic_fetch_add_explicit(&l->seq, 1, memory_order_release);
+}
+
+static inline uint32_t osc_seqlock_read_begin(const osc_seqlock *l) {
+  uint32_t s;
+  while ((s = atomic_load_explicit(&((osc_seqlock *)l)->seq,
+                                   memory_order_acquire)) & 1)
+    ;
+  return s;
+}
+
+static inline int osc_seqlock_read_retry(const osc_seqlock *l, uint32_t s) {
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&((osc_seqlock *)l)->seq,
+                              memory_order_relaxed) != s;
+}
+
+/* Assigns expr to dst from one consistent snapshot. */
+#define OSC_SEQLOCK_READ(lock, dst, expr)                                      \
+  do {                                                                         \
+    uint32_t _s;                                                               \
+    do {                                                                       \
+      _s = osc_seqlock_read_begin(lock);                                       \
+      (dst) = (expr);                                                          \
+    } while (osc_seqlock_read_retry(lock, _s));                                \
+  } while (0)
+
+/* Copies n bytes from src to dst as one consistent snapshot. */
+#define OSC_SEQLOCK_COPY(lock, dst, src, n)                                    \
+  do {                                                                         \
+    uint32_t _s;                                                               \
+    do {                                                                       \
+      _s = osc_seqlock_read_begin(lock);                                       \
+      memcpy((dst), (src), (n));                                               \
+    } while (osc_seqlock_read_retry(lock, _s));                                \
+  } while (0)
+
+#endif
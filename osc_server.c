@@ -0,0 +1,680 @@
+#include <ctype.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "osc_config.h"
+#include "osc_frame.h"
+#include "osc_server.h"
+#include "osc_stats.h"
+#include "tinyosc.h"
+
+// the worker running on this thread, for the send callbacks
+static __thread osc_worker *current_worker;
+
+static void on_writable(osc_ev_loop *l, int fd, uint32_t events, void *data);
+
+static bool owns_fd(const osc_worker *w, int fd) {
+  for (int k = 0; k < w->conn_count; k++)
+    if (w->conns[k].con.fd == fd)
+      return true;
+  return false;
+}
+
+// asks the loop for EPOLLOUT on fd while output is queued on it; a socket
+// of another worker (a push from worker 0) gets a watch of its own
+static void watch_writable(osc_worker *w, int fd) {
+  for (int i = 0; i < w->out_fd_count; i++)
+    if (w->out_fds[i] == fd)
+      return;
+  if (w->out_fd_count == OSC_MAX_WORKERS * OSC_LISTEN_MAX)
+    return;
+  w->out_fds[w->out_fd_count++] = fd;
+  if (owns_fd(w, fd))
+    osc_ev_modify(&w->loop, fd, EPOLLIN | EPOLLOUT);
+  else
+    osc_ev_add(&w->loop, fd, EPOLLOUT, on_writable, NULL);
+}
+
+// sends what is queued on fd; stops watching it once nothing is
+static void drain_sessions(osc_worker *w, int fd) {
+  if (osc_session_drain(&w->sessions, fd, &w->stats) > 0)
+    return;
+  for (int i = 0; i < w->out_fd_count; i++) {
+    if (w->out_fds[i] != fd)
+      continue;
+    w->out_fds[i] = w->out_fds[--w->out_fd_count];
+    if (owns_fd(w, fd))
+      osc_ev_modify(&w->loop, fd, EPOLLIN);
+    else
+      osc_ev_remove(&w->loop, fd);
+    return;
+  }
+}
+
+static void on_writable(osc_ev_loop *l, int fd, uint32_t events, void *data) {
+  drain_sessions(current_worker, fd);
+}
+
+// a reply the socket would not take waits in its peer's session
+static ssize_t queue_reply(osc_worker *w, int fd, const struct sockaddr *addr,
+                           socklen_t addr_len, const void *buf, size_t len) {
+  size_t n = osc_session_queue(&w->sessions, fd, addr, addr_len, buf, len);
+  watch_writable(w, fd);
+  return (ssize_t)n;
+}
+
+static void overflow_reply(void *ctx, int fd, const struct sockaddr *addr,
+                           socklen_t addr_len, const void *buf, size_t len) {
+  queue_reply(ctx, fd, addr, addr_len, buf, len);
+}
+
+// whether earlier replies to the peer are still queued, so this one must
+// go behind them
+static bool peer_queued(osc_worker *w, const connectionT *conn) {
+  return osc_session_any(&w->sessions) &&
+         osc_session_find(&w->sessions, conn->con.fd,
+                          (const struct sockaddr *)&conn->con.addr,
+                          conn->con.addr_len);
+}
+
+// debug send wrapper
+
+size_t send_wrapper(connectionT *conn, const void *buf, size_t len) {
+  osc_worker *w = current_worker;
+  uint64_t t0 = osc_stats_now();
+  const struct sockaddr *addr = (struct sockaddr *)&conn->con.addr;
+  if (peer_queued(w, conn)) {
+    ssize_t n = queue_reply(w, conn->con.fd, addr, conn->con.addr_len, buf,
+                            len);
+    if (n > 0) {
+      osc_stats_count(OSC_STAT_SENDS, 1);
+      osc_stats_count(OSC_STAT_BYTES_OUT, len);
+    }
+    osc_stats_note_send(osc_stats_now() - t0);
+    return (size_t)n;
+  }
+  ssize_t sent = sendto(conn->con.fd, buf, len, 0, addr, conn->con.addr_len);
+
+/*  printf("SENDING: ");
+
+  for (int i = 0; i < len; i++) {
+    char c = ((char *)buf)[i];
+    if (isprint(c)) {
+      printf("%c", c);
+    } else {
+      printf("(%02X)", c);
+    }
+  }
+  printf("\n");
+*/
+
+  if (sent >= 0) {
+    w->stats.tx_calls++;
+    w->stats.tx_packets++;
+  } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    sent = queue_reply(w, conn->con.fd, addr, conn->con.addr_len, buf, len);
+  } else {
+    perror("sendto");
+  }
+
+  if (sent > 0) {
+    osc_stats_count(OSC_STAT_SENDS, 1);
+    osc_stats_count(OSC_STAT_BYTES_OUT, (uint64_t)sent);
+  }
+  osc_stats_note_send(osc_stats_now() - t0);
+  return (size_t)sent;
+}
+
+// batched send: queue the reply, flushed with sendmmsg after the batch
+
+size_t send_batched(connectionT *conn, const void *buf, size_t len) {
+  osc_worker *w = current_worker;
+  uint64_t t0 = osc_stats_now();
+  size_t n;
+  if (peer_queued(w, conn))
+    n = (size_t)queue_reply(w, conn->con.fd,
+                            (struct sockaddr *)&conn->con.addr,
+                            conn->con.addr_len, buf, len);
+  else
+    n = osc_io_queue(conn->con.fd, &w->tx, (struct sockaddr *)&conn->con.addr,
+                     conn->con.addr_len, buf, len, &w->stats);
+  if (n > 0) {
+    osc_stats_count(OSC_STAT_SENDS, 1);
+    osc_stats_count(OSC_STAT_BYTES_OUT, (uint64_t)n);
+  }
+  osc_stats_note_send(osc_stats_now() - t0);
+  return n;
+}
+
+// a bundle's SETs reach the same published frame
+static void dispatch_bundle(tosc_bundle *bundle, connectionT *conn) {
+  tosc_message osc;
+  osc_frame_bundle_begin();
+  uint64_t t0 = osc_stats_now();
+  while (tosc_getNextMessage(bundle, &osc)) {
+    osc_stats_note_parse(t0);
+    dispatch_message(&osc, conn);
+    t0 = osc_stats_now();
+  }
+  osc_frame_bundle_end();
+}
+
+// keep sched_fd set to the wheel's next deadline
+static void arm_sched(osc_worker *w) {
+  uint64_t deadline = osc_sched_next_deadline(&w->sched);
+  if (deadline == w->sched_armed_ns)
+    return;
+  if (deadline)
+    osc_ev_set_timer_abs(w->sched_fd, deadline);
+  else
+    osc_ev_set_timer(w->sched_fd, 0, 0);
+  w->sched_armed_ns = deadline;
+}
+
+// a held bundle is due: reply to the peer it came from
+static void fire_bundle(void *ctx, osc_sched_entry *e) {
+  connectionT *conn = e->conn;
+  memcpy(&conn->con.addr, &e->addr, e->addr_len);
+  conn->con.addr_len = e->addr_len;
+  tosc_bundle bundle;
+  tosc_parseBundle(&bundle, e->data, (int)e->len);
+  dispatch_bundle(&bundle, conn);
+}
+
+static void on_sched_timer(osc_ev_loop *l, int fd, uint32_t expirations,
+                           void *data) {
+  osc_worker *w = data;
+  w->sched_armed_ns = 0;
+  osc_sched_run(&w->sched, osc_sched_now_ns());
+  if (w->server->batched)
+    osc_io_flush(&w->tx, &w->stats);
+  arm_sched(w);
+}
+
+// runs on the frame clock thread after each publish: steps the ramps,
+// which the next frame publishes, and has worker 0 push what changed
+static void frame_hook(uint64_t frame, void *ctx) {
+  osc_server *s = ctx;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  dispatch_ramps((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+  osc_ev_wake(&s->workers[0].loop);
+}
+
+// every datagram is recorded and counted, dispatched or not
+static void note_packet(osc_worker *w, char *buffer, int len,
+                        connectionT *conn) {
+  if (w->server->capture)
+    osc_capture_record_packet(w->server->capture, buffer, (uint32_t)len,
+                              &conn->con.addr, conn->con.addr_len);
+  if (w->server->verbose)
+    printf("RECEIVED [%.*s]\n", len, buffer);
+  osc_stats_count(OSC_STAT_PACKETS, 1);
+  osc_stats_count(OSC_STAT_BYTES_IN, (uint64_t)len);
+}
+
+static void process_packet(osc_worker *w, char *buffer, int len,
+                           connectionT *conn) {
+  bool verbose = w->server->verbose;
+  note_packet(w, buffer, len, conn);
+  if (len >= 16 && tosc_isBundle(buffer)) {
+    osc_stats_count(OSC_STAT_BUNDLES, 1);
+    tosc_bundle bundle;
+    tosc_parseBundle(&bundle, buffer, len);
+    uint64_t timetag = tosc_getTimetag(&bundle);
+    if (verbose)
+      printf("Timetag: %llu\n", (unsigned long long)timetag);
+
+    int offset_ms;
+    OSC_SEQLOCK_READ(&config_lock, offset_ms, config.clock_offset);
+    uint64_t due = osc_sched_timetag_to_ns(timetag, offset_ms);
+    int r = osc_sched_add(&w->sched, due, buffer, (uint32_t)len, conn);
+    if (r == 0)
+      arm_sched(w);
+    if (r != 1)
+      return; // held until due, or dropped
+    dispatch_bundle(&bundle, conn);
+  } else {
+    tosc_message osc;
+    uint64_t t0 = osc_stats_now();
+    if (tosc_parseMessageChecked(&osc, buffer, len) != 0) {
+      w->stats.rx_malformed++;
+      osc_stats_count(OSC_STAT_MALFORMED, 1);
+      return;
+    }
+    osc_stats_note_parse(t0);
+    if (verbose)
+      tosc_printOscBuffer(buffer, len);
+    dispatch_message(&osc, conn);
+  }
+}
+
+// every connection's receive: a datagram, or a frame decoded from a stream
+static size_t receive_packet(connectionT *conn, const void *buf, size_t len) {
+  process_packet(current_worker, (char *)buf, (int)len, conn);
+  return len;
+}
+
+static void receive_single(osc_worker *w, connectionT *conn) {
+  char *buffer = w->rx.buf[0];
+  int len;
+  conn->con.addr_len = sizeof(conn->con.addr);
+  while ((len = (int)recvfrom(conn->con.fd, buffer, OSC_IO_SLOT_SIZE, 0,
+                              (struct sockaddr *)&conn->con.addr,
+                              &conn->con.addr_len)) > 0) {
+    w->stats.rx_calls++;
+    w->stats.rx_packets++;
+    conn->receive(conn, buffer, (size_t)len);
+    conn->con.addr_len = sizeof(conn->con.addr);
+  }
+}
+
+// a SET the ingest scan parsed and keyed; one that a later SET in the
+// batch overwrites is only recorded and counted
+static void receive_set(osc_worker *w, int i, connectionT *conn) {
+  osc_ingest *g = &w->ingest;
+  char *buffer = w->rx.buf[i];
+  int len = (int)w->rx.hdr[i].msg_len;
+  note_packet(w, buffer, len, conn);
+  if (g->kind[i] == OSC_INGEST_SUPERSEDED) {
+    osc_stats_count(OSC_STAT_COLLAPSED, 1);
+    return;
+  }
+  if (w->server->verbose)
+    tosc_printOscBuffer(buffer, len);
+  dispatch_set(&g->msg[i], g->field[i], g->parse_ticks[i], g->match_ticks[i],
+               conn);
+}
+
+// each batch is scanned first so that a run of SETs of one field is
+// applied once, with the newest value
+static void receive_batched(osc_worker *w, connectionT *conn) {
+  osc_rx_ring *ring = &w->rx;
+  int n;
+  while ((n = osc_io_recv_batch(conn->con.fd, ring, &w->stats)) > 0) {
+    osc_ingest_scan(&w->ingest, ring, n, dispatch_set_field);
+    for (int i = 0; i < n; i++) {
+      unsigned int len = ring->hdr[i].msg_len;
+      if (len == 0)
+        continue;
+      memcpy(&conn->con.addr, &ring->addr[i],
+             ring->hdr[i].msg_hdr.msg_namelen);
+      conn->con.addr_len = ring->hdr[i].msg_hdr.msg_namelen;
+      if (w->ingest.kind[i] == OSC_INGEST_OTHER)
+        conn->receive(conn, ring->buf[i], len);
+      else
+        receive_set(w, i, conn);
+    }
+    osc_io_flush(&w->tx, &w->stats);
+  }
+}
+
+// edge-triggered: both receive paths drain the socket before returning;
+// EPOLLOUT is only asked for while replies are queued on it
+static void on_readable(osc_ev_loop *l, int fd, uint32_t events, void *data) {
+  osc_worker *w = current_worker;
+  if (events & EPOLLOUT)
+    drain_sessions(w, fd);
+  if (!(events & ~EPOLLOUT))
+    return;
+  if (w->server->batched)
+    receive_batched(w, data);
+  else
+    receive_single(w, data);
+}
+
+// a reply on a TCP connection: framed, and queued if the socket is full
+static size_t send_stream(connectionT *conn, const void *buf, size_t len) {
+  osc_stream_conn *sc = (osc_stream_conn *)conn;
+  osc_worker *w = current_worker;
+  if (!sc->open || sc->failed)
+    return 0;
+  uint64_t t0 = osc_stats_now();
+  ssize_t n = osc_stream_send(conn->con.fd, sc->framing, &sc->tx, buf, len,
+                              &w->stream_stats);
+  if (n < 0) {
+    sc->failed = true; // closed by whoever is reading it
+    n = 0;
+  }
+  if (n > 0) {
+    osc_stats_count(OSC_STAT_SENDS, 1);
+    osc_stats_count(OSC_STAT_BYTES_OUT, len);
+  }
+  osc_stats_note_send(osc_stats_now() - t0);
+  return (size_t)n;
+}
+
+static void close_stream(osc_worker *w, osc_stream_conn *sc) {
+  osc_ev_remove(&w->loop, sc->conn.con.fd);
+  dispatch_forget(&sc->conn);
+  if (osc_sched_forget(&w->sched, &sc->conn))
+    arm_sched(w);
+  close(sc->conn.con.fd);
+  osc_stream_decoder_free(&sc->rx);
+  osc_stream_out_free(&sc->tx);
+  sc->conn.con.fd = -1;
+  sc->open = false;
+  w->stream_stats.closed++;
+}
+
+// edge-triggered: flushes the queue once the socket has room again, then
+// reads until EAGAIN, each read fed to the decoder as it comes
+static void on_stream(osc_ev_loop *l, int fd, uint32_t events, void *data) {
+  osc_worker *w = current_worker;
+  osc_stream_conn *sc = data;
+  bool done = sc->failed;
+  if ((events & EPOLLOUT) && osc_stream_out_pending(&sc->tx) &&
+      osc_stream_flush(fd, &sc->tx) < 0)
+    done = true;
+
+  char *buf = w->rx.buf[0]; // one slot; the ring is idle meanwhile
+  while (!done) {
+    ssize_t n = recv(fd, buf, sizeof(w->rx.buf[0]), 0);
+    if (n > 0) {
+      w->stats.rx_calls++;
+      done = osc_stream_feed(&sc->rx, buf, (size_t)n, &sc->conn,
+                             &w->stream_stats) < 0 || sc->failed;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    done = true; // closed by the peer, or reset
+  }
+  if (done)
+    close_stream(w, sc);
+}
+
+static int open_stream(osc_worker *w, osc_stream_conn *sc, int fd,
+                       osc_stream_framing f,
+                       const struct sockaddr_storage *addr,
+                       socklen_t addr_len) {
+  if (osc_stream_decoder_init(&sc->rx, f) < 0 ||
+      osc_stream_out_init(&sc->tx) < 0) {
+    osc_stream_decoder_free(&sc->rx);
+    osc_stream_out_free(&sc->tx);
+    return -1;
+  }
+  // replies are small and wanted now
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  sc->conn.con.fd = fd;
+  memcpy(&sc->conn.con.addr, addr, addr_len);
+  sc->conn.con.addr_len = addr_len;
+  sc->conn.send = send_stream;
+  sc->conn.receive = receive_packet;
+  sc->framing = f;
+  sc->failed = false;
+  if (osc_ev_add(&w->loop, fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, on_stream,
+                 sc) < 0) {
+    osc_stream_decoder_free(&sc->rx);
+    osc_stream_out_free(&sc->tx);
+    return -1;
+  }
+  sc->open = true;
+  return 0;
+}
+
+static void on_accept(osc_ev_loop *l, int fd, uint32_t events, void *data) {
+  osc_worker *w = current_worker;
+  osc_stream_listener *ls = data;
+  for (;;) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int c = accept4(fd, (struct sockaddr *)&addr, &addr_len,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (c < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        perror("accept4");
+      return;
+    }
+    osc_stream_conn *sc = NULL;
+    for (int i = 0; i < OSC_STREAM_MAX_CONNS && !sc; i++)
+      if (!w->streams[i].open)
+        sc = &w->streams[i];
+    if (!sc || open_stream(w, sc, c, ls->framing, &addr, addr_len) < 0) {
+      w->stream_stats.refused++;
+      close(c);
+      continue;
+    }
+    w->stream_stats.accepted++;
+  }
+}
+
+// a push to a subscriber that came over TCP goes through its stream
+static size_t send_push(connectionT *via, const void *buf, size_t len) {
+  osc_worker *w = current_worker;
+  for (int i = 0; i < OSC_STREAM_MAX_CONNS; i++) {
+    osc_stream_conn *sc = &w->streams[i];
+    if (sc->open && sc->conn.con.fd == via->con.fd)
+      return send_stream(&sc->conn, buf, len);
+  }
+  return w->server->batched ? send_batched(via, buf, len)
+                            : send_wrapper(via, buf, len);
+}
+
+static void close_failed_streams(osc_worker *w) {
+  for (int i = 0; i < OSC_STREAM_MAX_CONNS; i++)
+    if (w->streams[i].open && w->streams[i].failed)
+      close_stream(w, &w->streams[i]);
+}
+
+// the frame clock woke worker 0: push the frame's changes to subscribers
+static void on_frame(osc_ev_loop *l, int fd, uint32_t count, void *data) {
+  osc_worker *w = data;
+  connectionT via = {0};
+  via.send = w->server->batched ? send_batched : send_wrapper;
+  if (w->listener_count)
+    via.send = send_push;
+  if (dispatch_push(&via) > 0 && w->server->batched)
+    osc_io_flush(&w->tx, &w->stats);
+  if (w->listener_count)
+    close_failed_streams(w);
+}
+
+static void *worker_main(void *arg) {
+  osc_worker *w = arg;
+  current_worker = w;
+  osc_ev_run(&w->loop);
+  return NULL;
+}
+
+int osc_server_open(osc_server *s, const char **specs, int spec_count,
+                    int workers, bool batched) {
+  if (workers < 1 || workers > OSC_MAX_WORKERS) {
+    fprintf(stderr, "worker count must be 1..%d\n", OSC_MAX_WORKERS);
+    return -1;
+  }
+
+  s->workers = calloc(workers, sizeof(osc_worker));
+  if (!s->workers)
+    return -1;
+  s->worker_count = 0; // counts initialized workers, for osc_server_close
+  s->batched = batched;
+
+  int flags = workers > 1 ? OSC_LISTEN_REUSEPORT : 0;
+  for (int i = 0; i < workers; i++) {
+    osc_worker *w = &s->workers[i];
+    w->id = i;
+    w->server = s;
+    osc_rx_ring_init(&w->rx);
+    osc_session_init(&w->sessions);
+    osc_ingest_init(&w->ingest);
+    w->tx.overflow = overflow_reply;
+    w->tx.overflow_ctx = w;
+    if (osc_ev_init(&w->loop) < 0)
+      return -1;
+    s->worker_count++;
+    osc_sched_init(&w->sched, fire_bundle, w);
+    w->sched_fd = osc_ev_add_timer(&w->loop, 0, 0, on_sched_timer, w);
+    if (w->sched_fd < 0)
+      return -1;
+    if (i == 0)
+      osc_ev_on_wake(&w->loop, on_frame, w);
+
+    for (int k = 0; k < spec_count; k++) {
+      connectionT *conn = &w->conns[k];
+      conn->send = batched ? send_batched : send_wrapper;
+      conn->receive = receive_packet;
+      conn->con.fd = osc_listen_open(specs[k], SOCK_DGRAM, flags);
+      if (conn->con.fd < 0)
+        return -1;
+      w->conn_count++;
+      if (osc_ev_add(&w->loop, conn->con.fd, EPOLLIN, on_readable, conn) < 0)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+int osc_server_listen_stream(osc_server *s, const char *spec,
+                             osc_stream_framing f) {
+  osc_worker *w = &s->workers[0];
+  if (w->listener_count == OSC_LISTEN_MAX) {
+    fprintf(stderr, "at most %d TCP listen addresses\n", OSC_LISTEN_MAX);
+    return -1;
+  }
+  osc_stream_listener *ls = &w->listeners[w->listener_count];
+  ls->fd = osc_listen_open(spec, SOCK_STREAM, 0);
+  if (ls->fd < 0)
+    return -1;
+  ls->framing = f;
+  w->listener_count++;
+  return osc_ev_add(&w->loop, ls->fd, EPOLLIN, on_accept, ls);
+}
+
+int osc_server_run(osc_server *s) {
+  if (osc_frame_start(frame_hook, s) < 0)
+    fprintf(stderr, "frame clock did not start; nothing is published\n");
+
+  for (int i = 1; i < s->worker_count; i++) {
+    osc_worker *w = &s->workers[i];
+    if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+      perror("pthread_create");
+      osc_server_stop(s);
+      s->worker_count = i;
+      break;
+    }
+  }
+
+  worker_main(&s->workers[0]);
+
+  for (int i = 1; i < s->worker_count; i++)
+    pthread_join(s->workers[i].thread, NULL);
+  osc_frame_stop();
+  return 0;
+}
+
+void osc_server_stop(osc_server *s) {
+  for (int i = 0; i < s->worker_count; i++)
+    osc_ev_stop(&s->workers[i].loop);
+}
+
+void osc_server_stats(const osc_server *s, osc_io_stats *total) {
+  memset(total, 0, sizeof(*total));
+  for (int i = 0; i < s->worker_count; i++) {
+    const osc_io_stats *st = &s->workers[i].stats;
+    total->rx_packets += st->rx_packets;
+    total->rx_calls += st->rx_calls;
+    total->rx_malformed += st->rx_malformed;
+    total->tx_packets += st->tx_packets;
+    total->tx_calls += st->tx_calls;
+    total->tx_dropped += st->tx_dropped;
+  }
+}
+
+void osc_server_session_stats(const osc_server *s, osc_session_stats *total) {
+  memset(total, 0, sizeof(*total));
+  for (int i = 0; i < s->worker_count; i++) {
+    const osc_session_stats *st = &s->workers[i].sessions.stats;
+    total->queued += st->queued;
+    total->sent += st->sent;
+    total->coalesced += st->coalesced;
+    total->dropped += st->dropped;
+    total->sessions += st->sessions;
+    if (st->max_peers > total->max_peers)
+      total->max_peers = st->max_peers;
+  }
+}
+
+void osc_server_ingest_stats(const osc_server *s, osc_ingest_stats *total) {
+  memset(total, 0, sizeof(*total));
+  for (int i = 0; i < s->worker_count; i++) {
+    const osc_ingest_stats *st = &s->workers[i].ingest.stats;
+    total->batches += st->batches;
+    total->sets += st->sets;
+    total->collapsed += st->collapsed;
+    total->barriers += st->barriers;
+  }
+}
+
+void osc_server_sched_stats(const osc_server *s, osc_sched_stats *total) {
+  memset(total, 0, sizeof(*total));
+  for (int i = 0; i < s->worker_count; i++) {
+    const osc_sched_stats *st = &s->workers[i].sched.stats;
+    total->immediate += st->immediate;
+    total->scheduled += st->scheduled;
+    total->fired += st->fired;
+    total->dropped += st->dropped;
+    if (st->max_pending > total->max_pending)
+      total->max_pending = st->max_pending;
+    total->late_ns_sum += st->late_ns_sum;
+    if (st->late_ns_max > total->late_ns_max)
+      total->late_ns_max = st->late_ns_max;
+    for (int b = 0; b < OSC_SCHED_ERROR_BUCKETS; b++)
+      total->late_hist[b] += st->late_hist[b];
+  }
+}
+
+void osc_server_stream_stats(const osc_server *s, osc_stream_stats *total) {
+  memset(total, 0, sizeof(*total));
+  for (int i = 0; i < s->worker_count; i++) {
+    const osc_stream_stats *st = &s->workers[i].stream_stats;
+    total->accepted += st->accepted;
+    total->closed += st->closed;
+    total->refused += st->refused;
+    total->frames_in += st->frames_in;
+    total->frames_out += st->frames_out;
+    total->oversized += st->oversized;
+    total->queued += st->queued;
+    total->dropped += st->dropped;
+    if (st->max_queued > total->max_queued)
+      total->max_queued = st->max_queued;
+  }
+}
+
+void osc_server_close(osc_server *s) {
+  for (int i = 0; i < s->worker_count; i++) {
+    osc_worker *w = &s->workers[i];
+    osc_sched_clear(&w->sched);
+    osc_session_clear(&w->sessions);
+    for (int k = 0; k < w->conn_count; k++)
+      close(w->conns[k].con.fd);
+    for (int k = 0; k < w->listener_count; k++)
+      close(w->listeners[k].fd);
+    for (int k = 0; k < OSC_STREAM_MAX_CONNS; k++) {
+      osc_stream_conn *sc = &w->streams[k];
+      if (!sc->open)
+        continue;
+      close(sc->conn.con.fd);
+      osc_stream_decoder_free(&sc->rx);
+      osc_stream_out_free(&sc->tx);
+      sc->open = false;
+    }
+    osc_ev_close(&w->loop);
+  }
+  free(s->workers);
+  s->workers = NULL;
+  s->worker_count = 0;
+}
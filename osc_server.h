@@ -0,0 +1,121 @@
+#ifndef __OSC_SERVER_H__
+#define __OSC_SERVER_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "network.h"
+#include "osc_capture.h"
+#include "osc_event.h"
+#include "osc_ingest.h"
+#include "osc_io.h"
+#include "osc_listen.h"
+#include "osc_sched.h"
+#include "osc_session.h"
+#include "osc_stream.h"
+
+#define OSC_MAX_WORKERS       16
+#define OSC_STREAM_MAX_CONNS  16 // TCP connections at once
+
+/*
+ * Receive workers.  Each worker owns an epoll loop and one socket per
+ * listen address, so it parses and dispatches without sharing anything but
+ * config (see the seqlocks in osc_config.h).  With more than one worker
+ * the sockets are opened with SO_REUSEPORT and the kernel spreads peers
+ * across them.  The frame clock (osc_frame.h) wakes worker 0 once per
+ * frame to push changes to subscribers.
+ *
+ * No send waits for a socket: what a full socket refuses is queued per
+ * peer (osc_session.h) and sent when epoll reports it writable, so a slow
+ * peer costs its own replies and nobody else's.
+ *
+ * With batched receive, a batch's SETs of one field collapse into the
+ * newest (osc_ingest.h) before it is dispatched.
+ *
+ * TCP listeners (osc_stream.h) belong to worker 0 alone, so each
+ * connection's output queue has a single writer, the thread that also
+ * pushes to subscribers.  A datagram and a decoded stream frame both reach
+ * dispatch through their connection's receive, and replies leave through
+ * its send.
+ */
+
+struct osc_server;
+
+typedef struct osc_stream_listener {
+  int                fd;
+  osc_stream_framing framing;
+} osc_stream_listener;
+
+typedef struct osc_stream_conn {
+  connectionT        conn; // first: send and receive are handed this
+  bool               open;
+  bool               failed; // a send failed; closed once the read is done
+  osc_stream_framing framing;
+  osc_stream_decoder rx;
+  osc_stream_out     tx;
+} osc_stream_conn;
+
+typedef struct osc_worker {
+  int                 id;
+  pthread_t           thread;
+  struct osc_server  *server;
+  osc_ev_loop         loop;
+  connectionT         conns[OSC_LISTEN_MAX];
+  int                 conn_count;
+  osc_rx_ring         rx;
+  osc_tx_queue        tx;
+  osc_io_stats        stats;
+  osc_ingest          ingest;         // last-writer-wins over each batch
+  osc_session_table   sessions;       // peers whose replies are queued
+  int                 out_fds[OSC_MAX_WORKERS * OSC_LISTEN_MAX]; // EPOLLOUT
+  int                 out_fd_count;
+  osc_sched           sched;          // bundles waiting for their timetag
+  int                 sched_fd;       // timerfd driving sched
+  uint64_t            sched_armed_ns; // deadline sched_fd is set to, or 0
+  osc_stream_listener listeners[OSC_LISTEN_MAX]; // TCP, worker 0 only
+  int                 listener_count;
+  osc_stream_conn     streams[OSC_STREAM_MAX_CONNS];
+  osc_stream_stats    stream_stats;
+} osc_worker;
+
+typedef struct osc_server {
+  osc_worker *workers;
+  int         worker_count;
+  bool        batched;
+  bool        verbose; // print every received packet
+  osc_capture *capture; // records every received datagram, if not NULL
+} osc_server;
+
+/* Opens the sockets and loops of all workers. Returns 0 or -1. */
+int osc_server_open(osc_server *s, const char **specs, int spec_count,
+                    int workers, bool batched);
+
+/* Adds a TCP listener to worker 0, framed as f. Returns 0 or -1. */
+int osc_server_listen_stream(osc_server *s, const char *spec,
+                             osc_stream_framing f);
+
+/* Starts the frame clock, runs worker 0 on the calling thread and the rest
+ * on their own threads; returns once all of them have stopped. */
+int osc_server_run(osc_server *s);
+
+/* Stops every worker; safe from a signal handler. */
+void osc_server_stop(osc_server *s);
+
+/* Sums the I/O counters of all workers. */
+void osc_server_stats(const osc_server *s, osc_io_stats *total);
+
+/* Sums the per-peer output queue counters of all workers. */
+void osc_server_session_stats(const osc_server *s, osc_session_stats *total);
+
+/* Sums the receive batch coalescing counters of all workers. */
+void osc_server_ingest_stats(const osc_server *s, osc_ingest_stats *total);
+
+/* Sums the bundle scheduler counters of all workers. */
+void osc_server_sched_stats(const osc_server *s, osc_sched_stats *total);
+
+/* Sums the TCP counters of all workers. */
+void osc_server_stream_stats(const osc_server *s, osc_stream_stats *total);
+
+void osc_server_close(osc_server *s);
+
+#endif
@@ -0,0 +1,218 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc_session.h"
+
+#define BUCKET_MASK (OSC_SESSION_BUCKETS - 1)
+
+void osc_session_init(osc_session_table *t) {
+  memset(t, 0, sizeof(*t));
+  for (int i = 0; i < OSC_SESSION_BUCKETS; i++)
+    t->bucket[i] = -1;
+}
+
+// FNV-1a over the socket and the address
+static uint32_t peer_hash(int fd, const struct sockaddr *addr,
+                          socklen_t addr_len) {
+  uint32_t h = 2166136261u ^ (uint32_t)fd;
+  const uint8_t *p = (const uint8_t *)addr;
+  for (socklen_t i = 0; i < addr_len; i++)
+    h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+static bool same_peer(const osc_session *s, int fd,
+                      const struct sockaddr *addr, socklen_t addr_len) {
+  return s->fd == fd && s->addr_len == addr_len &&
+         memcmp(&s->addr, addr, addr_len) == 0;
+}
+
+static osc_session *lookup(osc_session_table *t, uint32_t h, int fd,
+                           const struct sockaddr *addr, socklen_t addr_len) {
+  // never full: there are twice as many buckets as sessions
+  for (uint32_t i = h & BUCKET_MASK;; i = (i + 1) & BUCKET_MASK) {
+    if (t->bucket[i] < 0)
+      return NULL;
+    osc_session *s = &t->sessions[t->bucket[i]];
+    if (s->hash == h && same_peer(s, fd, addr, addr_len))
+      return s;
+  }
+}
+
+osc_session *osc_session_find(osc_session_table *t, int fd,
+                              const struct sockaddr *addr,
+                              socklen_t addr_len) {
+  if (t->count == 0)
+    return NULL;
+  return lookup(t, peer_hash(fd, addr, addr_len), fd, addr, addr_len);
+}
+
+static osc_session *create(osc_session_table *t, uint32_t h, int fd,
+                           const struct sockaddr *addr, socklen_t addr_len) {
+  if (t->count == OSC_SESSION_MAX)
+    return NULL;
+  int idx = 0;
+  while (t->sessions[idx].slot)
+    idx++;
+  osc_session *s = &t->sessions[idx];
+  s->slot = malloc(OSC_SESSION_DEPTH * sizeof(*s->slot));
+  if (!s->slot)
+    return NULL;
+  s->fd = fd;
+  memcpy(&s->addr, addr, addr_len);
+  s->addr_len = addr_len;
+  s->hash = h;
+  s->head = 0;
+  s->count = 0;
+
+  uint32_t i = h & BUCKET_MASK;
+  while (t->bucket[i] >= 0)
+    i = (i + 1) & BUCKET_MASK;
+  t->bucket[i] = (int16_t)idx;
+  t->count++;
+  t->stats.sessions++;
+  if ((uint64_t)t->count > t->stats.max_peers)
+    t->stats.max_peers = (uint64_t)t->count;
+  return s;
+}
+
+// whether home lies in the cyclic range (from, to]
+static bool between(uint32_t home, uint32_t from, uint32_t to) {
+  return from < to ? home > from && home <= to : home > from || home <= to;
+}
+
+// frees a drained session; later entries of its probe run shift back so
+// lookups need no tombstones
+static void destroy(osc_session_table *t, osc_session *s) {
+  int idx = (int)(s - t->sessions);
+  uint32_t i = s->hash & BUCKET_MASK;
+  while (t->bucket[i] != idx)
+    i = (i + 1) & BUCKET_MASK;
+  for (uint32_t j = (i + 1) & BUCKET_MASK; t->bucket[j] >= 0;
+       j = (j + 1) & BUCKET_MASK) {
+    uint32_t home = t->sessions[t->bucket[j]].hash & BUCKET_MASK;
+    if (!between(home, i, j)) {
+      t->bucket[i] = t->bucket[j];
+      i = j;
+    }
+  }
+  t->bucket[i] = -1;
+  free(s->slot);
+  s->slot = NULL;
+  t->count--;
+}
+
+void osc_session_clear(osc_session_table *t) {
+  for (int i = 0; i < OSC_SESSION_MAX; i++)
+    free(t->sessions[i].slot);
+  osc_session_stats stats = t->stats;
+  osc_session_init(t);
+  t->stats = stats;
+}
+
+// the newest queued message to the same OSC address as buf, or -1; a
+// bundle is never coalesced
+static int coalesce_slot(const osc_session *s, const char *buf, size_t len) {
+  size_t alen = strnlen(buf, len);
+  if (buf[0] != '/' || alen == len)
+    return -1;
+  for (int n = s->count - 1; n >= 0; n--) {
+    int k = (s->head + n) % OSC_SESSION_DEPTH;
+    if (s->len[k] > alen && memcmp(s->slot[k], buf, alen + 1) == 0)
+      return k;
+  }
+  return -1;
+}
+
+size_t osc_session_queue(osc_session_table *t, int fd,
+                         const struct sockaddr *addr, socklen_t addr_len,
+                         const void *buf, size_t len) {
+  if (len == 0 || len > OSC_IO_SLOT_SIZE ||
+      addr_len > sizeof(struct sockaddr_storage)) {
+    t->stats.dropped++;
+    return 0;
+  }
+  uint32_t h = peer_hash(fd, addr, addr_len);
+  osc_session *s = t->count ? lookup(t, h, fd, addr, addr_len) : NULL;
+  if (!s && !(s = create(t, h, fd, addr, addr_len))) {
+    t->stats.dropped++;
+    return 0;
+  }
+
+  int k;
+  if (s->count < OSC_SESSION_DEPTH) {
+    k = (s->head + s->count++) % OSC_SESSION_DEPTH;
+    t->stats.queued++;
+  } else if ((k = coalesce_slot(s, buf, len)) >= 0) {
+    t->stats.coalesced++;
+  } else {
+    t->stats.dropped++;
+    return 0;
+  }
+  memcpy(s->slot[k], buf, len);
+  s->len[k] = (uint16_t)len;
+  return len;
+}
+
+// sends s's queue with one sendmmsg; returns false once the socket is full
+static bool drain_one(osc_session_table *t, osc_session *s, osc_io_stats *io) {
+  struct mmsghdr hdr[OSC_SESSION_DEPTH];
+  struct iovec iov[OSC_SESSION_DEPTH];
+  while (s->count) {
+    memset(hdr, 0, sizeof(hdr[0]) * s->count);
+    for (int n = 0; n < s->count; n++) {
+      int k = (s->head + n) % OSC_SESSION_DEPTH;
+      iov[n].iov_base = s->slot[k];
+      iov[n].iov_len = s->len[k];
+      hdr[n].msg_hdr.msg_iov = &iov[n];
+      hdr[n].msg_hdr.msg_iovlen = 1;
+      hdr[n].msg_hdr.msg_name = &s->addr;
+      hdr[n].msg_hdr.msg_namelen = s->addr_len;
+    }
+    int sent = sendmmsg(s->fd, hdr, s->count, MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return false;
+      t->stats.dropped++; // undeliverable: skip it, keep the rest
+      sent = 1;
+    } else {
+      io->tx_calls++;
+      io->tx_packets += (uint64_t)sent;
+      t->stats.sent += (uint64_t)sent;
+    }
+    s->head = (uint16_t)((s->head + sent) % OSC_SESSION_DEPTH);
+    s->count = (uint16_t)(s->count - sent);
+  }
+  return true;
+}
+
+int osc_session_drain(osc_session_table *t, int fd, osc_io_stats *io) {
+  int left = 0;
+  bool writable = true;
+  int start = t->cursor++ % OSC_SESSION_MAX;
+  for (int n = 0; n < OSC_SESSION_MAX; n++) {
+    osc_session *s = &t->sessions[(start + n) % OSC_SESSION_MAX];
+    if (!s->slot || s->fd != fd)
+      continue;
+    if (writable)
+      writable = drain_one(t, s, io);
+    if (s->count == 0)
+      destroy(t, s);
+    else
+      left++;
+  }
+  return left;
+}
+
+void osc_session_print_stats(const osc_session_stats *st) {
+  printf("sessions: %llu datagrams queued, %llu sent late, %llu coalesced, "
+         "%llu dropped; %llu sessions, max %llu peers at once\n",
+         (unsigned long long)st->queued, (unsigned long long)st->sent,
+         (unsigned long long)st->coalesced, (unsigned long long)st->dropped,
+         (unsigned long long)st->sessions,
+         (unsigned long long)st->max_peers);
+}
@@ -0,0 +1,92 @@
+#ifndef __OSC_SESSION_H__
+#define __OSC_SESSION_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "osc_io.h"
+
+/*
+ * Per-peer output queues for the UDP sockets, so that no send waits.  A
+ * reply the socket will not take now is queued for its peer, and the
+ * owner drains the queues on fd once the socket is writable again.
+ *
+ * A peer, keyed by socket and address, gets a session the first time its
+ * output has to be queued and loses it once the queue is empty, so while
+ * the sockets keep up the table is empty and a send is one sendto.  While
+ * a peer has a session, its later replies queue behind the earlier ones
+ * and stay in order.  Each queue holds OSC_SESSION_DEPTH datagrams; when
+ * it is full a message replaces a queued one to the same OSC address
+ * (coalesced: the peer gets the newer value only), and otherwise it is
+ * dropped.  Both are counted; one slow peer never holds up another.
+ *
+ * A table belongs to one worker thread and is not locked.
+ */
+
+#define OSC_SESSION_MAX      64  // peers with output queued at once
+#define OSC_SESSION_BUCKETS  128 // open addressing, a power of 2
+#define OSC_SESSION_DEPTH    16  // datagrams per peer
+
+typedef struct osc_session {
+  int                     fd;
+  struct sockaddr_storage addr;
+  socklen_t               addr_len;
+  uint32_t                hash;
+  uint16_t                head;  // oldest queued slot
+  uint16_t                count;
+  uint16_t                len[OSC_SESSION_DEPTH];
+  char                  (*slot)[OSC_IO_SLOT_SIZE]; // NULL when free
+} osc_session;
+
+typedef struct osc_session_stats {
+  uint64_t queued;    // datagrams the socket did not take at once
+  uint64_t sent;      // queued datagrams sent once it was writable
+  uint64_t coalesced; // replaced by a newer message to the same address
+  uint64_t dropped;   // queue full with nothing to coalesce, or no session
+  uint64_t sessions;  // created
+  uint64_t max_peers; // with output queued at once
+} osc_session_stats;
+
+typedef struct osc_session_table {
+  int16_t           bucket[OSC_SESSION_BUCKETS]; // session index, or -1
+  osc_session       sessions[OSC_SESSION_MAX];
+  int               count;
+  int               cursor; // where the next drain starts, for fairness
+  osc_session_stats stats;
+} osc_session_table;
+
+void osc_session_init(osc_session_table *t);
+
+/* Frees every queue without sending it. */
+void osc_session_clear(osc_session_table *t);
+
+/* The session of the peer at addr on fd, or NULL if its output is not
+ * queued. */
+osc_session *osc_session_find(osc_session_table *t, int fd,
+                              const struct sockaddr *addr,
+                              socklen_t addr_len);
+
+/* Whether any peer has output queued; the send path's only cost while
+ * every socket keeps up. */
+static inline bool osc_session_any(const osc_session_table *t) {
+  return t->count != 0;
+}
+
+/*
+ * Queues a datagram behind the peer's earlier output, creating its
+ * session. Returns len if it was queued or coalesced, 0 if dropped.
+ */
+size_t osc_session_queue(osc_session_table *t, int fd,
+                         const struct sockaddr *addr, socklen_t addr_len,
+                         const void *buf, size_t len);
+
+/*
+ * Sends the datagrams queued on fd, oldest first per peer, until the
+ * socket is full. Returns the number of peers still queued on fd.
+ */
+int osc_session_drain(osc_session_table *t, int fd, osc_io_stats *io);
+
+void osc_session_print_stats(const osc_session_stats *st);
+
+#endif
@@ -0,0 +1,156 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc_stats.h"
+
+__thread osc_stats_shard *osc_stats_mine;
+
+static _Atomic(osc_stats_shard *) shards[OSC_STATS_MAX_SHARDS];
+static _Atomic int      shard_count;
+// threads past OSC_STATS_MAX_SHARDS share this one and may lose counts
+static osc_stats_shard  overflow;
+
+static pthread_mutex_t  reset_lock = PTHREAD_MUTEX_INITIALIZER;
+static osc_stats_shard  baseline; // sums at the last reset
+
+// osc_stats_now and CLOCK_MONOTONIC at init, to turn ticks into ns
+static uint64_t         ticks0, mono0;
+
+static const char *counter_names[OSC_STAT_COUNTERS] = {
+    "packets",  "bundles",   "messages",        "bytes_in",
+    "bytes_out", "sends",    "malformed",       "invalid_address",
+    "format_mismatch", "collapsed"};
+
+static const char *phase_names[OSC_PHASE_COUNT] = {"parse", "match",
+                                                    "handler", "send"};
+
+static uint64_t mono_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void osc_stats_init(void) {
+  if (mono0)
+    return;
+  ticks0 = osc_stats_now();
+  mono0 = mono_ns();
+}
+
+osc_stats_shard *osc_stats_shard_new(void) {
+  osc_stats_shard *s = NULL;
+  int i = atomic_fetch_add(&shard_count, 1);
+  if (i < OSC_STATS_MAX_SHARDS)
+    s = calloc(1, sizeof(*s));
+  if (s)
+    atomic_store_explicit(&shards[i], s, memory_order_release);
+  else
+    s = &overflow;
+  osc_stats_mine = s;
+  return s;
+}
+
+// every shard there is, the overflow one last
+static int all_shards(osc_stats_shard **out) {
+  int n = atomic_load(&shard_count);
+  int k = 0;
+  for (int i = 0; i < n && i < OSC_STATS_MAX_SHARDS; i++) {
+    osc_stats_shard *s =
+        atomic_load_explicit(&shards[i], memory_order_acquire);
+    if (s)
+      out[k++] = s;
+  }
+  out[k++] = &overflow;
+  return k;
+}
+
+static uint64_t load(const _Atomic uint64_t *v) {
+  return atomic_load_explicit((_Atomic uint64_t *)v, memory_order_relaxed);
+}
+
+uint64_t osc_stats_counter(osc_stat_counter c) {
+  osc_stats_shard *s[OSC_STATS_MAX_SHARDS + 1];
+  int n = all_shards(s);
+  uint64_t sum = 0;
+  // a reset between the sums and the baseline would take more off
+  pthread_mutex_lock(&reset_lock);
+  for (int i = 0; i < n; i++)
+    sum += load(&s[i]->counter[c]);
+  sum -= load(&baseline.counter[c]);
+  pthread_mutex_unlock(&reset_lock);
+  return sum;
+}
+
+// the highest value that lands in bucket b
+static uint64_t bucket_top(int b) {
+  if (b < (1 << OSC_HIST_SUB_BITS))
+    return (uint64_t)b;
+  int e = (b >> OSC_HIST_SUB_BITS) + OSC_HIST_SUB_BITS - 1;
+  uint64_t sub = (uint64_t)(b & ((1 << OSC_HIST_SUB_BITS) - 1));
+  uint64_t width = 1ull << (e - OSC_HIST_SUB_BITS);
+  return ((1ull << e) + sub * width) + width - 1;
+}
+
+void osc_stats_summary(int entry, osc_stat_phase phase, osc_hist_summary *out) {
+  uint64_t counts[OSC_HIST_BUCKETS] = {0};
+  memset(out, 0, sizeof(*out));
+  if ((unsigned)entry >= OSC_STATS_MAX_ENTRIES)
+    return;
+
+  osc_stats_shard *s[OSC_STATS_MAX_SHARDS + 1];
+  int n = all_shards(s);
+  pthread_mutex_lock(&reset_lock);
+  for (int i = 0; i < n; i++) {
+    const osc_hist *h = &s[i]->hist[entry][phase];
+    for (int b = 0; b < OSC_HIST_BUCKETS; b++)
+      counts[b] += load(&h->count[b]);
+  }
+  const osc_hist *base = &baseline.hist[entry][phase];
+  for (int b = 0; b < OSC_HIST_BUCKETS; b++) {
+    counts[b] -= load(&base->count[b]);
+    out->count += counts[b];
+  }
+  pthread_mutex_unlock(&reset_lock);
+  if (out->count == 0)
+    return;
+
+  uint64_t ticks = osc_stats_now() - ticks0, ns = mono_ns() - mono0;
+  double scale = ticks ? (double)ns / (double)ticks : 1.0;
+  const double q[3] = {0.50, 0.90, 0.99};
+  uint64_t *dst[3] = {&out->p50, &out->p90, &out->p99};
+  uint64_t seen = 0;
+  int k = 0;
+  for (int b = 0; b < OSC_HIST_BUCKETS; b++) {
+    if (!counts[b])
+      continue;
+    seen += counts[b];
+    uint64_t top = (uint64_t)((double)bucket_top(b) * scale);
+    while (k < 3 && (double)seen >= q[k] * (double)out->count)
+      *dst[k++] = top;
+    out->max = top;
+  }
+}
+
+void osc_stats_reset(void) {
+  osc_stats_shard *s[OSC_STATS_MAX_SHARDS + 1];
+  int n = all_shards(s);
+  pthread_mutex_lock(&reset_lock);
+  memset(&baseline, 0, sizeof(baseline));
+  for (int i = 0; i < n; i++) {
+    for (int c = 0; c < OSC_STAT_COUNTERS; c++)
+      osc_stats_bump(&baseline.counter[c], load(&s[i]->counter[c]));
+    for (int e = 0; e < OSC_STATS_MAX_ENTRIES; e++)
+      for (int p = 0; p < OSC_PHASE_COUNT; p++)
+        for (int b = 0; b < OSC_HIST_BUCKETS; b++)
+          osc_stats_bump(&baseline.hist[e][p].count[b],
+                         load(&s[i]->hist[e][p].count[b]));
+  }
+  pthread_mutex_unlock(&reset_lock);
+}
+
+const char *osc_stats_counter_name(osc_stat_counter c) {
+  return counter_names[c];
+}
+
+const char *osc_stats_phase_name(osc_stat_phase p) { return phase_names[p]; }
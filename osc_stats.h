@@ -0,0 +1,152 @@
+#ifndef __OSC_STATS_H__
+#define __OSC_STATS_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Dispatch statistics: counters, and for each dispatch entry a latency
+ * histogram of each phase of a message (parse, match, handler, send).
+ *
+ * Every thread that records gets its own shard on first use, and only
+ * that thread writes it, so recording is a plain increment with no lock
+ * and no atomic read-modify-write.  Readers sum the shards.  A reset
+ * does not touch them: it takes the current sums as a baseline that
+ * later reads subtract.
+ *
+ * Times are in ticks of osc_stats_now: the TSC on x86, converted to ns
+ * when read against how far CLOCK_MONOTONIC moved since osc_stats_init;
+ * ns elsewhere.
+ *
+ * Histograms are HDR-style: exact below 8 ticks, then 8 buckets per
+ * power of two, so any value is within 12.5% of its bucket.
+ */
+
+#define OSC_STATS_MAX_ENTRIES 64
+#define OSC_STATS_MAX_SHARDS  32
+#define OSC_HIST_SUB_BITS     3
+#define OSC_HIST_MAX_BITS     40 // longer times land in the last bucket
+#define OSC_HIST_BUCKETS      ((OSC_HIST_MAX_BITS - OSC_HIST_SUB_BITS + 1) \
+                               << OSC_HIST_SUB_BITS)
+
+typedef enum {
+  OSC_STAT_PACKETS,         // datagrams received
+  OSC_STAT_BUNDLES,
+  OSC_STAT_MESSAGES,        // dispatched, bundled or not
+  OSC_STAT_BYTES_IN,
+  OSC_STAT_BYTES_OUT,
+  OSC_STAT_SENDS,
+  OSC_STAT_MALFORMED,       // rejected by the parser
+  OSC_STAT_INVALID_ADDRESS,
+  OSC_STAT_FORMAT_MISMATCH,
+  OSC_STAT_COLLAPSED,       // SETs a later one in their batch overwrote
+  OSC_STAT_COUNTERS
+} osc_stat_counter;
+
+typedef enum {
+  OSC_PHASE_PARSE,
+  OSC_PHASE_MATCH,
+  OSC_PHASE_HANDLER, // less the time it spent sending
+  OSC_PHASE_SEND,
+  OSC_PHASE_COUNT
+} osc_stat_phase;
+
+typedef struct osc_hist {
+  _Atomic uint64_t count[OSC_HIST_BUCKETS];
+} osc_hist;
+
+typedef struct osc_stats_shard {
+  _Atomic uint64_t counter[OSC_STAT_COUNTERS];
+  osc_hist         hist[OSC_STATS_MAX_ENTRIES][OSC_PHASE_COUNT];
+  // the current message, filled in by the server around dispatch
+  uint64_t         parse_ticks;
+  uint64_t         parse_end;  // when the parse finished, 0 if unknown
+  uint64_t         send_ticks;
+} osc_stats_shard;
+
+typedef struct osc_hist_summary {
+  uint64_t count;
+  uint64_t p50, p90, p99, max; // ns
+} osc_hist_summary;
+
+extern __thread osc_stats_shard *osc_stats_mine;
+osc_stats_shard *osc_stats_shard_new(void);
+
+static inline uint64_t osc_stats_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline osc_stats_shard *osc_stats_shard_get(void) {
+  osc_stats_shard *s = osc_stats_mine;
+  return s ? s : osc_stats_shard_new();
+}
+
+// single writer: a relaxed load and store, no locked instruction
+static inline void osc_stats_bump(_Atomic uint64_t *c, uint64_t n) {
+  atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n,
+                        memory_order_relaxed);
+}
+
+static inline int osc_hist_bucket(uint64_t v) {
+  if (v < (1u << OSC_HIST_SUB_BITS))
+    return (int)v;
+  int e = 63 - __builtin_clzll(v);
+  if (e >= OSC_HIST_MAX_BITS)
+    return OSC_HIST_BUCKETS - 1;
+  int sub = (int)(v >> (e - OSC_HIST_SUB_BITS)) & ((1 << OSC_HIST_SUB_BITS) - 1);
+  return ((e - OSC_HIST_SUB_BITS + 1) << OSC_HIST_SUB_BITS) + sub;
+}
+
+static inline void osc_stats_count(osc_stat_counter c, uint64_t n) {
+  osc_stats_bump(&osc_stats_shard_get()->counter[c], n);
+}
+
+/* Adds ticks to a phase of dispatch entry; a no-op for an entry past
+ * OSC_STATS_MAX_ENTRIES. */
+static inline void osc_stats_record(int entry, osc_stat_phase phase,
+                                    uint64_t ticks) {
+  if ((unsigned)entry >= OSC_STATS_MAX_ENTRIES)
+    return;
+  osc_hist *h = &osc_stats_shard_get()->hist[entry][phase];
+  osc_stats_bump(&h->count[osc_hist_bucket(ticks)], 1);
+}
+
+/* Notes that the message about to be dispatched was parsed from t0 until
+ * now; dispatch takes the time and starts its match clock at the end, so
+ * it need not read the clock again.  Likewise the send time of its
+ * replies so far. */
+static inline void osc_stats_note_parse(uint64_t t0) {
+  osc_stats_shard *s = osc_stats_shard_get();
+  s->parse_end = osc_stats_now();
+  s->parse_ticks = s->parse_end - t0;
+}
+
+static inline void osc_stats_note_send(uint64_t ticks) {
+  osc_stats_shard_get()->send_ticks += ticks;
+}
+
+void osc_stats_init(void);
+
+/* Totals since the last reset. */
+uint64_t osc_stats_counter(osc_stat_counter c);
+void osc_stats_summary(int entry, osc_stat_phase phase, osc_hist_summary *s);
+
+/* Makes every counter and histogram read zero from now on. */
+void osc_stats_reset(void);
+
+const char *osc_stats_counter_name(osc_stat_counter c);
+const char *osc_stats_phase_name(osc_stat_phase p);
+
+#endif
@@ -0,0 +1,335 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "osc_stream.h"
+
+int osc_stream_decoder_init(osc_stream_decoder *d, osc_stream_framing f) {
+  memset(d, 0, sizeof(*d));
+  d->framing = f;
+  d->buf = malloc(OSC_STREAM_MAX_FRAME);
+  return d->buf ? 0 : -1;
+}
+
+void osc_stream_decoder_free(osc_stream_decoder *d) {
+  free(d->buf);
+  d->buf = NULL;
+}
+
+static void deliver(connectionT *conn, char *frame, uint32_t len,
+                    osc_stream_stats *st) {
+  st->frames_in++;
+  conn->receive(conn, frame, len);
+}
+
+// tinyosc reads words in place, so a frame is only used where it lies if
+// it is aligned like a datagram buffer would be
+static bool aligned(const char *p) {
+  return ((uintptr_t)p & 3) == 0;
+}
+
+static bool slip_special(char c) {
+  return (uint8_t)c == OSC_SLIP_END || (uint8_t)c == OSC_SLIP_ESC;
+}
+
+// appends the byte an ESC stood for
+static void put_escaped(osc_stream_decoder *d, uint8_t c,
+                        osc_stream_stats *st) {
+  if (d->skip)
+    return;
+  if (d->len == OSC_STREAM_MAX_FRAME) {
+    st->oversized++;
+    d->skip = true;
+    d->len = 0;
+    return;
+  }
+  d->buf[d->len++] = (char)(c == OSC_SLIP_ESC_END   ? OSC_SLIP_END
+                            : c == OSC_SLIP_ESC_ESC ? OSC_SLIP_ESC
+                                                    : c);
+}
+
+static int feed_slip(osc_stream_decoder *d, char *p, char *end,
+                     connectionT *conn, osc_stream_stats *st) {
+  int frames = 0;
+  // an ESC at the end of the last read escapes the first byte of this one
+  if (d->escape && p < end) {
+    d->escape = false;
+    put_escaped(d, (uint8_t)*p++, st);
+  }
+  while (p < end) {
+    // nothing assembled: take a whole frame without ESCs where it lies
+    if (d->len == 0 && !d->skip) {
+      while (p < end && (uint8_t)*p == OSC_SLIP_END)
+        p++;
+      if (p == end)
+        break;
+      char *e = memchr(p, OSC_SLIP_END, (size_t)(end - p));
+      if (e && aligned(p) && e - p <= OSC_STREAM_MAX_FRAME &&
+          !memchr(p, OSC_SLIP_ESC, (size_t)(e - p))) {
+        deliver(conn, p, (uint32_t)(e - p), st);
+        frames++;
+        p = e + 1;
+        continue;
+      }
+    }
+
+    // copy the run up to the next END or ESC
+    char *run = p;
+    while (p < end && !slip_special(*p))
+      p++;
+    size_t n = (size_t)(p - run);
+    if (n && !d->skip) {
+      if (d->len + n > OSC_STREAM_MAX_FRAME) {
+        st->oversized++;
+        d->skip = true;
+        d->len = 0;
+      } else {
+        memcpy(d->buf + d->len, run, n);
+        d->len += (uint32_t)n;
+      }
+    }
+    if (p == end)
+      break;
+
+    if ((uint8_t)*p++ == OSC_SLIP_END) {
+      if (d->len && !d->skip) {
+        deliver(conn, d->buf, d->len, st);
+        frames++;
+      }
+      d->len = 0;
+      d->skip = false;
+    } else if (p == end) {
+      d->escape = true;
+    } else {
+      put_escaped(d, (uint8_t)*p++, st);
+    }
+  }
+  return frames;
+}
+
+static int feed_length(osc_stream_decoder *d, char *p, char *end,
+                       connectionT *conn, osc_stream_stats *st) {
+  int frames = 0;
+  while (p < end) {
+    if (d->head_len < 4) {
+      d->head[d->head_len++] = (uint8_t)*p++;
+      if (d->head_len < 4)
+        continue;
+      d->need = (uint32_t)d->head[0] << 24 | (uint32_t)d->head[1] << 16 |
+                (uint32_t)d->head[2] << 8 | d->head[3];
+      d->len = 0;
+      if (d->need > OSC_STREAM_MAX_FRAME) {
+        st->oversized++;
+        return -1;
+      }
+      if (d->need == 0) {
+        d->head_len = 0;
+        continue;
+      }
+      // the whole frame is here: use it where it lies
+      if ((size_t)(end - p) >= d->need && aligned(p)) {
+        deliver(conn, p, d->need, st);
+        frames++;
+        p += d->need;
+        d->head_len = 0;
+        continue;
+      }
+    }
+    size_t take = d->need - d->len;
+    if (take > (size_t)(end - p))
+      take = (size_t)(end - p);
+    memcpy(d->buf + d->len, p, take);
+    d->len += (uint32_t)take;
+    p += take;
+    if (d->len == d->need) {
+      deliver(conn, d->buf, d->len, st);
+      frames++;
+      d->len = 0;
+      d->head_len = 0;
+    }
+  }
+  return frames;
+}
+
+int osc_stream_feed(osc_stream_decoder *d, char *data, size_t len,
+                    connectionT *conn, osc_stream_stats *st) {
+  char *end = data + len;
+  if (d->framing == OSC_STREAM_LENGTH)
+    return feed_length(d, data, end, conn, st);
+  return feed_slip(d, data, end, conn, st);
+}
+
+size_t osc_stream_encode(osc_stream_framing f, const void *buf, size_t len,
+                         char *out, size_t cap) {
+  const uint8_t *in = buf;
+  if (f == OSC_STREAM_LENGTH) {
+    if (len + 4 > cap || len > UINT32_MAX)
+      return 0;
+    out[0] = (char)(len >> 24);
+    out[1] = (char)(len >> 16);
+    out[2] = (char)(len >> 8);
+    out[3] = (char)len;
+    memcpy(out + 4, buf, len);
+    return len + 4;
+  }
+  size_t n = 0;
+  if (cap < 2)
+    return 0;
+  out[n++] = (char)OSC_SLIP_END;
+  for (size_t i = 0; i < len; i++) {
+    if (n + 3 > cap) // room for an escaped byte and the final END
+      return 0;
+    if (in[i] == OSC_SLIP_END || in[i] == OSC_SLIP_ESC) {
+      out[n++] = (char)OSC_SLIP_ESC;
+      out[n++] = (char)(in[i] == OSC_SLIP_END ? OSC_SLIP_ESC_END
+                                              : OSC_SLIP_ESC_ESC);
+    } else {
+      out[n++] = (char)in[i];
+    }
+  }
+  out[n++] = (char)OSC_SLIP_END;
+  return n;
+}
+
+int osc_stream_out_init(osc_stream_out *q) {
+  q->start = q->end = 0;
+  q->buf = malloc(OSC_STREAM_QUEUE_SIZE);
+  return q->buf ? 0 : -1;
+}
+
+void osc_stream_out_free(osc_stream_out *q) {
+  free(q->buf);
+  q->buf = NULL;
+  q->start = q->end = 0;
+}
+
+// moves the queued bytes to the front, making room at the end
+static void compact(osc_stream_out *q) {
+  if (q->start == 0)
+    return;
+  memmove(q->buf, q->buf + q->start, q->end - q->start);
+  q->end -= q->start;
+  q->start = 0;
+}
+
+static void note_queued(const osc_stream_out *q, osc_stream_stats *st) {
+  st->queued++;
+  if (osc_stream_out_pending(q) > st->max_queued)
+    st->max_queued = osc_stream_out_pending(q);
+}
+
+ssize_t osc_stream_flush(int fd, osc_stream_out *q) {
+  while (q->start < q->end) {
+    ssize_t n = send(fd, q->buf + q->start, q->end - q->start, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      return -1;
+    }
+    q->start += (uint32_t)n;
+  }
+  if (q->start == q->end)
+    q->start = q->end = 0;
+  return osc_stream_out_pending(q);
+}
+
+ssize_t osc_stream_send(int fd, osc_stream_framing f, osc_stream_out *q,
+                        const void *buf, size_t len, osc_stream_stats *st) {
+  static const char slip_end = (char)OSC_SLIP_END;
+  uint32_t pending = osc_stream_out_pending(q);
+  bool escape = f == OSC_STREAM_SLIP && (memchr(buf, OSC_SLIP_END, len) ||
+                                         memchr(buf, OSC_SLIP_ESC, len));
+  if (escape) {
+    // rare: escape straight into the queue and send it from there
+    compact(q);
+    size_t n = osc_stream_encode(f, buf, len, q->buf + q->end,
+                                 OSC_STREAM_QUEUE_SIZE - q->end);
+    if (n == 0) {
+      st->dropped++;
+      return 0;
+    }
+    q->end += (uint32_t)n;
+    st->frames_out++;
+    if (osc_stream_flush(fd, q) < 0)
+      return -1;
+    if (osc_stream_out_pending(q))
+      note_queued(q, st);
+    return (ssize_t)len;
+  }
+
+  char head[4];
+  struct iovec iov[4];
+  int count = 0;
+  if (pending)
+    iov[count++] = (struct iovec){q->buf + q->start, pending};
+  int first = count; // the iovecs of the new frame
+  if (f == OSC_STREAM_LENGTH) {
+    head[0] = (char)(len >> 24);
+    head[1] = (char)(len >> 16);
+    head[2] = (char)(len >> 8);
+    head[3] = (char)len;
+    iov[count++] = (struct iovec){head, 4};
+    iov[count++] = (struct iovec){(void *)buf, len};
+  } else {
+    iov[count++] = (struct iovec){(void *)&slip_end, 1};
+    iov[count++] = (struct iovec){(void *)buf, len};
+    iov[count++] = (struct iovec){(void *)&slip_end, 1};
+  }
+  size_t framed = len + (f == OSC_STREAM_LENGTH ? 4 : 2);
+  // whatever the socket leaves must fit, so a frame is never cut
+  if (pending + framed > OSC_STREAM_QUEUE_SIZE) {
+    st->dropped++;
+    return 0;
+  }
+
+  struct msghdr msg = {.msg_iov = iov, .msg_iovlen = (size_t)count};
+  ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  if (sent < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      return -1;
+    sent = 0;
+  }
+  st->frames_out++;
+
+  size_t done = (size_t)sent;
+  if (done < pending) {
+    q->start += (uint32_t)done;
+    done = 0;
+  } else {
+    done -= pending;
+    q->start = q->end = 0;
+  }
+  if (done == framed)
+    return (ssize_t)len;
+
+  // queue the rest of the frame behind what is still queued
+  compact(q);
+  for (int i = first; i < count; i++) {
+    if (done >= iov[i].iov_len) {
+      done -= iov[i].iov_len;
+      continue;
+    }
+    size_t n = iov[i].iov_len - done;
+    memcpy(q->buf + q->end, (char *)iov[i].iov_base + done, n);
+    q->end += (uint32_t)n;
+    done = 0;
+  }
+  note_queued(q, st);
+  return (ssize_t)len;
+}
+
+void osc_stream_print_stats(const osc_stream_stats *st) {
+  printf("stream: %llu accepted, %llu closed, %llu refused; %llu frames in, "
+         "%llu out, %llu queued, %llu dropped, %llu oversized, "
+         "max %llu bytes queued\n",
+         (unsigned long long)st->accepted, (unsigned long long)st->closed,
+         (unsigned long long)st->refused, (unsigned long long)st->frames_in,
+         (unsigned long long)st->frames_out, (unsigned long long)st->queued,
+         (unsigned long long)st->dropped, (unsigned long long)st->oversized,
+         (unsigned long long)st->max_queued);
+}
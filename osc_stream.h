@@ -0,0 +1,110 @@
+#ifndef __OSC_STREAM_H__
+#define __OSC_STREAM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "network.h"
+
+/*
+ * OSC over a byte stream (TCP).  Packets are framed either as OSC 1.1
+ * specifies, with SLIP (RFC 1055, double-ended: END before and after each
+ * packet), or as OSC 1.0 did, with a 4-byte big-endian length before each
+ * packet.
+ *
+ * The decoder is fed whatever one read returned and keeps partial frames
+ * across calls, so a frame may be split at any byte.  A frame that lies
+ * whole and aligned in the bytes fed is passed on where it is; the rest
+ * are assembled in the decoder's buffer.  Each complete frame goes to
+ * conn->receive, the same path a datagram takes.
+ *
+ * The output queue holds what the socket would not take.  A send writes
+ * the queue and the new frame with one gathered sendmsg (writev, but with
+ * MSG_NOSIGNAL), so frames go out in order without copying the common
+ * case; only what is left over is copied into the queue, to be flushed
+ * when the socket is writable again.  A frame that does not fit the queue
+ * is dropped whole, never cut.
+ */
+
+#define OSC_STREAM_MAX_FRAME  65536
+#define OSC_STREAM_QUEUE_SIZE (256 * 1024)
+
+#define OSC_SLIP_END     0xc0
+#define OSC_SLIP_ESC     0xdb
+#define OSC_SLIP_ESC_END 0xdc
+#define OSC_SLIP_ESC_ESC 0xdd
+
+typedef enum osc_stream_framing {
+  OSC_STREAM_SLIP = 0,
+  OSC_STREAM_LENGTH,
+} osc_stream_framing;
+
+typedef struct osc_stream_stats {
+  uint64_t accepted;
+  uint64_t closed;
+  uint64_t refused;    // connection table full
+  uint64_t frames_in;
+  uint64_t frames_out;
+  uint64_t oversized;  // frames over OSC_STREAM_MAX_FRAME, skipped
+  uint64_t queued;     // frames the socket did not take whole
+  uint64_t dropped;    // frames the queue had no room for
+  uint64_t max_queued; // bytes
+} osc_stream_stats;
+
+typedef struct osc_stream_decoder {
+  osc_stream_framing framing;
+  char    *buf;      // OSC_STREAM_MAX_FRAME bytes
+  uint32_t len;      // of the frame assembled so far
+  uint32_t need;     // length framing: size of the current frame
+  uint8_t  head_len; // length framing: size bytes read so far
+  uint8_t  head[4];
+  bool     escape;   // SLIP: the last byte was ESC
+  bool     skip;     // dropping an oversized frame
+} osc_stream_decoder;
+
+typedef struct osc_stream_out {
+  char    *buf;        // OSC_STREAM_QUEUE_SIZE bytes
+  uint32_t start, end; // the queued bytes are buf[start, end)
+} osc_stream_out;
+
+/* Returns 0, or -1 if the buffer cannot be allocated. */
+int osc_stream_decoder_init(osc_stream_decoder *d, osc_stream_framing f);
+void osc_stream_decoder_free(osc_stream_decoder *d);
+
+/*
+ * Decodes len bytes read from the stream, passing each complete frame to
+ * conn->receive. Returns the number of frames, or -1 if the stream cannot
+ * be followed any further (a length over OSC_STREAM_MAX_FRAME).  An
+ * oversized SLIP frame is skipped up to the next END instead.
+ */
+int osc_stream_feed(osc_stream_decoder *d, char *data, size_t len,
+                    connectionT *conn, osc_stream_stats *st);
+
+/* Writes buf framed for the stream into out. Returns the framed size, or
+ * 0 if it does not fit. */
+size_t osc_stream_encode(osc_stream_framing f, const void *buf, size_t len,
+                         char *out, size_t cap);
+
+int osc_stream_out_init(osc_stream_out *q);
+void osc_stream_out_free(osc_stream_out *q);
+
+static inline uint32_t osc_stream_out_pending(const osc_stream_out *q) {
+  return q->end - q->start;
+}
+
+/*
+ * Sends buf as one frame behind whatever is queued, without blocking.
+ * Returns len if it was sent or queued, 0 if dropped because the queue is
+ * full, or -1 if the connection failed.
+ */
+ssize_t osc_stream_send(int fd, osc_stream_framing f, osc_stream_out *q,
+                        const void *buf, size_t len, osc_stream_stats *st);
+
+/* Writes as much of the queue as the socket takes. Returns the bytes still
+ * queued, or -1 if the connection failed. */
+ssize_t osc_stream_flush(int fd, osc_stream_out *q);
+
+void osc_stream_print_stats(const osc_stream_stats *st);
+
+#endif
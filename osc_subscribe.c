@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "osc_subscribe.h"
+
+void osc_subs_init(osc_subs *s) {
+  memset(s, 0, sizeof(*s));
+  pthread_mutex_init(&s->lock, NULL);
+}
+
+static bool same_peer(const osc_subscriber *sub, const connectionT *peer) {
+  return sub->fd == peer->con.fd && sub->addr_len == peer->con.addr_len &&
+         memcmp(&sub->addr, &peer->con.addr, sub->addr_len) == 0;
+}
+
+static int popcount(const uint64_t *words) {
+  int n = 0;
+  for (int w = 0; w < OSC_SUBS_WORDS; w++)
+    n += __builtin_popcountll(words[w]);
+  return n;
+}
+
+int osc_subs_update(osc_subs *s, const connectionT *peer,
+                    const uint64_t *fields, bool add) {
+  pthread_mutex_lock(&s->lock);
+  osc_subscriber *sub = NULL, *free_slot = NULL;
+  for (int i = 0; i < OSC_SUBS_MAX; i++) {
+    osc_subscriber *c = &s->subs[i];
+    if (c->active && same_peer(c, peer)) {
+      sub = c;
+      break;
+    }
+    if (!c->active && !free_slot)
+      free_slot = c;
+  }
+
+  int n = 0;
+  if (add) {
+    if (!sub && free_slot) {
+      sub = free_slot;
+      memset(sub, 0, sizeof(*sub));
+      sub->active = true;
+      sub->fd = peer->con.fd;
+      sub->addr_len = peer->con.addr_len;
+      memcpy(&sub->addr, &peer->con.addr, peer->con.addr_len);
+      atomic_fetch_add(&s->count, 1);
+    }
+    if (!sub) {
+      n = -1;
+    } else {
+      for (int w = 0; w < OSC_SUBS_WORDS; w++) {
+        sub->pending[w] |= fields[w] & ~sub->fields[w];
+        sub->fields[w] |= fields[w];
+      }
+      n = popcount(sub->fields);
+    }
+  } else if (sub) {
+    for (int w = 0; w < OSC_SUBS_WORDS; w++) {
+      sub->fields[w] &= ~fields[w];
+      sub->pending[w] &= ~fields[w];
+    }
+    n = popcount(sub->fields);
+    if (n == 0) {
+      sub->active = false;
+      atomic_fetch_sub(&s->count, 1);
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+  return n;
+}
+
+void osc_subs_forget(osc_subs *s, int fd) {
+  pthread_mutex_lock(&s->lock);
+  for (int i = 0; i < OSC_SUBS_MAX; i++) {
+    osc_subscriber *sub = &s->subs[i];
+    if (sub->active && sub->fd == fd) {
+      sub->active = false;
+      atomic_fetch_sub(&s->count, 1);
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
+int osc_subs_push(osc_subs *s, const osc_image *img, connectionT *via) {
+  if (atomic_load_explicit(&s->count, memory_order_relaxed) == 0)
+    return 0;
+
+  uint64_t dirty[OSC_SUBS_WORDS];
+  for (int w = 0; w < OSC_SUBS_WORDS; w++)
+    dirty[w] = atomic_exchange_explicit(&s->dirty[w], 0, memory_order_acquire);
+
+  int packets = 0;
+  pthread_mutex_lock(&s->lock);
+  for (int i = 0; i < OSC_SUBS_MAX; i++) {
+    osc_subscriber *sub = &s->subs[i];
+    if (!sub->active)
+      continue;
+    uint64_t fields[OSC_SUBS_WORDS];
+    bool any = false;
+    for (int w = 0; w < OSC_SUBS_WORDS; w++) {
+      fields[w] = (dirty[w] & sub->fields[w]) | sub->pending[w];
+      sub->pending[w] = 0;
+      any |= fields[w] != 0;
+    }
+    if (!any)
+      continue;
+
+    via->con.fd = sub->fd;
+    via->con.addr_len = sub->addr_len;
+    memcpy(&via->con.addr, &sub->addr, sub->addr_len);
+    int sent;
+    packets += osc_image_send_fields(img, fields, via, &sent);
+    s->updates += sent;
+  }
+  s->packets += packets;
+  pthread_mutex_unlock(&s->lock);
+  return packets;
+}
+
+void osc_subs_get_stats(osc_subs *s, osc_subs_stats *st) {
+  st->marks = atomic_load(&s->marks);
+  st->coalesced = atomic_load(&s->coalesced);
+  pthread_mutex_lock(&s->lock);
+  st->updates = s->updates;
+  st->packets = s->packets;
+  pthread_mutex_unlock(&s->lock);
+}
+
+void osc_subs_print_stats(const osc_subs_stats *st) {
+  printf("push: %llu updates in %llu packets, %llu of %llu changes "
+         "coalesced\n",
+         (unsigned long long)st->updates, (unsigned long long)st->packets,
+         (unsigned long long)st->coalesced, (unsigned long long)st->marks);
+}
@@ -0,0 +1,88 @@
+#ifndef __OSC_SUBSCRIBE_H__
+#define __OSC_SUBSCRIBE_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "network.h"
+#include "osc_image.h"
+
+/*
+ * Push subscriptions.  A peer subscribes to a set of state image fields;
+ * a SET marks its field dirty, and once per frame tick every subscriber
+ * gets the current value of each dirty field it watches, packed into
+ * #bundles.  However often a field changes within a frame, it is sent at
+ * most once per frame.  Newly subscribed fields are sent on the next tick
+ * so the peer starts from the current state.
+ */
+
+#define OSC_SUBS_MAX    32
+#define OSC_SUBS_WORDS  OSC_IMAGE_WORDS
+
+typedef struct osc_subscriber {
+  bool                    active;
+  int                     fd;       // listener the subscription came on
+  struct sockaddr_storage addr;
+  socklen_t               addr_len;
+  uint64_t                fields[OSC_SUBS_WORDS];  // watched
+  uint64_t                pending[OSC_SUBS_WORDS]; // to send regardless
+} osc_subscriber;
+
+typedef struct osc_subs_stats {
+  uint64_t marks;     // SETs seen while anyone was subscribed
+  uint64_t coalesced; // marks of a field already dirty this frame
+  uint64_t updates;   // field messages pushed
+  uint64_t packets;   // bundles pushed
+} osc_subs_stats;
+
+typedef struct osc_subs {
+  pthread_mutex_t  lock; // guards subs and stats.updates/packets
+  _Atomic int      count;
+  _Atomic uint64_t dirty[OSC_SUBS_WORDS];
+  _Atomic uint64_t marks;
+  _Atomic uint64_t coalesced;
+  osc_subscriber   subs[OSC_SUBS_MAX];
+  uint64_t         updates;
+  uint64_t         packets;
+} osc_subs;
+
+void osc_subs_init(osc_subs *s);
+
+/*
+ * Adds fields to, or removes them from, the subscription of the peer conn
+ * last received from. Returns the number of fields the peer now watches,
+ * or -1 if the table is full.
+ */
+int osc_subs_update(osc_subs *s, const connectionT *peer,
+                    const uint64_t *fields, bool add);
+
+/* Notes that a field changed; cheap when nobody is subscribed. */
+static inline void osc_subs_mark(osc_subs *s, int field) {
+  if (atomic_load_explicit(&s->count, memory_order_relaxed) == 0)
+    return;
+  uint64_t bit = 1ull << (field & 63);
+  uint64_t old = atomic_fetch_or_explicit(&s->dirty[field >> 6], bit,
+                                          memory_order_release);
+  atomic_fetch_add_explicit(&s->marks, 1, memory_order_relaxed);
+  if (old & bit)
+    atomic_fetch_add_explicit(&s->coalesced, 1, memory_order_relaxed);
+}
+
+/* Ends every subscription that came on fd, as when a stream closes. */
+void osc_subs_forget(osc_subs *s, int fd);
+
+/*
+ * Sends every subscriber its dirty and pending fields through via->send,
+ * with via->con set to each subscriber's socket and address. Call once
+ * per frame. Returns the number of bundles sent.
+ */
+int osc_subs_push(osc_subs *s, const osc_image *img, connectionT *via);
+
+void osc_subs_get_stats(osc_subs *s, osc_subs_stats *st);
+
+void osc_subs_print_stats(const osc_subs_stats *st);
+
+#endif
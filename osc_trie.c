@@ -0,0 +1,158 @@
+#include <string.h>
+
+#include "osc_trie.h"
+
+void osc_trie_init(osc_trie *t) {
+  memset(t, 0, sizeof(*t));
+  t->nodes[0].set = -1;
+  t->nodes[0].first_child = -1;
+  t->nodes[0].next_sibling = -1;
+  t->nodes[0].value = -1;
+  t->node_count = 1;
+}
+
+// compile "[...]" into a char -> position map, sharing identical sets
+static int compile_set(osc_trie *t, const char *seg, size_t len) {
+  int8_t map[256];
+  memset(map, -1, sizeof(map));
+
+  if (len < 3 || seg[len - 1] != ']')
+    return -1;
+
+  int pos = 0;
+  for (size_t i = 1; i < len - 1; i++) {
+    unsigned char lo = (unsigned char)seg[i];
+    unsigned char hi = lo;
+    if (i + 2 < len - 1 && seg[i + 1] == '-') {
+      hi = (unsigned char)seg[i + 2];
+      i += 2;
+    }
+    if (lo == '[' || lo == '^' || hi < lo)
+      return -1;
+    for (unsigned c = lo; c <= hi; c++) {
+      if (map[c] < 0)
+        map[c] = (int8_t)pos++;
+    }
+  }
+
+  for (int s = 0; s < t->set_count; s++) {
+    if (memcmp(t->sets[s], map, sizeof(map)) == 0)
+      return s;
+  }
+  if (t->set_count >= OSC_TRIE_MAX_SETS)
+    return -1;
+  memcpy(t->sets[t->set_count], map, sizeof(map));
+  return t->set_count++;
+}
+
+static int find_or_add_child(osc_trie *t, int parent, const char *seg,
+                             size_t len) {
+  int set = -1;
+  if (seg[0] == '[') {
+    set = compile_set(t, seg, len);
+    if (set < 0)
+      return -1;
+  } else if (len == 0 || len >= OSC_TRIE_MAX_SEGMENT ||
+             memchr(seg, '*', len) || memchr(seg, '?', len)) {
+    return -1;
+  }
+
+  int last = -1;
+  for (int c = t->nodes[parent].first_child; c >= 0;
+       c = t->nodes[c].next_sibling) {
+    const osc_trie_node *n = &t->nodes[c];
+    if (set >= 0 && n->set == set)
+      return c;
+    if (set < 0 && n->set < 0 && n->seg_len == len &&
+        memcmp(n->segment, seg, len) == 0)
+      return c;
+    last = c;
+  }
+
+  if (t->node_count >= OSC_TRIE_MAX_NODES)
+    return -1;
+  int id = t->node_count++;
+  osc_trie_node *n = &t->nodes[id];
+  if (set < 0) {
+    memcpy(n->segment, seg, len);
+    n->seg_len = (uint8_t)len;
+  }
+  n->set = (int8_t)set;
+  n->first_child = -1;
+  n->next_sibling = -1;
+  n->value = -1;
+
+  if (last < 0)
+    t->nodes[parent].first_child = (int16_t)id;
+  else
+    t->nodes[last].next_sibling = (int16_t)id;
+  return id;
+}
+
+int osc_trie_add(osc_trie *t, const char *pattern, int value) {
+  if (pattern[0] != '/')
+    return -1;
+
+  int node = 0;
+  const char *p = pattern + 1;
+  for (;;) {
+    const char *end = strchr(p, '/');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    node = find_or_add_child(t, node, p, len);
+    if (node < 0)
+      return -2;
+    if (!end)
+      break;
+    p = end + 1;
+  }
+
+  if (t->nodes[node].value >= 0)
+    return -3; // duplicate pattern
+  t->nodes[node].value = (int16_t)value;
+  return 0;
+}
+
+int osc_trie_match(const osc_trie *t, const char *address, osc_match *m) {
+  m->count = 0;
+  if (address[0] != '/')
+    return -1;
+
+  int node = 0;
+  const char *p = address + 1;
+  for (;;) {
+    const char *end = p;
+    while (*end != '\0' && *end != '/')
+      end++;
+    size_t len = (size_t)(end - p);
+
+    int next = -1, set_child = -1, capture = -1;
+    for (int c = t->nodes[node].first_child; c >= 0;
+         c = t->nodes[c].next_sibling) {
+      const osc_trie_node *n = &t->nodes[c];
+      if (n->set < 0) {
+        if (n->seg_len == len && memcmp(n->segment, p, len) == 0) {
+          next = c;
+          break;
+        }
+      } else if (len == 1 && set_child < 0) {
+        int8_t k = t->sets[n->set][(unsigned char)p[0]];
+        if (k >= 0) {
+          set_child = c;
+          capture = k;
+        }
+      }
+    }
+
+    if (next < 0) {
+      if (set_child < 0 || m->count >= OSC_MAX_CAPTURES)
+        return -1;
+      next = set_child;
+      m->index[m->count++] = capture;
+    }
+
+    if (*end == '\0')
+      return t->nodes[next].value;
+    node = next;
+    p = end + 1;
+  }
+}
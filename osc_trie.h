@@ -0,0 +1,54 @@
+#ifndef __OSC_TRIE_H__
+#define __OSC_TRIE_H__
+
+#include <stdint.h>
+
+/*
+ * Segment trie compiled from OSC path patterns.
+ *
+ * Each '/'-separated segment of a pattern is either a literal ("send",
+ * "brightness") or a single character set ("[1-4]", "[YRGB]").  Set
+ * segments capture the position of the matched character within the
+ * expanded set, so "[YRGB]" yields 0..3 in LutChannel order and "[1-4]"
+ * yields a zero-based index.  Other glob syntax is not supported.
+ *
+ * Lookup walks the address once; literal children are tried before set
+ * children and there is no backtracking, so patterns must not be ambiguous.
+ */
+
+#define OSC_TRIE_MAX_NODES    128
+#define OSC_TRIE_MAX_SETS     8
+#define OSC_TRIE_MAX_SEGMENT  24
+#define OSC_MAX_CAPTURES      4
+
+/* Indices captured from the set segments of a matched pattern */
+typedef struct osc_match {
+  int count;
+  int index[OSC_MAX_CAPTURES];
+} osc_match;
+
+typedef struct osc_trie_node {
+  char    segment[OSC_TRIE_MAX_SEGMENT]; // literal text, unused for sets
+  uint8_t seg_len;
+  int8_t  set;         // index into osc_trie.sets, or -1 for a literal
+  int16_t first_child;
+  int16_t next_sibling;
+  int16_t value;       // payload of a pattern ending here, or -1
+} osc_trie_node;
+
+typedef struct osc_trie {
+  osc_trie_node nodes[OSC_TRIE_MAX_NODES];
+  int           node_count;
+  int8_t        sets[OSC_TRIE_MAX_SETS][256]; // char -> capture index or -1
+  int           set_count;
+} osc_trie;
+
+void osc_trie_init(osc_trie *t);
+
+/* Adds a pattern with the given payload. Returns 0 or a negative error. */
+int osc_trie_add(osc_trie *t, const char *pattern, int value);
+
+/* Returns the payload of the matching pattern, or -1 if none matches. */
+int osc_trie_match(const osc_trie *t, const char *address, osc_match *m);
+
+#endif
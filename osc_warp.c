@@ -0,0 +1,526 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if __AVX2__
+#include <immintrin.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "osc_warp.h"
+
+void osc_warp_init(osc_warp *w) { memset(w, 0, sizeof(*w)); }
+
+static void free_tables(osc_warp *w) {
+  for (int k = 0; k < 2; k++) {
+    free(w->col_idx[k]);
+    free(w->col_w[k]);
+    free(w->row_idx[k]);
+    free(w->row_w[k]);
+    w->col_idx[k] = w->row_idx[k] = NULL;
+    w->col_w[k] = w->row_w[k] = NULL;
+  }
+}
+
+void osc_warp_free(osc_warp *w) { free_tables(w); }
+
+static void mul3(double out[3][3], const double a[3][3],
+                 const double b[3][3]) {
+  double t[3][3];
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      t[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c];
+  memcpy(out, t, sizeof(t));
+}
+
+// inverse by the adjugate; all zero when m is singular, which samples
+// nothing
+static void invert3(double out[3][3], const double m[3][3]) {
+  double a[3][3] = {
+      {m[1][1] * m[2][2] - m[1][2] * m[2][1],
+       m[0][2] * m[2][1] - m[0][1] * m[2][2],
+       m[0][1] * m[1][2] - m[0][2] * m[1][1]},
+      {m[1][2] * m[2][0] - m[1][0] * m[2][2],
+       m[0][0] * m[2][2] - m[0][2] * m[2][0],
+       m[0][2] * m[1][0] - m[0][0] * m[1][2]},
+      {m[1][0] * m[2][1] - m[1][1] * m[2][0],
+       m[0][1] * m[2][0] - m[0][0] * m[2][1],
+       m[0][0] * m[1][1] - m[0][1] * m[1][0]},
+  };
+  double det = m[0][0] * a[0][0] + m[0][1] * a[1][0] + m[0][2] * a[2][0];
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      out[r][c] = fabs(det) < 1e-12 ? 0.0 : a[r][c] / det;
+}
+
+// input pixel to output pixel, composed as described in osc_warp.h
+static void forward(double f[3][3], const float *g, const osc_warp *w) {
+  double ow = w->out_w, oh = w->out_h;
+  double rot = g[4] * M_PI / 180, pitch = g[5] * M_PI / 180;
+  double yaw = g[6] * M_PI / 180;
+  double cr = cos(rot), sr = sin(rot);
+  double cp = cos(pitch), sp = sin(pitch), cy = cos(yaw), sy = sin(yaw);
+  double d = OSC_WARP_FOCAL * ow;
+
+  const double fill[3][3] = {{ow / w->in_w, 0, -ow / 2},
+                             {0, oh / w->in_h, -oh / 2},
+                             {0, 0, 1}};
+  const double scale[3][3] = {{g[0], 0, 0}, {0, g[1], 0}, {0, 0, 1}};
+  const double turn[3][3] = {{cr, -sr, 0}, {sr, cr, 0}, {0, 0, 1}};
+  // the plane z = 0 turned by yaw * pitch, then projected from d away
+  const double tilt[3][3] = {{cy, sy * sp, 0},
+                             {0, cp, 0},
+                             {-sy / d, cy * sp / d, 1}};
+  const double place[3][3] = {{1, 0, g[2] * ow + ow / 2},
+                              {0, 1, g[3] * oh + oh / 2},
+                              {0, 0, 1}};
+  mul3(f, scale, fill);
+  mul3(f, turn, f);
+  mul3(f, tilt, f);
+  mul3(f, place, f);
+}
+
+// the two taps around input coordinate s on an axis of n pixels; a tap
+// outside gets weight 0 and an index clamped inside
+static inline void taps(float s, int n, int32_t idx[2], float wt[2]) {
+  s -= 0.5f;
+  s = s > -2.0f ? s : -2.0f; // NaN too
+  s = s < (float)n + 1.0f ? s : (float)n + 1.0f;
+  int i = (int)s;
+  if ((float)i > s)
+    i--;
+  float fr = s - (float)i;
+  wt[0] = i >= 0 && i < n ? 1.0f - fr : 0.0f;
+  wt[1] = i + 1 >= 0 && i + 1 < n ? fr : 0.0f;
+  idx[0] = i < 0 ? 0 : i >= n ? n - 1 : i;
+  idx[1] = i + 1 < 0 ? 0 : i + 1 >= n ? n - 1 : i + 1;
+}
+
+int osc_warp_update(osc_warp *w, const ConfigSend *send, int in_w, int in_h,
+                    int out_w, int out_h) {
+  float g[7] = {send->scaleX,   send->scaleY, send->posX, send->posY,
+                send->rotation, send->pitch,  send->yaw};
+  if (w->built && memcmp(g, w->geometry, sizeof(g)) == 0 &&
+      w->in_w == in_w && w->in_h == in_h && w->out_w == out_w &&
+      w->out_h == out_h)
+    return 0;
+
+  if (w->out_w != out_w || w->out_h != out_h || !w->col_idx[0]) {
+    free_tables(w);
+    for (int k = 0; k < 2; k++) {
+      w->col_idx[k] = malloc(out_w * sizeof(int32_t));
+      w->col_w[k] = malloc(out_w * sizeof(float));
+      w->row_idx[k] = malloc(out_h * sizeof(int32_t));
+      w->row_w[k] = malloc(out_h * sizeof(float));
+      if (!w->col_idx[k] || !w->col_w[k] || !w->row_idx[k] || !w->row_w[k]) {
+        free_tables(w);
+        w->built = false;
+        return -1;
+      }
+    }
+  }
+  memcpy(w->geometry, g, sizeof(g));
+  w->in_w = in_w;
+  w->in_h = in_h;
+  w->out_w = out_w;
+  w->out_h = out_h;
+
+  double f[3][3], h[3][3];
+  forward(f, g, w);
+  invert3(h, f);
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      w->h[r][c] = (float)h[r][c];
+
+  // exactly separable: the tables give the same samples as the homography
+  w->axis_aligned = g[4] == 0.0f && g[5] == 0.0f && g[6] == 0.0f &&
+                    w->h[2][2] > 0.0f;
+  if (w->axis_aligned) {
+    for (int x = 0; x < out_w; x++) {
+      int32_t idx[2];
+      float wt[2], xc = (float)x + 0.5f;
+      taps((w->h[0][0] * xc + w->h[0][2]) / w->h[2][2], in_w, idx, wt);
+      for (int k = 0; k < 2; k++) {
+        w->col_idx[k][x] = idx[k];
+        w->col_w[k][x] = wt[k];
+      }
+    }
+    w->col_shift = w->col_idx[0][0];
+    w->col_shift_ok = true;
+    for (int x = 0; x < out_w; x++)
+      w->col_shift_ok &= w->col_w[0][x] == 1.0f && w->col_w[1][x] == 0.0f &&
+                         w->col_idx[0][x] == x + w->col_shift;
+    for (int y = 0; y < out_h; y++) {
+      int32_t idx[2];
+      float wt[2], yc = (float)y + 0.5f;
+      taps((w->h[1][1] * yc + w->h[1][2]) / w->h[2][2], in_h, idx, wt);
+      for (int k = 0; k < 2; k++) {
+        w->row_idx[k][y] = idx[k];
+        w->row_w[k][y] = wt[k];
+      }
+    }
+  }
+  w->built = true;
+  w->updates++;
+  return 1;
+}
+
+void osc_warp_pixel(const osc_warp *w, const osc_picture *in, int x, int y,
+                    float out[3]) {
+  const float(*h)[3] = w->h;
+  float xc = (float)x + 0.5f, yc = (float)y + 0.5f;
+  float hw = (h[2][0] * xc + h[2][1] * yc) + h[2][2];
+  if (!(hw > 0.0f)) { // behind the viewer
+    out[0] = out[1] = out[2] = 0.0f;
+    return;
+  }
+  int32_t ix[2], iy[2];
+  float wx[2], wy[2];
+  taps(((h[0][0] * xc + h[0][1] * yc) + h[0][2]) / hw, w->in_w, ix, wx);
+  taps(((h[1][0] * xc + h[1][1] * yc) + h[1][2]) / hw, w->in_h, iy, wy);
+  for (int c = 0; c < 3; c++) {
+    const float *r0 = osc_picture_row(in, c, iy[0]);
+    const float *r1 = osc_picture_row(in, c, iy[1]);
+    // rows first, as the separable path does
+    out[c] = wx[0] * (wy[0] * r0[ix[0]] + wy[1] * r1[ix[0]]) +
+             wx[1] * (wy[0] * r0[ix[1]] + wy[1] * r1[ix[1]]);
+  }
+}
+
+// blends input rows r0 and r1 over columns lo..hi into t[lo..hi]
+static void blend_rows(const float *r0, const float *r1, float wy0, float wy1,
+                       float *t, int lo, int hi) {
+  int i = lo;
+#if __AVX2__
+  const __m256 a = _mm256_set1_ps(wy0), b = _mm256_set1_ps(wy1);
+  for (; i + 8 <= hi + 1; i += 8)
+    _mm256_storeu_ps(t + i,
+                     _mm256_add_ps(_mm256_mul_ps(a, _mm256_loadu_ps(r0 + i)),
+                                   _mm256_mul_ps(b, _mm256_loadu_ps(r1 + i))));
+#elif __SSE2__
+  const __m128 a = _mm_set1_ps(wy0), b = _mm_set1_ps(wy1);
+  for (; i + 4 <= hi + 1; i += 4)
+    _mm_storeu_ps(t + i, _mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(r0 + i)),
+                                    _mm_mul_ps(b, _mm_loadu_ps(r1 + i))));
+#endif
+  for (; i <= hi; i++)
+    t[i] = wy0 * r0[i] + wy1 * r1[i];
+}
+
+// one output row from x0 to x1 through the separable tables: the two
+// input rows are blended over the columns the tile reads, then each
+// output pixel blends two of those.  A row or column map that is a
+// whole-pixel shift skips its blend.
+static void axis_row(const osc_warp *w, const osc_picture *in,
+                     osc_picture *out, int y, int x0, int x1, float *tmp) {
+  float wy0 = w->row_w[0][y], wy1 = w->row_w[1][y];
+  const int32_t *i0 = w->col_idx[0], *i1 = w->col_idx[1];
+  const float *wx0 = w->col_w[0], *wx1 = w->col_w[1];
+  // the column map is monotone, so its ends bound the columns read
+  int lo = i0[x0] < i0[x1 - 1] ? i0[x0] : i0[x1 - 1];
+  int hi = i1[x0] > i1[x1 - 1] ? i1[x0] : i1[x1 - 1];
+  for (int c = 0; c < 3; c++) {
+    const float *r0 = osc_picture_row(in, c, w->row_idx[0][y]);
+    const float *r1 = osc_picture_row(in, c, w->row_idx[1][y]);
+    float *o = osc_picture_row(out, c, y);
+    const float *t = r0;
+    if (wy0 != 1.0f || wy1 != 0.0f) {
+      blend_rows(r0, r1, wy0, wy1, tmp - lo, lo, hi);
+      t = tmp - lo;
+    }
+    if (w->col_shift_ok) {
+      memcpy(o + x0, t + x0 + w->col_shift, (x1 - x0) * sizeof(float));
+      continue;
+    }
+    int x = x0;
+#if __SSE2__
+    for (; x + 4 <= x1; x += 4) {
+      const int32_t *a = i0 + x, *b = i1 + x;
+      __m128 p0 = _mm_setr_ps(t[a[0]], t[a[1]], t[a[2]], t[a[3]]);
+      __m128 p1 = _mm_setr_ps(t[b[0]], t[b[1]], t[b[2]], t[b[3]]);
+      _mm_storeu_ps(o + x,
+                    _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(wx0 + x), p0),
+                               _mm_mul_ps(_mm_loadu_ps(wx1 + x), p1)));
+    }
+#endif
+    for (; x < x1; x++)
+      o[x] = wx0[x] * t[i0[x]] + wx1[x] * t[i1[x]];
+  }
+}
+
+#if __AVX2__
+// taps for 8 coordinates; see taps()
+static inline void taps8(__m256 s, int n, __m256i idx[2], __m256 wt[2]) {
+  const __m256 nf = _mm256_set1_ps((float)n);
+  s = _mm256_sub_ps(s, _mm256_set1_ps(0.5f));
+  s = _mm256_max_ps(s, _mm256_set1_ps(-2.0f));
+  s = _mm256_min_ps(s, _mm256_add_ps(nf, _mm256_set1_ps(1.0f)));
+  __m256i i = _mm256_cvttps_epi32(s);
+  __m256 over = _mm256_cmp_ps(_mm256_cvtepi32_ps(i), s, _CMP_GT_OQ);
+  i = _mm256_add_epi32(i, _mm256_castps_si256(over)); // -1 where over
+  __m256 fr = _mm256_sub_ps(s, _mm256_cvtepi32_ps(i));
+  __m256i j = _mm256_add_epi32(i, _mm256_set1_epi32(1));
+  __m256i vn = _mm256_set1_epi32(n), neg = _mm256_set1_epi32(-1);
+  __m256i in0 = _mm256_and_si256(_mm256_cmpgt_epi32(i, neg),
+                                 _mm256_cmpgt_epi32(vn, i));
+  __m256i in1 = _mm256_and_si256(_mm256_cmpgt_epi32(j, neg),
+                                 _mm256_cmpgt_epi32(vn, j));
+  wt[0] = _mm256_and_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), fr),
+                        _mm256_castsi256_ps(in0));
+  wt[1] = _mm256_and_ps(fr, _mm256_castsi256_ps(in1));
+  __m256i top = _mm256_set1_epi32(n - 1), zero = _mm256_setzero_si256();
+  idx[0] = _mm256_max_epi32(_mm256_min_epi32(i, top), zero);
+  idx[1] = _mm256_max_epi32(_mm256_min_epi32(j, top), zero);
+}
+#elif __SSE2__
+// taps for 4 coordinates; see taps().  SSE2 has no 32-bit integer min,
+// max or multiply, so the taps are found and clamped as floats, which
+// hold every index exactly.
+static inline void taps4(__m128 s, int n, int32_t idx[2][4], __m128 wt[2]) {
+  const __m128 nf = _mm_set1_ps((float)n), one = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+  s = _mm_sub_ps(s, _mm_set1_ps(0.5f));
+  s = _mm_max_ps(s, _mm_set1_ps(-2.0f));
+  s = _mm_min_ps(s, _mm_add_ps(nf, one));
+  __m128 i = _mm_cvtepi32_ps(_mm_cvttps_epi32(s));
+  i = _mm_sub_ps(i, _mm_and_ps(_mm_cmpgt_ps(i, s), one)); // floor
+  __m128 fr = _mm_sub_ps(s, i);
+  __m128 j = _mm_add_ps(i, one);
+  __m128 in0 = _mm_and_ps(_mm_cmpge_ps(i, zero), _mm_cmplt_ps(i, nf));
+  __m128 in1 = _mm_and_ps(_mm_cmpge_ps(j, zero), _mm_cmplt_ps(j, nf));
+  wt[0] = _mm_and_ps(_mm_sub_ps(one, fr), in0);
+  wt[1] = _mm_and_ps(fr, in1);
+  __m128 top = _mm_sub_ps(nf, one);
+  _mm_storeu_si128((__m128i *)idx[0],
+                   _mm_cvttps_epi32(_mm_max_ps(_mm_min_ps(i, top), zero)));
+  _mm_storeu_si128((__m128i *)idx[1],
+                   _mm_cvttps_epi32(_mm_max_ps(_mm_min_ps(j, top), zero)));
+}
+#endif
+
+// one output row from x0 to x1 through the homography
+static void general_row(const osc_warp *w, const osc_picture *in,
+                        osc_picture *out, int y, int x0, int x1) {
+  int x = x0;
+#if __AVX2__
+  const float(*h)[3] = w->h;
+  float yc = (float)y + 0.5f;
+  const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f,
+                                     6.5f, 7.5f);
+  const __m256 hx = _mm256_set1_ps(h[0][1] * yc), hy = _mm256_set1_ps(h[1][1] * yc);
+  const __m256 hz = _mm256_set1_ps(h[2][1] * yc);
+  const __m256i stride = _mm256_set1_epi32((int)in->stride);
+  for (; x + 8 <= x1; x += 8) {
+    __m256 xc = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+    __m256 hw = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(h[2][0]), xc), hz),
+        _mm256_set1_ps(h[2][2]));
+    __m256 front = _mm256_cmp_ps(hw, _mm256_setzero_ps(), _CMP_GT_OQ);
+    __m256 u = _mm256_div_ps(
+        _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(h[0][0]), xc), hx),
+            _mm256_set1_ps(h[0][2])),
+        hw);
+    __m256 v = _mm256_div_ps(
+        _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(h[1][0]), xc), hy),
+            _mm256_set1_ps(h[1][2])),
+        hw);
+    __m256i ix[2], iy[2];
+    __m256 wx[2], wy[2];
+    taps8(u, w->in_w, ix, wx);
+    taps8(v, w->in_h, iy, wy);
+    wy[0] = _mm256_and_ps(wy[0], front);
+    wy[1] = _mm256_and_ps(wy[1], front);
+    __m256i r0 = _mm256_mullo_epi32(iy[0], stride);
+    __m256i r1 = _mm256_mullo_epi32(iy[1], stride);
+    __m256i o00 = _mm256_add_epi32(r0, ix[0]), o01 = _mm256_add_epi32(r0, ix[1]);
+    __m256i o10 = _mm256_add_epi32(r1, ix[0]), o11 = _mm256_add_epi32(r1, ix[1]);
+    for (int c = 0; c < 3; c++) {
+      const float *p = in->plane[c];
+      __m256 left = _mm256_add_ps(
+          _mm256_mul_ps(wy[0], _mm256_i32gather_ps(p, o00, 4)),
+          _mm256_mul_ps(wy[1], _mm256_i32gather_ps(p, o10, 4)));
+      __m256 right = _mm256_add_ps(
+          _mm256_mul_ps(wy[0], _mm256_i32gather_ps(p, o01, 4)),
+          _mm256_mul_ps(wy[1], _mm256_i32gather_ps(p, o11, 4)));
+      __m256 s = _mm256_add_ps(_mm256_mul_ps(wx[0], left),
+                               _mm256_mul_ps(wx[1], right));
+      _mm256_storeu_ps(osc_picture_row(out, c, y) + x, s);
+    }
+  }
+#elif __SSE2__
+  // as above, four wide; without gathers the 16 taps of each channel are
+  // loaded one by one
+  const float(*h)[3] = w->h;
+  float yc = (float)y + 0.5f;
+  const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 hx = _mm_set1_ps(h[0][1] * yc), hy = _mm_set1_ps(h[1][1] * yc);
+  const __m128 hz = _mm_set1_ps(h[2][1] * yc);
+  for (; x + 4 <= x1; x += 4) {
+    __m128 xc = _mm_add_ps(_mm_set1_ps((float)x), lane);
+    __m128 hw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(h[2][0]), xc), hz),
+                           _mm_set1_ps(h[2][2]));
+    __m128 front = _mm_cmpgt_ps(hw, _mm_setzero_ps());
+    __m128 u = _mm_div_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(h[0][0]), xc), hx),
+                   _mm_set1_ps(h[0][2])),
+        hw);
+    __m128 v = _mm_div_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(h[1][0]), xc), hy),
+                   _mm_set1_ps(h[1][2])),
+        hw);
+    int32_t ix[2][4], iy[2][4];
+    __m128 wx[2], wy[2];
+    taps4(u, w->in_w, ix, wx);
+    taps4(v, w->in_h, iy, wy);
+    wy[0] = _mm_and_ps(wy[0], front);
+    wy[1] = _mm_and_ps(wy[1], front);
+    for (int c = 0; c < 3; c++) {
+      const float *r0[4], *r1[4];
+      for (int k = 0; k < 4; k++) {
+        r0[k] = osc_picture_row(in, c, iy[0][k]);
+        r1[k] = osc_picture_row(in, c, iy[1][k]);
+      }
+      const int32_t *a = ix[0], *b = ix[1];
+      __m128 left = _mm_add_ps(
+          _mm_mul_ps(wy[0], _mm_setr_ps(r0[0][a[0]], r0[1][a[1]],
+                                        r0[2][a[2]], r0[3][a[3]])),
+          _mm_mul_ps(wy[1], _mm_setr_ps(r1[0][a[0]], r1[1][a[1]],
+                                        r1[2][a[2]], r1[3][a[3]])));
+      __m128 right = _mm_add_ps(
+          _mm_mul_ps(wy[0], _mm_setr_ps(r0[0][b[0]], r0[1][b[1]],
+                                        r0[2][b[2]], r0[3][b[3]])),
+          _mm_mul_ps(wy[1], _mm_setr_ps(r1[0][b[0]], r1[1][b[1]],
+                                        r1[2][b[2]], r1[3][b[3]])));
+      __m128 s = _mm_add_ps(_mm_mul_ps(wx[0], left), _mm_mul_ps(wx[1], right));
+      _mm_storeu_ps(osc_picture_row(out, c, y) + x, s);
+    }
+  }
+#endif
+  for (; x < x1; x++) {
+    float px[3];
+    osc_warp_pixel(w, in, x, y, px);
+    for (int c = 0; c < 3; c++)
+      osc_picture_row(out, c, y)[x] = px[c];
+  }
+}
+
+static void run_tile(const osc_warp *w, const osc_picture *in,
+                     osc_picture *out, int tile, float *tmp) {
+  int tiles_x = (w->out_w + OSC_WARP_TILE_W - 1) / OSC_WARP_TILE_W;
+  int x0 = tile % tiles_x * OSC_WARP_TILE_W;
+  int y0 = tile / tiles_x * OSC_WARP_TILE_H;
+  int x1 = x0 + OSC_WARP_TILE_W < w->out_w ? x0 + OSC_WARP_TILE_W : w->out_w;
+  int y1 = y0 + OSC_WARP_TILE_H < w->out_h ? y0 + OSC_WARP_TILE_H : w->out_h;
+  for (int y = y0; y < y1; y++) {
+    if (w->axis_aligned)
+      axis_row(w, in, out, y, x0, x1, tmp);
+    else
+      general_row(w, in, out, y, x0, x1);
+  }
+}
+
+static int tile_count(const osc_warp *w) {
+  return ((w->out_w + OSC_WARP_TILE_W - 1) / OSC_WARP_TILE_W) *
+         ((w->out_h + OSC_WARP_TILE_H - 1) / OSC_WARP_TILE_H);
+}
+
+// a row of input for the blended rows of axis_row
+static float *scratch(const osc_warp *w) {
+  return malloc(((size_t)w->in_w + 8) * sizeof(float));
+}
+
+static void run_tiles(osc_warp_pool *p) {
+  float *tmp = scratch(p->warp);
+  int t;
+  if (!tmp)
+    return;
+  while ((t = atomic_fetch_add(&p->next, 1)) < p->tiles)
+    run_tile(p->warp, p->in, p->out, t, tmp);
+  free(tmp);
+}
+
+static void *pool_main(void *arg) {
+  osc_warp_pool *p = arg;
+  uint64_t seen = 0;
+  pthread_mutex_lock(&p->lock);
+  for (;;) {
+    while (!p->quit && p->job == seen)
+      pthread_cond_wait(&p->start, &p->lock);
+    if (p->quit)
+      break;
+    seen = p->job;
+    pthread_mutex_unlock(&p->lock);
+    run_tiles(p);
+    pthread_mutex_lock(&p->lock);
+    if (--p->busy == 0)
+      pthread_cond_signal(&p->done);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+int osc_warp_pool_init(osc_warp_pool *p, int threads) {
+  memset(p, 0, sizeof(*p));
+  if (threads < 0 || threads > OSC_WARP_MAX_THREADS)
+    return -1;
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->start, NULL);
+  pthread_cond_init(&p->done, NULL);
+  for (int i = 0; i < threads; i++) {
+    if (pthread_create(&p->tid[i], NULL, pool_main, p) != 0) {
+      perror("pthread_create");
+      osc_warp_pool_close(p);
+      return -1;
+    }
+    p->threads++;
+  }
+  return 0;
+}
+
+void osc_warp_pool_close(osc_warp_pool *p) {
+  pthread_mutex_lock(&p->lock);
+  p->quit = true;
+  pthread_cond_broadcast(&p->start);
+  pthread_mutex_unlock(&p->lock);
+  for (int i = 0; i < p->threads; i++)
+    pthread_join(p->tid[i], NULL);
+  p->threads = 0;
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->start);
+  pthread_cond_destroy(&p->done);
+}
+
+void osc_warp_apply(const osc_warp *w, const osc_picture *in,
+                    osc_picture *out, osc_warp_pool *pool) {
+  int tiles = tile_count(w);
+  if (!pool || pool->threads == 0) {
+    float *tmp = scratch(w);
+    if (!tmp)
+      return;
+    for (int t = 0; t < tiles; t++)
+      run_tile(w, in, out, t, tmp);
+    free(tmp);
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->warp = w;
+  pool->in = in;
+  pool->out = out;
+  pool->tiles = tiles;
+  atomic_store(&pool->next, 0);
+  pool->busy = pool->threads;
+  pool->job++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_tiles(pool);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->busy > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
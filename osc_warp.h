@@ -0,0 +1,103 @@
+#ifndef __OSC_WARP_H__
+#define __OSC_WARP_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "osc_config.h"
+#include "osc_picture.h"
+
+/*
+ * CPU reference for a send's geometry: places an input frame on the
+ * output raster.
+ *
+ * At scale 1 and no other change the input is stretched to fill the
+ * output.  From there, about the centre of the frame and in output
+ * pixels (so aspect is kept): scaleX and scaleY scale it, rotation turns
+ * it clockwise by that many degrees, pitch and yaw tilt it about the
+ * horizontal and vertical axes by that many degrees, seen in perspective
+ * from OSC_WARP_FOCAL output widths away, and posX and posY move it by
+ * those fractions of the output width and height.  Everything outside the
+ * input is black.
+ *
+ * osc_warp_update composes this into the homography from output pixel to
+ * input pixel, only when the geometry or frame sizes changed.  Each
+ * output pixel is then a bilinear sample of the input at its centre.
+ * Without rotation, pitch or yaw the mapping is separable, so update also
+ * lays out each output column's two input columns and weights and each
+ * row's two input rows: a frame costs no divisions, each row blends two
+ * input rows straight through, and a whole-pixel shift is a copy.
+ *
+ * osc_warp_apply splits the output into tiles handed to an
+ * osc_warp_pool.  The separable path runs 4 pixels at a time with SSE2
+ * (row blends 8 at a time with -mavx2); the general one samples 8 pixels
+ * at a time with gathers when built with -mavx2, otherwise one by one.
+ */
+
+#define OSC_WARP_FOCAL       1.0f
+#define OSC_WARP_TILE_W      128
+#define OSC_WARP_TILE_H      32
+#define OSC_WARP_MAX_THREADS 16
+
+typedef struct osc_warp {
+  float    h[3][3];      // output pixel (x, y, 1) to input pixel
+  bool     axis_aligned; // no rotation, pitch or yaw: use the tables
+  int      in_w, in_h, out_w, out_h;
+  // axis-aligned addressing: two taps each, index clamped into the input
+  // and weight 0 for a tap outside it
+  int32_t *col_idx[2];
+  float   *col_w[2];
+  int32_t *row_idx[2];
+  float   *row_w[2];
+  bool     col_shift_ok; // every column is input column x + col_shift
+  int      col_shift;
+  uint64_t updates;      // rebuilds
+  // what it was built from
+  bool     built;
+  float    geometry[7];  // scaleX, scaleY, posX, posY, rotation, pitch, yaw
+} osc_warp;
+
+void osc_warp_init(osc_warp *w);
+void osc_warp_free(osc_warp *w);
+
+/* Brings w up to a send's geometry and the frame sizes. Returns 1 if it
+ * rebuilt, 0 if nothing changed, -1 if out of memory. */
+int osc_warp_update(osc_warp *w, const ConfigSend *send, int in_w, int in_h,
+                    int out_w, int out_h);
+
+/* Samples output pixel x, y; the scalar reference for osc_warp_apply. */
+void osc_warp_pixel(const osc_warp *w, const osc_picture *in, int x, int y,
+                    float out[3]);
+
+/*
+ * Threads that share the tiles of an osc_warp_apply with its caller.
+ */
+typedef struct osc_warp_pool {
+  int              threads; // helpers, besides the caller
+  pthread_t        tid[OSC_WARP_MAX_THREADS];
+  pthread_mutex_t  lock;
+  pthread_cond_t   start;
+  pthread_cond_t   done;
+  uint64_t         job;     // bumped for each apply
+  int              busy;    // helpers still on the current job
+  bool             quit;
+  _Atomic int      next;    // next tile to take
+  int              tiles;
+  const osc_warp  *warp;
+  const osc_picture *in;
+  osc_picture     *out;
+} osc_warp_pool;
+
+/* Starts threads helpers (0 to run every tile on the caller). Returns 0
+ * or -1. */
+int osc_warp_pool_init(osc_warp_pool *p, int threads);
+void osc_warp_pool_close(osc_warp_pool *p);
+
+/* Warps in onto out, whose size must be what w was updated for; pool may
+ * be NULL. */
+void osc_warp_apply(const osc_warp *w, const osc_picture *in,
+                    osc_picture *out, osc_warp_pool *pool);
+
+#endif
@@ -30,6 +30,11 @@
 #define htonll(x) htobe64(x)
 #define ntohll(x) be64toh(x)
 #endif
+#if __SSE2__
+#include <emmintrin.h>
+#elif __ARM_NEON
+#include <arm_neon.h>
+#endif
 #include "tinyosc.h"
 
 #define BUNDLE_ID 0x2362756E646C6500L // "#bundle"
@@ -56,6 +61,81 @@ int tosc_parseMessage(tosc_message *o, char *buffer, const int len) {
   return 0;
 }
 
+// index of the first '\0' in buffer[from, len), or -1. Tests a word at a
+// time, since addresses and strings are long runs of non-zero bytes.
+static int tosc_findNul(const char *buffer, int from, const int len) {
+  int i = from;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, buffer + i, 8);
+    if ((w - 0x0101010101010101ULL) & ~w & 0x8080808080808080ULL) break;
+  }
+  for (; i < len; ++i) {
+    if (buffer[i] == '\0') return i;
+  }
+  return -1;
+}
+
+// bytes of argument data per type tag; negative for variable or unknown
+#define ARG_UNKNOWN -1
+#define ARG_STRING -2
+#define ARG_BLOB -3
+static const int8_t tosc_argSize[256] = {
+  [0 ... 255] = ARG_UNKNOWN,
+  ['i'] = 4, ['f'] = 4, ['m'] = 4, ['c'] = 4, ['r'] = 4,
+  ['h'] = 8, ['t'] = 8, ['d'] = 8,
+  ['s'] = ARG_STRING, ['S'] = ARG_STRING, ['b'] = ARG_BLOB,
+  ['T'] = 0, ['F'] = 0, ['N'] = 0, ['I'] = 0, ['['] = 0, [']'] = 0,
+};
+
+int tosc_parseMessageChecked(tosc_message *o, char *buffer, const int len) {
+  if (len <= 0) return -1;
+  int i = tosc_findNul(buffer, 0, len); // end of the address
+  if (i < 0) return -1;
+  i = (i + 4) & ~0x3;
+  if (i >= len || buffer[i] != ',') return -2; // no format string
+  const int f = i + 1;
+  const int fe = tosc_findNul(buffer, f, len);
+  if (fe < 0) return -2; // format string not null terminated
+  i = (fe + 4) & ~0x3;
+
+  // size the arguments the format describes, so that the readers need not
+  int j = i;
+  for (int k = f; k < fe; ++k) {
+    uint64_t w;
+    if (k + 8 <= fe && (memcpy(&w, buffer + k, 8), w == 0x6666666666666666ULL)) {
+      j += 32; // eight floats, as in a LUT
+      k += 7;
+      continue;
+    }
+    const int8_t size = tosc_argSize[(uint8_t) buffer[k]];
+    if (size >= 0) {
+      j += size; // fixed size; checked once the format ends
+      continue;
+    }
+    if (size == ARG_UNKNOWN || j >= len) return size == ARG_UNKNOWN ? -3 : -4;
+    if (size == ARG_STRING) {
+      const int e = tosc_findNul(buffer, j, len);
+      if (e < 0) return -4;
+      j = (e + 4) & ~0x3;
+    } else { // ARG_BLOB
+      if (j + 4 > len) return -4;
+      uint32_t n;
+      memcpy(&n, buffer + j, 4);
+      n = ntohl(n);
+      if (n > (uint32_t) (len - j - 4)) return -4;
+      j += 4 + (int) ((n + 3) & ~0x3);
+    }
+  }
+  if (j > len) return -4; // arguments overrun the buffer
+
+  o->format = buffer + f;
+  o->marker = buffer + i;
+  o->buffer = buffer;
+  o->len = len;
+  return 0;
+}
+
 // check if first eight bytes are '#bundle '
 bool tosc_isBundle(const char *buffer) {
   return ((*(const int64_t *) buffer) == htonll(BUNDLE_ID));
@@ -77,9 +157,13 @@ uint32_t tosc_getBundleLength(tosc_bundle *b) {
 }
 
 bool tosc_getNextMessage(tosc_bundle *b, tosc_message *o) {
-  if ((b->marker - b->buffer) >= b->bundleLen) return false;
-  uint32_t len = (uint32_t) ntohl(*((int32_t *) b->marker));
-  tosc_parseMessage(o, b->marker+4, len);
+  const uint32_t offset = (uint32_t) (b->marker - b->buffer);
+  if (offset + 4 > b->bundleLen) return false;
+  uint32_t len;
+  memcpy(&len, b->marker, 4);
+  len = ntohl(len);
+  if (len > b->bundleLen - offset - 4) return false; // element overruns
+  if (tosc_parseMessageChecked(o, b->marker+4, (int) len) != 0) return false;
   b->marker += (4 + len); // move marker to next bundle element
   return true;
 }
@@ -120,6 +204,44 @@ float tosc_getNextFloat(tosc_message *o) {
   return *((float *) (&i));
 }
 
+// byte-swaps n big-endian 32-bit words from src into dst
+static void tosc_swap32(void *dst, const char *src, int n) {
+  char *d = (char *) dst;
+  int i = 0;
+#if __SSE2__
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *) (src + 4*i));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); // bytes
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)); // then halves
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    _mm_storeu_si128((__m128i *) (d + 4*i), v);
+  }
+#elif __ARM_NEON
+  for (; i + 4 <= n; i += 4) {
+    vst1q_u8((uint8_t *) (d + 4*i),
+        vrev32q_u8(vld1q_u8((const uint8_t *) (src + 4*i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    uint32_t w;
+    memcpy(&w, src + 4*i, 4);
+    w = ntohl(w);
+    memcpy(d + 4*i, &w, 4);
+  }
+}
+
+int tosc_getNextFloats(tosc_message *o, float *dst, const int n) {
+  tosc_swap32(dst, o->marker, n);
+  o->marker += 4*n;
+  return n;
+}
+
+int tosc_getNextInt32s(tosc_message *o, int32_t *dst, const int n) {
+  tosc_swap32(dst, o->marker, n);
+  o->marker += 4*n;
+  return n;
+}
+
 double tosc_getNextDouble(tosc_message *o) {
   const uint64_t i = ntohll(*((uint64_t *) o->marker));
   o->marker += 8;
@@ -280,7 +402,7 @@ void tosc_printOscBuffer(char *buffer, const int len) {
   // parse the buffer contents (the raw OSC bytes)
   // a return value of 0 indicates no error
   tosc_message m;
-  const int err = tosc_parseMessage(&m, buffer, len);
+  const int err = tosc_parseMessageChecked(&m, buffer, len);
   if (err == 0) tosc_printMessage(&m);
   else printf("Error while reading OSC buffer: %i\n", err);
 }
@@ -309,8 +431,8 @@ void tosc_printMessage(tosc_message *osc) {
       case 'f': printf(" %g", tosc_getNextFloat(osc)); break;
       case 'd': printf(" %g", tosc_getNextDouble(osc)); break;
       case 'i': printf(" %d", tosc_getNextInt32(osc)); break;
-      case 'h': printf(" %lld", tosc_getNextInt64(osc)); break;
-      case 't': printf(" %lld", tosc_getNextTimetag(osc)); break;
+      case 'h': printf(" %lld", (long long) tosc_getNextInt64(osc)); break;
+      case 't': printf(" %lld", (long long) tosc_getNextTimetag(osc)); break;
       case 's': printf(" %s", tosc_getNextString(osc)); break;
       case 'F': printf(" false"); break;
       case 'I': printf(" inf"); break;
@@ -58,8 +58,8 @@ void tosc_parseBundle(tosc_bundle *b, char *buffer, const int len);
 uint64_t tosc_getTimetag(tosc_bundle *b);
 
 /**
- * Parses the next message in a bundle. Returns true if successful.
- * False otherwise.
+ * Parses and checks the next message in a bundle. Returns true if successful.
+ * False at the end of the bundle or on a malformed element.
  */
 bool tosc_getNextMessage(tosc_bundle *b, tosc_message *o);
 
@@ -99,6 +99,19 @@ uint64_t tosc_getNextTimetag(tosc_message *o);
  */
 float tosc_getNextFloat(tosc_message *o);
 
+/**
+ * Reads the next n 32-bit floats into dst in one vectorized pass. For use
+ * once the format has been matched against a signature such as "f" or a run
+ * of 'f's, so the next n arguments are known to be floats. Does not check
+ * buffer bounds. Returns n.
+ */
+int tosc_getNextFloats(tosc_message *o, float *dst, const int n);
+
+/**
+ * Reads the next n 32-bit ints into dst, as tosc_getNextFloats does.
+ */
+int tosc_getNextInt32s(tosc_message *o, int32_t *dst, const int n);
+
 /**
  * Returns the next 64-bit float. Does not check buffer bounds.
  */
@@ -137,6 +150,17 @@ tosc_message *tosc_reset(tosc_message *o);
  */
 int tosc_parseMessage(tosc_message *o, char *buffer, const int len);
 
+/**
+ * Parse an OSC message from an untrusted buffer, such as a datagram.
+ * Checks that the address and format string are null terminated within len,
+ * that every type in the format is known, and that the arguments the format
+ * describes, strings and blobs included, fit within len. After a successful
+ * parse the tosc_getNext* readers stay within the buffer.
+ * Returns 0 if the message is valid. An error code (a negative number)
+ * otherwise: -1 address, -2 format string, -3 unknown type, -4 arguments.
+ */
+int tosc_parseMessageChecked(tosc_message *o, char *buffer, const int len);
+
 /**
  * Starts writing a bundle to the given buffer with length.
  */